@@ -1,10 +1,602 @@
 #include "AssetManager.hpp"
 #include "sqlite3.h"
+#include "FileWatcher.hpp"
+#include "MappedFile.hpp"
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 namespace GlProj
 {
 	namespace Utilities
 	{
+		//Bump whenever the schema changes. The database is only a cache of
+		//work that can be redone, so an old one is simply rebuilt.
+		static const constexpr int SchemaVersion = 1;
+		static const char* const DatabaseName = "assets.db";
 
+		namespace
+		{
+			std::runtime_error DatabaseError(sqlite3* db, const char* what)
+			{
+				return std::runtime_error(std::string("Asset database error: ") + what + ".\n" + sqlite3_errmsg(db) + '\n');
+			}
+
+			struct DatabaseCloser
+			{
+				void operator()(sqlite3* db) const noexcept
+				{
+					sqlite3_close(db);
+				}
+			};
+			using DatabasePtr = std::unique_ptr<sqlite3, DatabaseCloser>;
+
+			void Execute(sqlite3* db, const char* sql)
+			{
+				if (sqlite3_exec(db, sql, nullptr, nullptr, nullptr) != SQLITE_OK)
+				{
+					throw DatabaseError(db, sql);
+				}
+			}
+
+			class Statement
+			{
+				sqlite3_stmt* stmt = nullptr;
+			public:
+				Statement(sqlite3* db, const char* sql)
+				{
+					if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+					{
+						throw DatabaseError(db, sql);
+					}
+				}
+				Statement(const Statement&) = delete;
+				Statement& operator=(const Statement&) = delete;
+				~Statement()
+				{
+					sqlite3_finalize(stmt);
+				}
+
+				sqlite3_stmt* get() const noexcept
+				{
+					return stmt;
+				}
+			};
+
+			//One execution of a prepared statement. Resetting afterwards
+			//leaves it ready for the next, without preparing it again.
+			class Query
+			{
+				sqlite3* db;
+				sqlite3_stmt* stmt;
+			public:
+				Query(sqlite3* d, const Statement& s) noexcept
+					: db(d)
+					, stmt(s.get())
+				{}
+				Query(const Query&) = delete;
+				Query& operator=(const Query&) = delete;
+				~Query()
+				{
+					sqlite3_reset(stmt);
+					sqlite3_clear_bindings(stmt);
+				}
+
+				Query& Bind(int i, const std::string& value)
+				{
+					if (sqlite3_bind_text(stmt, i, value.data(), int(value.size()), SQLITE_TRANSIENT) != SQLITE_OK)
+					{
+						throw DatabaseError(db, "bind");
+					}
+					return *this;
+				}
+				Query& Bind(int i, std::int64_t value)
+				{
+					if (sqlite3_bind_int64(stmt, i, value) != SQLITE_OK)
+					{
+						throw DatabaseError(db, "bind");
+					}
+					return *this;
+				}
+				//True while there are rows to read.
+				bool Step()
+				{
+					auto result = sqlite3_step(stmt);
+					if (result == SQLITE_ROW) return true;
+					if (result == SQLITE_DONE) return false;
+					throw DatabaseError(db, sqlite3_sql(stmt));
+				}
+				//Rows changed by the last Step.
+				int Changes() const noexcept
+				{
+					return sqlite3_changes(db);
+				}
+
+				std::int64_t Integer(int column) const noexcept
+				{
+					return sqlite3_column_int64(stmt, column);
+				}
+				bool IsNull(int column) const noexcept
+				{
+					return sqlite3_column_type(stmt, column) == SQLITE_NULL;
+				}
+				std::string Text(int column) const
+				{
+					auto text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+					return text == nullptr ? std::string() : std::string(text, std::size_t(sqlite3_column_bytes(stmt, column)));
+				}
+			};
+
+			DatabasePtr OpenDatabase(const std::string& path)
+			{
+				sqlite3* raw = nullptr;
+				auto result = sqlite3_open_v2(path.c_str(), &raw, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr);
+				DatabasePtr db(raw);
+				if (result != SQLITE_OK)
+				{
+					throw std::runtime_error("Failed to open asset database.\nPath: " + path + '\n'
+						+ (raw == nullptr ? "" : sqlite3_errmsg(raw)) + '\n');
+				}
+
+				//WAL lets lookups proceed while records are written, and with
+				//it NORMAL syncs only at checkpoints without risking corruption.
+				Execute(db.get(), "PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL;");
+
+				int version = 0;
+				{
+					Statement getVersion(db.get(), "PRAGMA user_version;");
+					Query q(db.get(), getVersion);
+					if (q.Step()) version = int(q.Integer(0));
+				}
+				if (version != SchemaVersion)
+				{
+					Execute(db.get(),
+						"DROP TABLE IF EXISTS assets;"
+						"DROP TABLE IF EXISTS artifacts;"
+						"DROP TABLE IF EXISTS dependencies;");
+				}
+				Execute(db.get(),
+					"CREATE TABLE IF NOT EXISTS assets("
+						"path TEXT PRIMARY KEY, size INTEGER, modified INTEGER, hash INTEGER,"
+						"settings TEXT, artifact TEXT) WITHOUT ROWID;"
+					"CREATE TABLE IF NOT EXISTS artifacts("
+						"key INTEGER PRIMARY KEY, path TEXT NOT NULL, settings TEXT NOT NULL);"
+					"CREATE TABLE IF NOT EXISTS dependencies("
+						"asset TEXT NOT NULL, dependency TEXT NOT NULL,"
+						"PRIMARY KEY(asset, dependency)) WITHOUT ROWID;"
+					"CREATE INDEX IF NOT EXISTS dependents ON dependencies(dependency);");
+				Execute(db.get(), ("PRAGMA user_version = " + std::to_string(SchemaVersion) + ';').c_str());
+				return db;
+			}
+		}
+
+		class AssetManager
+		{
+			struct RebuildNode
+			{
+				std::vector<std::string> dependencies;
+				std::function<void()> rebuild;
+			};
+
+			std::string directory;
+			DatabasePtr db;
+			std::mutex mutex;
+
+			//Main thread only.
+			FileWatcher watcher;
+			std::unordered_map<std::string, RebuildNode> rebuilds;
+
+			//Prepared once; destroyed before the database is closed.
+			Statement begin;
+			Statement commit;
+			Statement rollback;
+			Statement checkpoint;
+			Statement findHash;
+			Statement updateHash;
+			Statement insertHash;
+			Statement updateImport;
+			Statement insertImport;
+			Statement findArtifact;
+			Statement recordArtifact;
+			Statement clearDependencies;
+			Statement addDependency;
+			Statement findDependents;
+
+			//One call's writes, committed together when it finishes, so no
+			//transaction outlives the call holding the lock. Rolled back if
+			//the call throws first.
+			class WriteBatch
+			{
+				AssetManager& owner;
+				bool committed = false;
+			public:
+				explicit WriteBatch(AssetManager& a)
+					: owner(a)
+				{
+					Query(owner.db.get(), owner.begin).Step();
+				}
+				WriteBatch(const WriteBatch&) = delete;
+				WriteBatch& operator=(const WriteBatch&) = delete;
+				~WriteBatch()
+				{
+					if (committed) return;
+					sqlite3_step(owner.rollback.get());
+					sqlite3_reset(owner.rollback.get());
+				}
+
+				void Commit()
+				{
+					Query(owner.db.get(), owner.commit).Step();
+					committed = true;
+				}
+			};
+		public:
+			explicit AssetManager(const std::string& projectPath)
+				: directory(projectPath)
+				, db(OpenDatabase(projectPath + '/' + DatabaseName))
+				, begin(db.get(), "BEGIN;")
+				, commit(db.get(), "COMMIT;")
+				, rollback(db.get(), "ROLLBACK;")
+				, checkpoint(db.get(), "PRAGMA wal_checkpoint(PASSIVE);")
+				, findHash(db.get(), "SELECT size, modified, hash FROM assets WHERE path = ?1;")
+				, updateHash(db.get(), "UPDATE assets SET size = ?2, modified = ?3, hash = ?4 WHERE path = ?1;")
+				, insertHash(db.get(), "INSERT INTO assets(path, size, modified, hash) VALUES(?1, ?2, ?3, ?4);")
+				, updateImport(db.get(), "UPDATE assets SET settings = ?2, artifact = ?3 WHERE path = ?1;")
+				, insertImport(db.get(), "INSERT INTO assets(path, settings, artifact) VALUES(?1, ?2, ?3);")
+				, findArtifact(db.get(), "SELECT path FROM artifacts WHERE key = ?1;")
+				, recordArtifact(db.get(), "INSERT OR REPLACE INTO artifacts(key, path, settings) VALUES(?1, ?2, ?3);")
+				, clearDependencies(db.get(), "DELETE FROM dependencies WHERE asset = ?1;")
+				, addDependency(db.get(), "INSERT OR IGNORE INTO dependencies(asset, dependency) VALUES(?1, ?2);")
+				, findDependents(db.get(), "SELECT asset FROM dependencies WHERE dependency = ?1;")
+			{}
+			AssetManager(const AssetManager&) = delete;
+			AssetManager& operator=(const AssetManager&) = delete;
+
+			const std::string& GetDirectory() const noexcept
+			{
+				return directory;
+			}
+
+			//Records are already committed; this moves them from the
+			//write-ahead log into the database file.
+			void Save()
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				Query q(db.get(), checkpoint);
+				while (q.Step()) {}
+			}
+
+			bool FindHash(const std::string& path, FileStamp& stamp, std::uint64_t& hash)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				Query q(db.get(), findHash);
+				q.Bind(1, path);
+				if (!q.Step() || q.IsNull(2)) return false;
+				stamp.size = std::uint64_t(q.Integer(0));
+				stamp.modified = q.Integer(1);
+				hash = std::uint64_t(q.Integer(2));
+				return true;
+			}
+			void RecordHash(const std::string& path, const FileStamp& stamp, std::uint64_t hash)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				WriteBatch batch(*this);
+				bool updated;
+				{
+					Query q(db.get(), updateHash);
+					q.Bind(1, path).Bind(2, std::int64_t(stamp.size)).Bind(3, stamp.modified).Bind(4, std::int64_t(hash));
+					q.Step();
+					updated = q.Changes() > 0;
+				}
+				if (!updated)
+				{
+					Query q(db.get(), insertHash);
+					q.Bind(1, path).Bind(2, std::int64_t(stamp.size)).Bind(3, stamp.modified).Bind(4, std::int64_t(hash));
+					q.Step();
+				}
+				batch.Commit();
+			}
+
+			bool FindArtifact(std::uint64_t key, std::string& path)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				Query q(db.get(), findArtifact);
+				q.Bind(1, std::int64_t(key));
+				if (!q.Step()) return false;
+				path = q.Text(0);
+				return true;
+			}
+			void RecordImport(const std::string& source, const std::string& settings, std::uint64_t key, const std::string& artifact)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				WriteBatch batch(*this);
+				{
+					Query q(db.get(), recordArtifact);
+					q.Bind(1, std::int64_t(key)).Bind(2, artifact).Bind(3, settings);
+					q.Step();
+				}
+				bool updated;
+				{
+					Query q(db.get(), updateImport);
+					q.Bind(1, source).Bind(2, settings).Bind(3, artifact);
+					q.Step();
+					updated = q.Changes() > 0;
+				}
+				if (!updated)
+				{
+					Query q(db.get(), insertImport);
+					q.Bind(1, source).Bind(2, settings).Bind(3, artifact);
+					q.Step();
+				}
+				batch.Commit();
+			}
+
+			void SetDependencies(const std::string& asset, const std::vector<std::string>& dependencies)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				WriteBatch batch(*this);
+				{
+					Query q(db.get(), clearDependencies);
+					q.Bind(1, asset);
+					q.Step();
+				}
+				for (const auto& d : dependencies)
+				{
+					Query q(db.get(), addDependency);
+					q.Bind(1, asset).Bind(2, d);
+					q.Step();
+				}
+				batch.Commit();
+			}
+			std::vector<std::string> GetDependents(const std::string& dependency)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				std::vector<std::string> result;
+				Query q(db.get(), findDependents);
+				q.Bind(1, dependency);
+				while (q.Step())
+				{
+					result.push_back(q.Text(0));
+				}
+				return result;
+			}
+
+			void RegisterRebuild(const std::string& asset, const std::vector<std::string>& dependencies, std::function<void()> rebuild)
+			{
+				SetDependencies(asset, dependencies);
+				rebuilds[asset] = RebuildNode{ dependencies, std::move(rebuild) };
+			}
+			void UnregisterRebuild(const std::string& asset)
+			{
+				rebuilds.erase(asset);
+			}
+			void Watch(const std::string& path)
+			{
+				watcher.Watch(path);
+			}
+			std::vector<std::string> PollWatchedFiles()
+			{
+				return watcher.Poll();
+			}
+
+			//Rebuilds the registered assets among 'affected', each after any
+			//of its dependencies also among them.
+			std::size_t Rebuild(const std::unordered_set<std::string>& affected)
+			{
+				enum class State { Visiting, Built, Failed };
+				std::unordered_map<std::string, State> states;
+				std::size_t rebuilt = 0;
+
+				std::function<bool(const std::string&)> visit = [&](const std::string& asset)
+				{
+					auto state = states.find(asset);
+					if (state != states.end())
+					{
+						//A cycle is reported as a failure rather than looping.
+						return state->second == State::Built;
+					}
+					states[asset] = State::Visiting;
+
+					auto node = rebuilds.find(asset);
+					bool ok = true;
+					if (node != rebuilds.end())
+					{
+						for (const auto& d : node->second.dependencies)
+						{
+							if (affected.count(d) != 0 && !visit(d)) ok = false;
+						}
+						if (ok)
+						{
+							try
+							{
+								node->second.rebuild();
+								++rebuilt;
+							}
+							catch (const std::exception& e)
+							{
+								std::cerr << "Failed to rebuild " << asset << ".\n" << e.what() << '\n';
+								ok = false;
+							}
+						}
+					}
+					states[asset] = ok ? State::Built : State::Failed;
+					return ok;
+				};
+
+				for (const auto& asset : affected)
+				{
+					visit(asset);
+				}
+				return rebuilt;
+			}
+		};
+
+		static std::unique_ptr<AssetManager> currentProject;
+
+		std::uint64_t HashBytes(const void* data, std::size_t size, std::uint64_t seed) noexcept
+		{
+			const std::uint64_t prime = 0x100000001b3ull;
+			auto bytes = static_cast<const unsigned char*>(data);
+			auto hash = seed;
+			for (std::size_t i = 0; i < size; ++i)
+			{
+				hash = (hash ^ bytes[i]) * prime;
+			}
+			return hash;
+		}
+
+		AssetManager* OpenProject(const char* projectPath, bool savePrevious)
+		{
+			CloseProject(savePrevious);
+			currentProject = std::make_unique<AssetManager>(projectPath);
+			return currentProject.get();
+		}
+		AssetManager* GetAssetManager() noexcept
+		{
+			return currentProject.get();
+		}
+		void CloseProject(bool save)
+		{
+			if (currentProject == nullptr) return;
+			if (save) currentProject->Save();
+			currentProject.reset();
+		}
+		void SaveProject(AssetManager* manager)
+		{
+			manager->Save();
+		}
+
+		//Reads without holding the database, so other lookups carry on.
+		static bool HashFile(const std::string& path, std::uint64_t& hash)
+		{
+			try
+			{
+				MappedFile file(path);
+				hash = HashBytes(file.Data(), file.Size());
+				return true;
+			}
+			catch (const std::runtime_error&)
+			{
+				return false;
+			}
+		}
+
+		bool GetContentHash(AssetManager* manager, const std::string& path, std::uint64_t& hash)
+		{
+			FileStamp stamp;
+			if (!GetFileStamp(path, stamp)) return false;
+			FileStamp recorded;
+			if (manager->FindHash(path, recorded, hash) && recorded == stamp) return true;
+
+			if (!HashFile(path, hash)) return false;
+			manager->RecordHash(path, stamp, hash);
+			return true;
+		}
+
+		std::uint64_t MakeArtifactKey(std::uint64_t contentHash, const std::string& settings) noexcept
+		{
+			return HashString(settings, HashBytes(&contentHash, sizeof(contentHash)));
+		}
+		std::string GetArtifactPath(const AssetManager* manager, std::uint64_t key, const char* extension)
+		{
+			char name[17];
+			std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+			return manager->GetDirectory() + '/' + name + extension;
+		}
+		bool FindArtifact(AssetManager* manager, std::uint64_t key, std::string& path)
+		{
+			return manager->FindArtifact(key, path);
+		}
+		void RecordImport(AssetManager* manager, const std::string& sourcePath, const std::string& settings,
+			std::uint64_t key, const std::string& artifactPath)
+		{
+			manager->RecordImport(sourcePath, settings, key, artifactPath);
+		}
+
+		void SetDependencies(AssetManager* manager, const std::string& asset, const std::vector<std::string>& dependencies)
+		{
+			manager->SetDependencies(asset, dependencies);
+		}
+		std::vector<std::string> GetDependents(AssetManager* manager, const std::string& dependency)
+		{
+			return manager->GetDependents(dependency);
+		}
+
+		//Existing files by their canonical spelling; asset names as given.
+		static std::string DependencyKey(const std::string& dependency)
+		{
+			FileStamp stamp;
+			if (!GetFileStamp(dependency, stamp)) return dependency;
+			try
+			{
+				return NormalisePath(dependency);
+			}
+			catch (const std::exception&)
+			{
+				//Removed since the stamp was read; it cannot be watched anyway.
+				return dependency;
+			}
+		}
+
+		void RegisterRebuild(AssetManager* manager, const std::string& asset, const std::vector<std::string>& dependencies,
+			std::function<void()> rebuild)
+		{
+			std::vector<std::string> keys;
+			keys.reserve(dependencies.size());
+			for (const auto& d : dependencies)
+			{
+				keys.push_back(DependencyKey(d));
+				//Records the contents as loaded, to compare against later.
+				std::uint64_t hash;
+				if (GetContentHash(manager, keys.back(), hash))
+				{
+					manager->Watch(keys.back());
+				}
+			}
+			manager->RegisterRebuild(asset, keys, std::move(rebuild));
+		}
+		void UnregisterRebuild(AssetManager* manager, const std::string& asset)
+		{
+			manager->UnregisterRebuild(asset);
+		}
+		std::size_t RebuildChanged(AssetManager* manager)
+		{
+			//Saving without changing anything, or rewriting a file mid-edit,
+			//alters the stamp but not the contents; only the latter counts.
+			std::vector<std::string> changed;
+			for (auto& path : manager->PollWatchedFiles())
+			{
+				FileStamp stamp, recorded;
+				std::uint64_t hash, previous;
+				if (!GetFileStamp(path, stamp) || !HashFile(path, hash)) continue;
+				auto known = manager->FindHash(path, recorded, previous);
+				manager->RecordHash(path, stamp, hash);
+				if (!known || hash != previous)
+				{
+					changed.push_back(std::move(path));
+				}
+			}
+			if (changed.empty()) return 0;
+
+			std::unordered_set<std::string> affected(changed.begin(), changed.end());
+			while (!changed.empty())
+			{
+				auto asset = std::move(changed.back());
+				changed.pop_back();
+				for (auto& d : manager->GetDependents(asset))
+				{
+					if (affected.insert(d).second)
+					{
+						changed.push_back(std::move(d));
+					}
+				}
+			}
+			return manager->Rebuild(affected);
+		}
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,409 @@
+#include "BakedModel.hpp"
+#include "MappedFile.hpp"
+#include "ModelLoader.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		using Utilities::MappedFile;
+
+		//File layout: a header, then the mesh and node tables, then
+		//attribute, stream and name data, then the vertex and index blobs.
+		//Offsets are from the start of the file and every section starts on
+		//a BakeAlignment boundary. Values are in the writer's byte order;
+		//a reader of the other order sees a bad magic and re-bakes.
+		static const constexpr std::uint32_t BakeMagic = 0x4D425047; //"GPBM"
+		//Bump whenever the layout, or anything that changes packed output, changes.
+		static const constexpr std::uint32_t BakeVersion = 2;
+		static const constexpr std::size_t BakeAlignment = 16;
+
+		struct BakedHeader
+		{
+			std::uint32_t magic;
+			std::uint32_t version;
+			std::uint64_t sourceKey;
+			std::int32_t splitTriangleLimit;
+			std::int32_t splitVertexLimit;
+			std::uint32_t meshCount;
+			std::uint32_t nodeCount;
+			std::uint64_t meshTableOffset;
+			std::uint64_t nodeTableOffset;
+		};
+		struct BakedMeshRecord
+		{
+			std::uint64_t nameOffset;
+			std::uint64_t attributesOffset;
+			std::uint64_t streamsOffset;
+			std::uint64_t indicesOffset;
+			std::uint32_t nameLength;
+			std::uint32_t attributeCount;
+			std::uint32_t streamCount;
+			std::uint32_t vertexCount;
+			std::uint32_t indexCount;
+			std::uint32_t indexType;
+			std::uint32_t vertsPerPrimitive;
+			std::uint32_t triangleCount;
+			float acmrBefore;
+			float acmrAfter;
+		};
+		struct BakedAttribute
+		{
+			std::uint32_t slot;
+			std::uint32_t type;
+			std::int32_t components;
+			std::uint32_t normalised;
+			std::uint32_t stream;
+			std::uint32_t offset;
+			std::uint32_t encoding;
+			std::uint32_t padding;
+		};
+		struct BakedStream
+		{
+			std::uint64_t offset;
+			std::uint32_t stride;
+			std::uint32_t padding;
+		};
+		struct BakedNode
+		{
+			float transform[16];
+			std::uint64_t parent;
+			std::uint64_t nameOffset;
+			std::uint64_t meshesOffset;
+			std::uint32_t nameLength;
+			std::uint32_t meshCount;
+		};
+
+		namespace
+		{
+			class BakeWriter
+			{
+				std::vector<unsigned char> bytes;
+			public:
+				std::uint64_t Align()
+				{
+					bytes.resize((bytes.size() + BakeAlignment - 1) / BakeAlignment * BakeAlignment);
+					return bytes.size();
+				}
+				std::uint64_t Append(const void* data, std::size_t size)
+				{
+					auto offset = Align();
+					auto p = static_cast<const unsigned char*>(data);
+					bytes.insert(bytes.end(), p, p + size);
+					return offset;
+				}
+				//Space to be filled in later with Patch.
+				std::uint64_t Reserve(std::size_t size)
+				{
+					auto offset = Align();
+					bytes.resize(bytes.size() + size);
+					return offset;
+				}
+				void Patch(std::uint64_t offset, const void* data, std::size_t size)
+				{
+					std::memcpy(bytes.data() + offset, data, size);
+				}
+				const std::vector<unsigned char>& Bytes() const noexcept
+				{
+					return bytes;
+				}
+			};
+
+			class BakeReader
+			{
+				const MappedFile& file;
+			public:
+				explicit BakeReader(const MappedFile& f) noexcept
+					: file(f)
+				{}
+				bool InRange(std::uint64_t offset, std::uint64_t size) const noexcept
+				{
+					return offset <= file.Size() && size <= file.Size() - offset;
+				}
+				//Copies, as records in the mapping need not suit T's alignment
+				//should the file be malformed.
+				template<typename T>
+				bool Read(std::uint64_t offset, T& out) const noexcept
+				{
+					if (!InRange(offset, sizeof(T))) return false;
+					std::memcpy(&out, file.Data() + offset, sizeof(T));
+					return true;
+				}
+				bool ReadString(std::uint64_t offset, std::uint32_t length, std::string& out) const
+				{
+					if (!InRange(offset, length)) return false;
+					out.assign(reinterpret_cast<const char*>(file.Data() + offset), length);
+					return true;
+				}
+				const unsigned char* Pointer(std::uint64_t offset) const noexcept
+				{
+					return file.Data() + offset;
+				}
+			};
+		}
+
+		std::string BakedModelPath(const std::string& sourcePath)
+		{
+			return sourcePath + ".bake";
+		}
+
+		void WriteBakedModel(const std::string& path, std::uint64_t sourceKey,
+			const ModelImportSettings& settings, const BakedModel& model)
+		{
+			BakeWriter out;
+
+			BakedHeader header{};
+			header.magic = BakeMagic;
+			header.version = BakeVersion;
+			header.sourceKey = sourceKey;
+			header.splitTriangleLimit = settings.splitTriangleLimit;
+			header.splitVertexLimit = settings.splitVertexLimit;
+			header.meshCount = std::uint32_t(model.meshes.size());
+			header.nodeCount = std::uint32_t(model.hierarchy.size());
+			out.Reserve(sizeof(header));
+			header.meshTableOffset = out.Reserve(sizeof(BakedMeshRecord) * header.meshCount);
+			header.nodeTableOffset = out.Reserve(sizeof(BakedNode) * header.nodeCount);
+			out.Patch(0, &header, sizeof(header));
+
+			for (std::uint32_t m = 0; m < header.meshCount; ++m)
+			{
+				const auto& mesh = model.meshes[m];
+				const auto& view = mesh.view;
+
+				BakedMeshRecord record{};
+				record.nameOffset = out.Append(mesh.name.data(), mesh.name.size());
+				record.nameLength = std::uint32_t(mesh.name.size());
+				record.vertexCount = view.vertexCount;
+				record.indexCount = view.indexCount;
+				record.indexType = std::uint32_t(view.indexType);
+				record.vertsPerPrimitive = view.vertsPerPrimitive;
+				record.triangleCount = mesh.report.triangleCount;
+				record.acmrBefore = mesh.report.acmrBefore;
+				record.acmrAfter = mesh.report.acmrAfter;
+
+				std::vector<BakedAttribute> attributes;
+				for (const auto& a : view.layout.attributes)
+				{
+					attributes.push_back({ std::uint32_t(a.slot), a.type, a.components, a.normalised,
+						a.stream, a.offset, std::uint32_t(a.encoding), 0 });
+				}
+				record.attributeCount = std::uint32_t(attributes.size());
+				record.attributesOffset = out.Append(attributes.data(), attributes.size() * sizeof(BakedAttribute));
+
+				std::vector<BakedStream> streams;
+				for (std::size_t s = 0; s < view.streams.size(); ++s)
+				{
+					auto stride = view.layout.streamStrides[s];
+					auto offset = out.Append(view.streams[s], std::size_t(stride) * view.vertexCount);
+					streams.push_back({ offset, std::uint32_t(stride), 0 });
+				}
+				record.streamCount = std::uint32_t(streams.size());
+				record.streamsOffset = out.Append(streams.data(), streams.size() * sizeof(BakedStream));
+
+				//Stored in the final index format, so loading needs no conversion.
+				if (view.indexDataType != view.indexType)
+				{
+					auto wide = static_cast<const unsigned int*>(view.indices);
+					std::vector<std::uint16_t> narrow(wide, wide + view.indexCount);
+					record.indicesOffset = out.Append(narrow.data(), narrow.size() * sizeof(std::uint16_t));
+				}
+				else
+				{
+					record.indicesOffset = out.Append(view.indices, std::size_t(view.indexCount) * SizeOfIndex(view.indexType));
+				}
+
+				out.Patch(header.meshTableOffset + m * sizeof(BakedMeshRecord), &record, sizeof(record));
+			}
+
+			const auto& hierarchy = model.hierarchy;
+			for (std::uint32_t n = 0; n < header.nodeCount; ++n)
+			{
+				const auto& data = hierarchy[n];
+
+				BakedNode node{};
+				std::memcpy(node.transform, &data.transform[0][0], sizeof(node.transform));
+				node.parent = hierarchy.parent(n);
+				node.nameOffset = out.Append(data.name.data(), data.name.size());
+				node.nameLength = std::uint32_t(data.name.size());
+				node.meshesOffset = out.Append(data.meshes.data(), data.meshes.size() * sizeof(unsigned int));
+				node.meshCount = std::uint32_t(data.meshes.size());
+
+				out.Patch(header.nodeTableOffset + n * sizeof(BakedNode), &node, sizeof(node));
+			}
+
+			//Written aside and renamed into place, so a reader never maps a
+			//half-written file.
+			auto tempPath = path + ".tmp";
+			{
+				std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+				file.write(reinterpret_cast<const char*>(out.Bytes().data()), std::streamsize(out.Bytes().size()));
+				if (!file)
+				{
+					throw std::runtime_error("Failed to write baked model.\nPath: " + tempPath + '\n');
+				}
+			}
+			std::remove(path.c_str());
+			if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+			{
+				std::remove(tempPath.c_str());
+				throw std::runtime_error("Failed to write baked model.\nPath: " + path + '\n');
+			}
+		}
+
+		//Size in bytes of one attribute of one vertex, for the types and
+		//component counts PackMesh writes; 0 for anything else.
+		static std::uint32_t SizeOfBakedAttribute(std::uint32_t type, std::int32_t components)
+		{
+			if (components < 1 || components > 4) return 0;
+			switch (type)
+			{
+			default:
+				return 0;
+			case GL_FLOAT:
+				return std::uint32_t(components) * sizeof(GLfloat);
+			case GL_HALF_FLOAT:
+				return std::uint32_t(components) * sizeof(GLhalf);
+			case GL_SHORT:
+				return std::uint32_t(components) * sizeof(GLshort);
+			case GL_UNSIGNED_BYTE:
+				return std::uint32_t(components) * sizeof(GLubyte);
+			case GL_INT_2_10_10_10_REV:
+				return components == 4 ? std::uint32_t(sizeof(GLuint)) : 0;
+			}
+		}
+
+		static bool IndicesInRange(const void* indices, IndexType type, std::uint32_t count, std::uint32_t vertexCount)
+		{
+			for (std::uint32_t i = 0; i < count; ++i)
+			{
+				std::uint32_t index;
+				if (type == IndexType::unsigned_short)
+				{
+					std::uint16_t narrow;
+					std::memcpy(&narrow, static_cast<const unsigned char*>(indices) + i * sizeof(narrow), sizeof(narrow));
+					index = narrow;
+				}
+				else
+				{
+					std::memcpy(&index, static_cast<const unsigned char*>(indices) + i * sizeof(index), sizeof(index));
+				}
+				if (index >= vertexCount) return false;
+			}
+			return true;
+		}
+
+		bool ReadBakedModel(const std::string& path, std::uint64_t sourceKey,
+			const ModelImportSettings& settings, BakedModel& out)
+		{
+			auto file = std::make_shared<MappedFile>(path);
+			BakeReader in(*file);
+
+			BakedHeader header;
+			if (!in.Read(0, header)
+				|| header.magic != BakeMagic
+				|| header.version != BakeVersion
+				|| header.sourceKey != sourceKey
+				|| header.splitTriangleLimit != settings.splitTriangleLimit
+				|| header.splitVertexLimit != settings.splitVertexLimit)
+			{
+				return false;
+			}
+
+			BakedModel model;
+			model.meshes.resize(header.meshCount);
+			for (std::uint32_t m = 0; m < header.meshCount; ++m)
+			{
+				BakedMeshRecord record;
+				if (!in.Read(header.meshTableOffset + std::uint64_t(m) * sizeof(BakedMeshRecord), record)) return false;
+				if (record.indexType != std::uint32_t(IndexType::unsigned_short)
+					&& record.indexType != std::uint32_t(IndexType::unsigned_int))
+				{
+					return false;
+				}
+
+				auto& mesh = model.meshes[m];
+				if (!in.ReadString(record.nameOffset, record.nameLength, mesh.name)) return false;
+				mesh.report.triangleCount = record.triangleCount;
+				mesh.report.acmrBefore = record.acmrBefore;
+				mesh.report.acmrAfter = record.acmrAfter;
+
+				auto& view = mesh.view;
+				view.vertexCount = record.vertexCount;
+				view.indexCount = record.indexCount;
+				view.indexType = IndexType(record.indexType);
+				view.indexDataType = view.indexType;
+				view.vertsPerPrimitive = record.vertsPerPrimitive;
+
+				for (std::uint32_t s = 0; s < record.streamCount; ++s)
+				{
+					BakedStream stream;
+					if (!in.Read(record.streamsOffset + std::uint64_t(s) * sizeof(BakedStream), stream)) return false;
+					if (!in.InRange(stream.offset, std::uint64_t(stream.stride) * record.vertexCount)) return false;
+					view.layout.streamStrides.push_back(GLsizei(stream.stride));
+					view.streams.push_back(in.Pointer(stream.offset));
+				}
+				for (std::uint32_t a = 0; a < record.attributeCount; ++a)
+				{
+					BakedAttribute attribute;
+					if (!in.Read(record.attributesOffset + std::uint64_t(a) * sizeof(BakedAttribute), attribute)) return false;
+					if (attribute.stream >= record.streamCount
+						|| attribute.encoding > std::uint32_t(AttributeEncoding::SignedTangent))
+					{
+						return false;
+					}
+					//Checked in 64 bits, so a huge offset cannot wrap past the stride.
+					auto size = SizeOfBakedAttribute(attribute.type, attribute.components);
+					if (size == 0 || std::uint64_t(attribute.offset) + size
+						> std::uint64_t(view.layout.streamStrides[attribute.stream]))
+					{
+						return false;
+					}
+					view.layout.attributes.push_back({ MeshSlots(attribute.slot), attribute.type, attribute.components,
+						GLboolean(attribute.normalised), attribute.stream, attribute.offset, AttributeEncoding(attribute.encoding) });
+				}
+				if (!in.InRange(record.indicesOffset, std::uint64_t(record.indexCount) * SizeOfIndex(view.indexType))) return false;
+				view.indices = in.Pointer(record.indicesOffset);
+				//An index past the vertices would read outside the arena range.
+				if (!IndicesInRange(view.indices, view.indexType, record.indexCount, record.vertexCount)) return false;
+
+				mesh.owner = file;
+			}
+
+			model.hierarchy.reserve(header.nodeCount);
+			for (std::uint32_t n = 0; n < header.nodeCount; ++n)
+			{
+				BakedNode node;
+				if (!in.Read(header.nodeTableOffset + std::uint64_t(n) * sizeof(BakedNode), node)) return false;
+				//Depth-first order means every parent has already been read.
+				if (node.parent != model.hierarchy.npos && node.parent >= n) return false;
+				if (!in.InRange(node.meshesOffset, std::uint64_t(node.meshCount) * sizeof(unsigned int))) return false;
+
+				ModelData data;
+				std::memcpy(&data.transform[0][0], node.transform, sizeof(node.transform));
+				if (!in.ReadString(node.nameOffset, node.nameLength, data.name)) return false;
+				data.meshes.resize(node.meshCount);
+				if (node.meshCount > 0)
+				{
+					std::memcpy(data.meshes.data(), in.Pointer(node.meshesOffset), node.meshCount * sizeof(unsigned int));
+				}
+				for (auto i : data.meshes)
+				{
+					if (i >= header.meshCount) return false;
+				}
+
+				//Appending in depth-first order keeps the stored indices.
+				model.hierarchy.emplace(std::size_t(node.parent), std::move(data));
+			}
+
+			out = std::move(model);
+			return true;
+		}
+	}
+}
@@ -0,0 +1,314 @@
+#include "CompressedImage.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		namespace
+		{
+			[[noreturn]] void ThrowImageError(const std::string& path, const char* reason)
+			{
+				std::string err = "Loading of compressed image failed.\n";
+				err += "Path: " + path + '\n';
+				err += "Reason: ";
+				err += reason;
+				err += '\n';
+				throw std::runtime_error(err);
+			}
+
+			template<typename T>
+			T ReadAt(const Utilities::MappedFile& file, std::size_t offset, const std::string& path)
+			{
+				if (offset > file.Size() || sizeof(T) > file.Size() - offset)
+				{
+					ThrowImageError(path, "File is truncated.");
+				}
+				T value;
+				std::memcpy(&value, file.Data() + offset, sizeof(T));
+				return value;
+			}
+
+			std::uint32_t FourCC(char a, char b, char c, char d) noexcept
+			{
+				return std::uint32_t(std::uint8_t(a)) | (std::uint32_t(std::uint8_t(b)) << 8)
+					| (std::uint32_t(std::uint8_t(c)) << 16) | (std::uint32_t(std::uint8_t(d)) << 24);
+			}
+
+			//Lays out 'levelCount' tightly packed levels from 'offset' on.
+			void AddPackedLevels(CompressedImage& image, std::size_t offset, std::uint32_t levelCount)
+			{
+				auto width = image.width, height = image.height;
+				for (std::uint32_t i = 0; i < levelCount; ++i)
+				{
+					auto size = CompressedLevelSize(image.internalFormat, width, height);
+					image.levels.push_back({ width, height, offset, size });
+					offset += size;
+					if (width == 1 && height == 1) break;
+					width = std::max(width / 2, 1);
+					height = std::max(height / 2, 1);
+				}
+			}
+
+			GLenum FormatFromDxgi(std::uint32_t dxgi) noexcept
+			{
+				switch (dxgi)
+				{
+				case 71: return GL_COMPRESSED_RGBA_S3TC_DXT1;
+				case 72: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1;
+				case 74: return GL_COMPRESSED_RGBA_S3TC_DXT3;
+				case 75: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3;
+				case 77: return GL_COMPRESSED_RGBA_S3TC_DXT5;
+				case 78: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5;
+				case 80: return GL_COMPRESSED_RED_RGTC1;
+				case 81: return GL_COMPRESSED_SIGNED_RED_RGTC1;
+				case 83: return GL_COMPRESSED_RG_RGTC2;
+				case 84: return GL_COMPRESSED_SIGNED_RG_RGTC2;
+				case 95: return GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+				case 96: return GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT;
+				case 98: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+				case 99: return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+				default: return GL_NONE;
+				}
+			}
+			GLenum FormatFromVulkan(std::uint32_t vkFormat) noexcept
+			{
+				switch (vkFormat)
+				{
+				case 131: return GL_COMPRESSED_RGB_S3TC_DXT1;
+				case 132: return GL_COMPRESSED_SRGB_S3TC_DXT1;
+				case 133: return GL_COMPRESSED_RGBA_S3TC_DXT1;
+				case 134: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1;
+				case 135: return GL_COMPRESSED_RGBA_S3TC_DXT3;
+				case 136: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3;
+				case 137: return GL_COMPRESSED_RGBA_S3TC_DXT5;
+				case 138: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5;
+				case 139: return GL_COMPRESSED_RED_RGTC1;
+				case 140: return GL_COMPRESSED_SIGNED_RED_RGTC1;
+				case 141: return GL_COMPRESSED_RG_RGTC2;
+				case 142: return GL_COMPRESSED_SIGNED_RG_RGTC2;
+				case 143: return GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+				case 144: return GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT;
+				case 145: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+				case 146: return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+				default: return GL_NONE;
+				}
+			}
+
+			void ReadDds(CompressedImage& image, const std::string& path)
+			{
+				const auto& file = *image.file;
+				//Offsets within the 124 byte DDS_HEADER that follows the magic.
+				auto flags = ReadAt<std::uint32_t>(file, 8, path);
+				image.height = GLsizei(ReadAt<std::uint32_t>(file, 12, path));
+				image.width = GLsizei(ReadAt<std::uint32_t>(file, 16, path));
+				auto mipCount = ReadAt<std::uint32_t>(file, 28, path);
+				auto fourCC = ReadAt<std::uint32_t>(file, 84, path);
+				auto caps2 = ReadAt<std::uint32_t>(file, 112, path);
+				std::size_t dataOffset = 128;
+
+				const std::uint32_t mipCountFlag = 0x20000, cubemapFlag = 0x200, volumeFlag = 0x200000;
+				if ((caps2 & (cubemapFlag | volumeFlag)) != 0)
+				{
+					ThrowImageError(path, "Only 2D images are supported.");
+				}
+
+				if (fourCC == FourCC('D', 'X', 'T', '1')) image.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1;
+				else if (fourCC == FourCC('D', 'X', 'T', '3')) image.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT3;
+				else if (fourCC == FourCC('D', 'X', 'T', '5')) image.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5;
+				else if (fourCC == FourCC('A', 'T', 'I', '1') || fourCC == FourCC('B', 'C', '4', 'U')) image.internalFormat = GL_COMPRESSED_RED_RGTC1;
+				else if (fourCC == FourCC('A', 'T', 'I', '2') || fourCC == FourCC('B', 'C', '5', 'U')) image.internalFormat = GL_COMPRESSED_RG_RGTC2;
+				else if (fourCC == FourCC('D', 'X', '1', '0'))
+				{
+					//DDS_HEADER_DXT10 follows the main header.
+					image.internalFormat = FormatFromDxgi(ReadAt<std::uint32_t>(file, 128, path));
+					auto dimension = ReadAt<std::uint32_t>(file, 132, path);
+					auto miscFlag = ReadAt<std::uint32_t>(file, 136, path);
+					auto arraySize = ReadAt<std::uint32_t>(file, 140, path);
+					const std::uint32_t texture2D = 3;
+					const std::uint32_t textureCubeFlag = 0x4;
+					if (dimension != texture2D || (miscFlag & textureCubeFlag) != 0 || arraySize > 1)
+					{
+						ThrowImageError(path, "Only 2D images are supported.");
+					}
+					dataOffset += 20;
+				}
+				if (image.internalFormat == GL_NONE)
+				{
+					ThrowImageError(path, "Pixel format is not BC1-BC7.");
+				}
+
+				AddPackedLevels(image, dataOffset, (flags & mipCountFlag) != 0 ? std::max(mipCount, 1u) : 1u);
+			}
+
+			void ReadKtx(CompressedImage& image, const std::string& path)
+			{
+				const auto& file = *image.file;
+				if (ReadAt<std::uint32_t>(file, 12, path) != 0x04030201)
+				{
+					ThrowImageError(path, "Byte order differs from this machine's.");
+				}
+				auto glType = ReadAt<std::uint32_t>(file, 16, path);
+				image.internalFormat = GLenum(ReadAt<std::uint32_t>(file, 28, path));
+				image.width = GLsizei(ReadAt<std::uint32_t>(file, 36, path));
+				image.height = GLsizei(ReadAt<std::uint32_t>(file, 40, path));
+				auto depth = ReadAt<std::uint32_t>(file, 44, path);
+				auto arrayElements = ReadAt<std::uint32_t>(file, 48, path);
+				auto faces = ReadAt<std::uint32_t>(file, 52, path);
+				auto levelCount = std::max(ReadAt<std::uint32_t>(file, 56, path), 1u);
+				auto keyValueBytes = ReadAt<std::uint32_t>(file, 60, path);
+
+				if (glType != 0 || BlockSize(image.internalFormat) == 0)
+				{
+					ThrowImageError(path, "Pixel format is not BC1-BC7.");
+				}
+				if (depth > 1 || arrayElements > 1 || faces > 1)
+				{
+					ThrowImageError(path, "Only 2D images are supported.");
+				}
+
+				//Each level is prefixed by its size. BCn blocks keep every
+				//level a multiple of four bytes, so there is no padding.
+				std::size_t offset = 64 + std::size_t(keyValueBytes);
+				AddPackedLevels(image, 0, levelCount);
+				for (auto& level : image.levels)
+				{
+					if (ReadAt<std::uint32_t>(file, offset, path) != level.size)
+					{
+						ThrowImageError(path, "Level size does not match its format.");
+					}
+					level.offset = offset + 4;
+					offset = level.offset + level.size;
+				}
+			}
+
+			void ReadKtx2(CompressedImage& image, const std::string& path)
+			{
+				const auto& file = *image.file;
+				image.internalFormat = FormatFromVulkan(ReadAt<std::uint32_t>(file, 12, path));
+				image.width = GLsizei(ReadAt<std::uint32_t>(file, 20, path));
+				image.height = GLsizei(ReadAt<std::uint32_t>(file, 24, path));
+				auto depth = ReadAt<std::uint32_t>(file, 28, path);
+				auto layers = ReadAt<std::uint32_t>(file, 32, path);
+				auto faces = ReadAt<std::uint32_t>(file, 36, path);
+				auto levelCount = std::max(ReadAt<std::uint32_t>(file, 40, path), 1u);
+				auto supercompression = ReadAt<std::uint32_t>(file, 44, path);
+
+				if (image.internalFormat == GL_NONE)
+				{
+					ThrowImageError(path, "Pixel format is not BC1-BC7.");
+				}
+				if (supercompression != 0)
+				{
+					ThrowImageError(path, "Supercompressed images are not supported.");
+				}
+				if (depth > 1 || layers > 1 || faces > 1)
+				{
+					ThrowImageError(path, "Only 2D images are supported.");
+				}
+
+				//The level index follows the 80 byte header and section index.
+				AddPackedLevels(image, 0, levelCount);
+				for (std::size_t i = 0; i < image.levels.size(); ++i)
+				{
+					auto entry = 80 + i * 24;
+					auto offset = ReadAt<std::uint64_t>(file, entry, path);
+					auto length = ReadAt<std::uint64_t>(file, entry + 8, path);
+					if (length != image.levels[i].size)
+					{
+						ThrowImageError(path, "Level size does not match its format.");
+					}
+					image.levels[i].offset = std::size_t(offset);
+				}
+			}
+		}
+
+		std::size_t BlockSize(GLenum internalFormat) noexcept
+		{
+			switch (internalFormat)
+			{
+			case GL_COMPRESSED_RGB_S3TC_DXT1:
+			case GL_COMPRESSED_RGBA_S3TC_DXT1:
+			case GL_COMPRESSED_SRGB_S3TC_DXT1:
+			case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1:
+			case GL_COMPRESSED_RED_RGTC1:
+			case GL_COMPRESSED_SIGNED_RED_RGTC1:
+				return 8;
+			case GL_COMPRESSED_RGBA_S3TC_DXT3:
+			case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3:
+			case GL_COMPRESSED_RGBA_S3TC_DXT5:
+			case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5:
+			case GL_COMPRESSED_RG_RGTC2:
+			case GL_COMPRESSED_SIGNED_RG_RGTC2:
+			case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+			case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+			case GL_COMPRESSED_RGBA_BPTC_UNORM:
+			case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+				return 16;
+			default:
+				return 0;
+			}
+		}
+		std::size_t CompressedLevelSize(GLenum internalFormat, GLsizei width, GLsizei height) noexcept
+		{
+			auto blocksWide = std::size_t(std::max((width + 3) / 4, 1));
+			auto blocksHigh = std::size_t(std::max((height + 3) / 4, 1));
+			return blocksWide * blocksHigh * BlockSize(internalFormat);
+		}
+
+		bool IsCompressedImageFile(const std::string& path)
+		{
+			auto dot = path.find_last_of('.');
+			if (dot == std::string::npos) return false;
+			auto extension = path.substr(dot + 1);
+			std::transform(extension.begin(), extension.end(), extension.begin(), [](char c)
+			{
+				return char(std::tolower(static_cast<unsigned char>(c)));
+			});
+			return extension == "dds" || extension == "ktx" || extension == "ktx2";
+		}
+
+		CompressedImage ReadCompressedImage(const std::string& path)
+		{
+			CompressedImage image;
+			image.file = std::make_shared<Utilities::MappedFile>(path);
+			const auto& file = *image.file;
+
+			static const unsigned char ktxIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+			static const unsigned char ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+			if (file.Size() >= 4 && ReadAt<std::uint32_t>(file, 0, path) == FourCC('D', 'D', 'S', ' '))
+			{
+				ReadDds(image, path);
+			}
+			else if (file.Size() >= 12 && std::memcmp(file.Data(), ktxIdentifier, 12) == 0)
+			{
+				ReadKtx(image, path);
+			}
+			else if (file.Size() >= 12 && std::memcmp(file.Data(), ktx2Identifier, 12) == 0)
+			{
+				ReadKtx2(image, path);
+			}
+			else
+			{
+				ThrowImageError(path, "Not a DDS, KTX or KTX2 file.");
+			}
+
+			if (image.width <= 0 || image.height <= 0)
+			{
+				ThrowImageError(path, "Image is empty.");
+			}
+			for (const auto& level : image.levels)
+			{
+				if (level.offset > file.Size() || level.size > file.Size() - level.offset)
+				{
+					ThrowImageError(path, "File is truncated.");
+				}
+			}
+			return image;
+		}
+	}
+}
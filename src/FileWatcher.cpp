@@ -0,0 +1,126 @@
+#include "FileWatcher.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__linux__)
+	#include <sys/inotify.h>
+	#include <unistd.h>
+#endif
+
+namespace GlProj
+{
+	namespace Utilities
+	{
+		const constexpr std::chrono::milliseconds FileWatcher::PollInterval;
+
+		static void SplitPath(const std::string& path, std::string& directory, std::string& name)
+		{
+			auto slash = path.find_last_of("/\\");
+			if (slash == std::string::npos)
+			{
+				directory.clear();
+				name = path;
+				return;
+			}
+			directory = path.substr(0, slash);
+			name = path.substr(slash + 1);
+		}
+
+#if defined(__linux__)
+		FileWatcher::FileWatcher()
+			: inotify(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+		{
+			if (inotify < 0)
+			{
+				throw std::runtime_error("Failed to start watching files.\n");
+			}
+		}
+		FileWatcher::~FileWatcher()
+		{
+			close(inotify);
+		}
+		void FileWatcher::Watch(const std::string& path)
+		{
+			if (!files.insert(path).second) return;
+
+			//Directories are watched rather than files, as saving by
+			//replacement would otherwise end the watch.
+			std::string directory, name;
+			SplitPath(path, directory, name);
+			if (directories.count(directory) != 0) return;
+
+			auto descriptor = inotify_add_watch(inotify, directory.empty() ? "." : directory.c_str(),
+				IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+			if (descriptor < 0)
+			{
+				files.erase(path);
+				throw std::runtime_error("Failed to watch directory.\nPath: " + directory + '\n');
+			}
+			directories.emplace(directory, descriptor);
+			watchedDirectories.emplace(descriptor, directory);
+		}
+		std::vector<std::string> FileWatcher::Poll()
+		{
+			std::vector<std::string> changed;
+			alignas(inotify_event) char buffer[4096];
+			for (;;)
+			{
+				auto length = read(inotify, buffer, sizeof(buffer));
+				if (length <= 0) break;
+
+				for (auto p = buffer; p < buffer + length;)
+				{
+					auto event = reinterpret_cast<const inotify_event*>(p);
+					p += sizeof(inotify_event) + event->len;
+
+					auto directory = watchedDirectories.find(event->wd);
+					if (directory == watchedDirectories.end() || event->len == 0) continue;
+
+					auto path = directory->second.empty()
+						? std::string(event->name)
+						: directory->second + '/' + event->name;
+					if (files.count(path) != 0 && std::find(changed.begin(), changed.end(), path) == changed.end())
+					{
+						changed.push_back(std::move(path));
+					}
+				}
+			}
+			return changed;
+		}
+#else
+		FileWatcher::FileWatcher()
+			: lastPoll(std::chrono::steady_clock::now())
+		{}
+		FileWatcher::~FileWatcher() = default;
+		void FileWatcher::Watch(const std::string& path)
+		{
+			if (!files.insert(path).second) return;
+
+			FileStamp stamp;
+			GetFileStamp(path, stamp);
+			stamps.emplace(path, stamp);
+		}
+		std::vector<std::string> FileWatcher::Poll()
+		{
+			std::vector<std::string> changed;
+			auto now = std::chrono::steady_clock::now();
+			if (now - lastPoll < PollInterval) return changed;
+			lastPoll = now;
+
+			for (auto& s : stamps)
+			{
+				FileStamp stamp;
+				//A file mid-replacement may briefly not exist.
+				if (!GetFileStamp(s.first, stamp) || stamp == s.second) continue;
+				s.second = stamp;
+				changed.push_back(s.first);
+			}
+			return changed;
+		}
+#endif
+		bool FileWatcher::IsWatched(const std::string& path) const
+		{
+			return files.count(path) != 0;
+		}
+	}
+}
@@ -0,0 +1,130 @@
+#include "GpuUploader.hpp"
+#include "GLFW/glfw3.h"
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		UploadFence::~UploadFence()
+		{
+			auto s = sync.load(std::memory_order_relaxed);
+			if (s != nullptr)
+			{
+				glDeleteSync(s);
+			}
+		}
+		bool UploadFence::IsComplete()
+		{
+			if (complete) return true;
+			if (!submitted.load(std::memory_order_acquire)) return false;
+
+			if (glClientWaitSync(sync.load(std::memory_order_relaxed), 0, 0) == GL_TIMEOUT_EXPIRED)
+			{
+				return false;
+			}
+			complete = true;
+			return true;
+		}
+		UploadState UploadFence::GetState()
+		{
+			if (!IsComplete()) return UploadState::Pending;
+			return error.empty() ? UploadState::Complete : UploadState::Failed;
+		}
+		void UploadFence::Wait()
+		{
+			while (!submitted.load(std::memory_order_acquire))
+			{
+				std::this_thread::yield();
+			}
+			const GLuint64 oneMillisecond = 1000000;
+			while (!complete)
+			{
+				complete = glClientWaitSync(sync.load(std::memory_order_relaxed), 0, oneMillisecond) != GL_TIMEOUT_EXPIRED;
+			}
+		}
+		const std::string& UploadFence::GetError() const noexcept
+		{
+			return error;
+		}
+
+		GpuUploader::GpuUploader(GLFWwindow* shareWith, std::size_t queueCapacity)
+			: requests(queueCapacity)
+		{
+			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+			context = glfwCreateWindow(1, 1, "Upload", nullptr, shareWith);
+			glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+			if (context == nullptr)
+			{
+				throw std::runtime_error("Failed to create the upload context.");
+			}
+
+			thread = std::thread(&GpuUploader::ThreadLoop, this);
+		}
+		GpuUploader::~GpuUploader()
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				stopping = true;
+			}
+			wake.notify_one();
+			thread.join();
+
+			glfwDestroyWindow(context);
+		}
+		std::shared_ptr<UploadFence> GpuUploader::Submit(std::function<void()> upload)
+		{
+			auto fence = std::make_shared<UploadFence>();
+			Request r{ std::move(upload), fence };
+			while (!requests.TryPush(r))
+			{
+				wake.notify_one();
+				std::this_thread::yield();
+			}
+			wake.notify_one();
+			return fence;
+		}
+		void GpuUploader::ThreadLoop()
+		{
+			glfwMakeContextCurrent(context);
+
+			Request r;
+			while (true)
+			{
+				if (!requests.TryPop(r))
+				{
+					std::unique_lock<std::mutex> lock(sleepMutex);
+					//Anything submitted before stopping is still processed.
+					if (stopping && requests.empty()) break;
+					wake.wait_for(lock, std::chrono::milliseconds(1));
+					continue;
+				}
+
+				try
+				{
+					r.upload();
+				}
+				catch (const std::exception& e)
+				{
+					r.fence->error = e.what();
+				}
+				catch (...)
+				{
+					r.fence->error = "Unknown error during upload.";
+				}
+
+				r.fence->sync.store(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), std::memory_order_relaxed);
+				//Without a flush the fence may never reach the GPU, as this
+				//context does nothing else to push it out.
+				glFlush();
+				r.fence->submitted.store(true, std::memory_order_release);
+				r = Request();
+			}
+
+			glfwMakeContextCurrent(nullptr);
+		}
+	}
+}
@@ -0,0 +1,369 @@
+#include "JobSystem.hpp"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+namespace GlProj
+{
+	namespace Utilities
+	{
+		struct Job
+		{
+			std::function<void()> task;
+			JobCounter* counter;
+		};
+
+		namespace
+		{
+			//Set on worker threads only; the main thread is found by id.
+			thread_local const JobSystem* currentSystem = nullptr;
+			thread_local std::size_t currentQueue = JobSystem::npos;
+		}
+
+		//Memory orderings follow Le et al., "Correct and Efficient
+		//Work-Stealing for Weak Memory Models" (2013).
+		WorkStealingQueue::WorkStealingQueue(std::size_t capacity)
+			: buffer(new std::atomic<Job*>[capacity])
+			, mask(std::ptrdiff_t(capacity) - 1)
+		{
+			if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+			{
+				throw std::logic_error("WorkStealingQueue capacity must be a power of two.");
+			}
+		}
+		bool WorkStealingQueue::Push(Job* job) noexcept
+		{
+			auto b = bottom.load(std::memory_order_relaxed);
+			auto t = top.load(std::memory_order_acquire);
+			if (b - t > mask) return false;
+
+			//Release/acquire on the slot as well as the fences, so the job's
+			//contents are visibly published to whichever thread takes it.
+			buffer[b & mask].store(job, std::memory_order_release);
+			std::atomic_thread_fence(std::memory_order_release);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return true;
+		}
+		Job* WorkStealingQueue::Pop() noexcept
+		{
+			auto b = bottom.load(std::memory_order_relaxed) - 1;
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			auto t = top.load(std::memory_order_relaxed);
+
+			if (t > b)
+			{
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+
+			auto job = buffer[b & mask].load(std::memory_order_relaxed);
+			if (t == b)
+			{
+				//Last job; race any thieves for it.
+				if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					job = nullptr;
+				}
+				bottom.store(b + 1, std::memory_order_relaxed);
+			}
+			return job;
+		}
+		Job* WorkStealingQueue::Steal() noexcept
+		{
+			auto t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			auto b = bottom.load(std::memory_order_acquire);
+			if (t >= b) return nullptr;
+
+			auto job = buffer[t & mask].load(std::memory_order_acquire);
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				return nullptr;
+			}
+			return job;
+		}
+
+		JobSystem::JobSystem(unsigned int workerCount)
+			: mainThread(std::this_thread::get_id())
+		{
+			//Queue 0 belongs to the creating thread.
+			for (unsigned int i = 0; i <= workerCount; ++i)
+			{
+				queues.push_back(std::make_unique<WorkStealingQueue>());
+			}
+			workers.reserve(workerCount);
+			for (unsigned int i = 1; i <= workerCount; ++i)
+			{
+				workers.emplace_back(&JobSystem::WorkerLoop, this, std::size_t(i));
+			}
+		}
+		JobSystem::~JobSystem()
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				stopping = true;
+			}
+			wake.notify_all();
+			for (auto& w : workers)
+			{
+				w.join();
+			}
+
+			for (auto& q : queues)
+			{
+				while (auto job = q->Pop()) delete job;
+			}
+			for (auto job : injected) delete job;
+			for (auto job : mainThreadJobs) delete job;
+		}
+		unsigned int JobSystem::DefaultWorkerCount() noexcept
+		{
+			return std::max(std::thread::hardware_concurrency(), 1u) - 1;
+		}
+		std::size_t JobSystem::WorkerCount() const noexcept
+		{
+			return workers.size();
+		}
+		bool JobSystem::IsMainThread() const noexcept
+		{
+			return std::this_thread::get_id() == mainThread;
+		}
+		void JobSystem::Run(std::function<void()> f, JobCounter* counter)
+		{
+			if (counter != nullptr)
+			{
+				counter->pending.fetch_add(1, std::memory_order_relaxed);
+			}
+			Enqueue(new Job{ std::move(f), counter });
+		}
+		void JobSystem::RunOnMainThread(std::function<void()> f, JobCounter* counter)
+		{
+			if (counter != nullptr)
+			{
+				counter->pending.fetch_add(1, std::memory_order_relaxed);
+			}
+			auto job = new Job{ std::move(f), counter };
+			std::lock_guard<std::mutex> lock(mainThreadMutex);
+			mainThreadJobs.push_back(job);
+			mainThreadCount.store(mainThreadJobs.size(), std::memory_order_relaxed);
+		}
+		void JobSystem::PumpMainThread()
+		{
+			assert(IsMainThread());
+			if (mainThreadCount.load(std::memory_order_relaxed) == 0) return;
+
+			//Swapped out first, as a job may queue more or pump again.
+			std::vector<Job*> jobs;
+			{
+				std::lock_guard<std::mutex> lock(mainThreadMutex);
+				jobs.swap(mainThreadJobs);
+				mainThreadCount.store(0, std::memory_order_relaxed);
+			}
+			for (auto job : jobs)
+			{
+				Execute(job);
+			}
+		}
+		void JobSystem::Wait(const JobCounter& counter)
+		{
+			WaitUntil([&counter]()
+			{
+				return counter.IsDone();
+			});
+		}
+		void JobSystem::WaitUntil(const std::function<bool()>& ready)
+		{
+			auto self = CurrentQueue();
+			while (!ready())
+			{
+				//The awaited jobs may include some pinned to this thread.
+				if (self == 0) PumpMainThread();
+				if (!RunOne(self))
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+		void JobSystem::ParallelFor(std::size_t count, const std::function<void(std::size_t)>& f, std::size_t grainSize)
+		{
+			grainSize = std::max(grainSize, std::size_t(1));
+			auto chunks = (count + grainSize - 1) / grainSize;
+			auto runChunk = [&f, count, grainSize](std::size_t c)
+			{
+				auto last = std::min(count, (c + 1) * grainSize);
+				for (auto i = c * grainSize; i < last; ++i)
+				{
+					f(i);
+				}
+			};
+
+			if (workers.empty() || chunks <= 1)
+			{
+				for (std::size_t c = 0; c < chunks; ++c)
+				{
+					runChunk(c);
+				}
+				return;
+			}
+
+			JobCounter counter;
+			for (std::size_t c = 1; c < chunks; ++c)
+			{
+				Run([&runChunk, c]() { runChunk(c); }, &counter);
+			}
+			runChunk(0);
+			Wait(counter);
+		}
+		void JobSystem::WorkerLoop(std::size_t index)
+		{
+			currentSystem = this;
+			currentQueue = index;
+
+			//Spin briefly before sleeping, so bursts of small jobs do not pay
+			//for a wake-up each. The timed wait covers a missed notify.
+			unsigned int idle = 0;
+			while (!stopping.load(std::memory_order_acquire))
+			{
+				if (RunOne(index))
+				{
+					idle = 0;
+					continue;
+				}
+				if (++idle < 64)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				if (stopping) break;
+				++sleepers;
+				wake.wait_for(lock, std::chrono::milliseconds(1));
+				--sleepers;
+			}
+
+			currentSystem = nullptr;
+			currentQueue = npos;
+		}
+		std::size_t JobSystem::CurrentQueue() const noexcept
+		{
+			if (currentSystem == this) return currentQueue;
+			return IsMainThread() ? 0 : npos;
+		}
+		bool JobSystem::RunOne(std::size_t self)
+		{
+			Job* job = nullptr;
+			if (self != npos)
+			{
+				job = queues[self]->Pop();
+			}
+			if (job == nullptr && injectedCount.load(std::memory_order_relaxed) > 0)
+			{
+				std::lock_guard<std::mutex> lock(injectedMutex);
+				if (!injected.empty())
+				{
+					job = injected.front();
+					injected.pop_front();
+					injectedCount.store(injected.size(), std::memory_order_relaxed);
+				}
+			}
+			if (job == nullptr)
+			{
+				//Start from the next queue along, so thieves spread out.
+				auto n = queues.size();
+				auto start = self == npos ? 0 : self + 1;
+				for (std::size_t k = 0; k < n && job == nullptr; ++k)
+				{
+					auto victim = (start + k) % n;
+					if (victim == self) continue;
+					job = queues[victim]->Steal();
+				}
+			}
+			if (job == nullptr) return false;
+
+			Execute(job);
+			return true;
+		}
+		void JobSystem::Enqueue(Job* job)
+		{
+			auto self = CurrentQueue();
+			if (self == npos || !queues[self]->Push(job))
+			{
+				std::lock_guard<std::mutex> lock(injectedMutex);
+				injected.push_back(job);
+				injectedCount.store(injected.size(), std::memory_order_relaxed);
+			}
+			if (sleepers.load(std::memory_order_relaxed) > 0)
+			{
+				wake.notify_one();
+			}
+		}
+		void JobSystem::Execute(Job* job)
+		{
+			job->task();
+			auto counter = job->counter;
+			delete job;
+			if (counter != nullptr)
+			{
+				counter->pending.fetch_sub(1, std::memory_order_release);
+			}
+		}
+
+#if defined(GLPROJ_RUN_BENCHMARKS)
+		void BenchmarkJobSystem()
+		{
+			using clock = std::chrono::high_resolution_clock;
+			auto maxWorkers = JobSystem::DefaultWorkerCount();
+
+			{
+				const int jobCount = 200000;
+				JobSystem jobs(maxWorkers);
+				JobCounter counter;
+				auto start = clock::now();
+				for (int i = 0; i < jobCount; ++i)
+				{
+					jobs.Run([]() {}, &counter);
+				}
+				jobs.Wait(counter);
+				auto end = clock::now();
+				std::cout << "Job system, " << maxWorkers << " workers: "
+					<< std::chrono::duration<double, std::nano>(end - start).count() / jobCount
+					<< " ns per empty job\n";
+			}
+
+			const std::size_t elementCount = 1 << 22;
+			std::vector<float> data(elementCount);
+			auto work = [&data](std::size_t i)
+			{
+				auto x = float(i);
+				for (int k = 0; k < 16; ++k)
+				{
+					x = std::sqrt(x + float(k));
+				}
+				data[i] = x;
+			};
+
+			double single = 0.0;
+			std::cout << "ParallelFor, " << elementCount << " elements (ms, speed-up):\n";
+			for (unsigned int workerCount = 0; workerCount <= maxWorkers; ++workerCount)
+			{
+				JobSystem jobs(workerCount);
+				auto start = clock::now();
+				jobs.ParallelFor(elementCount, work, 4096);
+				auto end = clock::now();
+
+				auto ms = std::chrono::duration<double, std::milli>(end - start).count();
+				if (workerCount == 0) single = ms;
+				std::cout << '\t' << workerCount + 1 << " threads: " << ms << ", " << single / ms << "x\n";
+			}
+		}
+#else
+		void BenchmarkJobSystem()
+		{}
+#endif
+	}
+}
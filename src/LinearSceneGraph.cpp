@@ -0,0 +1,57 @@
+#include "LinearSceneGraph.hpp"
+
+namespace GlProj
+{
+	namespace Utilities
+	{
+		void TestLinearSceneGraph()
+		{
+			const auto root = LinearSceneGraph<int>::npos;
+			auto t1 = LinearSceneGraph<int>();
+			auto n1 = t1.insert(root, 0);
+			t1.insert(root, (const int)1);
+			auto n3 = t1.emplace(root, 1729);
+			t1.emplace(n3, 1);
+			t1.emplace(n3, 2);
+			t1.emplace(n1, 1);
+			t1.emplace(n1, 2);
+			auto n4 = t1.emplace(n1, 3);
+			t1.insert(n4, 0);
+			t1.insert(n4, 1);
+			t1.insert(n4, 3);
+			t1.insert(n4, 4);
+			t1.verify_integrity();
+
+			n1 = t1.find(0);
+			n3 = t1.find(1729);
+			n4 = t1.find_child(n1, 3);
+			assert(t1.subtree_size(n1) == 8);
+			assert(t1.first_child(n4) == n4 + 1);
+			assert(t1.next_sibling(n1) == t1.subtree_end(n1));
+			assert(t1.parent(t1.next_sibling(n1)) == root);
+			t1.find(42);
+			t1.find_child(n3, 2);
+			std::vector<std::size_t> nodes;
+			t1.find_all_cached(0, std::equal_to<>(), nodes);
+			nodes.clear();
+			t1.find_all_children(n1, 0, std::equal_to<>());
+
+			t1.remove(n4);
+			t1.verify_integrity();
+			assert(t1.subtree_size(t1.find(0)) == 3);
+			t1.remove(t1.find(1729));
+			t1.verify_integrity();
+			assert(t1.size() == 4);
+
+			auto t2 = SceneGraph<int>();
+			t2.insert(nullptr, 0);
+			t2.insert(nullptr, 4);
+			auto m1 = t2.find(0);
+			t2.emplace(m1, 1);
+			t2.emplace(t2.emplace(m1, 2), 3);
+			auto flat = LinearSceneGraph<int>(t2);
+			flat.verify_integrity();
+			assert(flat.size() == 5 && flat.subtree_size(0) == 4);
+		}
+	}
+}
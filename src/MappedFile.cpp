@@ -0,0 +1,184 @@
+#include "MappedFile.hpp"
+#include <stdexcept>
+#include <utility>
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace GlProj
+{
+	namespace Utilities
+	{
+		static std::runtime_error MappingError(const std::string& path)
+		{
+			return std::runtime_error("Failed to map file into memory.\nPath: " + path + '\n');
+		}
+
+#if defined(_WIN32)
+		MappedFile::MappedFile(const std::string& path)
+		{
+			file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+				OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				file = nullptr;
+				throw MappingError(path);
+			}
+
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize))
+			{
+				Close();
+				throw MappingError(path);
+			}
+			size = std::size_t(fileSize.QuadPart);
+			//Empty files cannot be mapped, but are still valid files.
+			if (size == 0) return;
+
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping == nullptr)
+			{
+				Close();
+				throw MappingError(path);
+			}
+			data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			if (data == nullptr)
+			{
+				Close();
+				throw MappingError(path);
+			}
+		}
+		void MappedFile::Close() noexcept
+		{
+			if (data != nullptr) UnmapViewOfFile(data);
+			if (mapping != nullptr) CloseHandle(mapping);
+			if (file != nullptr) CloseHandle(file);
+			data = nullptr;
+			mapping = nullptr;
+			file = nullptr;
+			size = 0;
+		}
+		MappedFile::MappedFile(MappedFile&& x) noexcept
+			: data(x.data)
+			, size(x.size)
+			, file(x.file)
+			, mapping(x.mapping)
+		{
+			x.data = nullptr;
+			x.size = 0;
+			x.file = nullptr;
+			x.mapping = nullptr;
+		}
+		MappedFile& MappedFile::operator=(MappedFile&& x) noexcept
+		{
+			if (this != &x)
+			{
+				Close();
+				std::swap(data, x.data);
+				std::swap(size, x.size);
+				std::swap(file, x.file);
+				std::swap(mapping, x.mapping);
+			}
+			return *this;
+		}
+		bool GetFileStamp(const std::string& path, FileStamp& out)
+		{
+			WIN32_FILE_ATTRIBUTE_DATA attributes;
+			if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes))
+			{
+				return false;
+			}
+			out.size = (std::uint64_t(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+			out.modified = (std::int64_t(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+			return true;
+		}
+#else
+		MappedFile::MappedFile(const std::string& path)
+		{
+			auto fd = open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+			{
+				throw MappingError(path);
+			}
+
+			struct stat info;
+			if (fstat(fd, &info) != 0)
+			{
+				close(fd);
+				throw MappingError(path);
+			}
+			size = std::size_t(info.st_size);
+			if (size != 0)
+			{
+				auto mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (mapped == MAP_FAILED)
+				{
+					close(fd);
+					throw MappingError(path);
+				}
+				data = static_cast<const unsigned char*>(mapped);
+			}
+			//The mapping holds its own reference to the file.
+			close(fd);
+		}
+		void MappedFile::Close() noexcept
+		{
+			if (data != nullptr)
+			{
+				munmap(const_cast<unsigned char*>(data), size);
+			}
+			data = nullptr;
+			size = 0;
+		}
+		MappedFile::MappedFile(MappedFile&& x) noexcept
+			: data(x.data)
+			, size(x.size)
+		{
+			x.data = nullptr;
+			x.size = 0;
+		}
+		MappedFile& MappedFile::operator=(MappedFile&& x) noexcept
+		{
+			if (this != &x)
+			{
+				Close();
+				std::swap(data, x.data);
+				std::swap(size, x.size);
+			}
+			return *this;
+		}
+		bool GetFileStamp(const std::string& path, FileStamp& out)
+		{
+			struct stat info;
+			if (stat(path.c_str(), &info) != 0)
+			{
+				return false;
+			}
+			out.size = std::uint64_t(info.st_size);
+			//Nanoseconds, as whole seconds miss edits made within one.
+			out.modified = std::int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+			return true;
+		}
+#endif
+		MappedFile::~MappedFile()
+		{
+			Close();
+		}
+		const unsigned char* MappedFile::Data() const noexcept
+		{
+			return data;
+		}
+		std::size_t MappedFile::Size() const noexcept
+		{
+			return size;
+		}
+	}
+}
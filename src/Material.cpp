@@ -4,16 +4,19 @@
 #include "Camera.hpp"
 #include "ShadingProgram.hpp"
 #include "Texture.hpp"
+#include "TextureManager.hpp"
 #include "Sampler.hpp"
 #include "ShadingProgram.hpp"
 #include "glm.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
 #include <algorithm>
+#include <cstring>
 #include <iterator>
 #include <mutex>
 #include <stdexcept>
 #include <string>
+#include <tuple>
 #include <type_traits>
 
 template<typename T>
@@ -323,20 +326,188 @@ namespace GlProj
 		Material& Material::operator=(const LocalSharedPtr<ShadingProgram>& p)
 		{
 			program = p;
+			resolvedProgram = ShadingProgram::invalidHandle;
 
 			return *this;
 		}
+		void Material::ResolveTextureUniforms() const
+		{
+			auto handle = program->GetHandle();
+			auto locationOf = [this](const std::string& name)
+			{
+				auto found = program->FindUniform(name);
+				return found == program->UniformsEnd() ? GLint(-1) : found->location;
+			};
+
+			for (const auto& t : textures)
+			{
+				auto name = TextureSlotName(t.slot);
+				//Which unit a sampler reads is program state, so it is set
+				//once here rather than on every bind.
+				auto samplerLocation = locationOf(name);
+				if (samplerLocation != -1)
+				{
+					glProgramUniform1i(handle, samplerLocation, TextureSlotToGL(t.slot));
+				}
+				t.regionLocation = locationOf(name + "_region");
+				t.layerLocation = locationOf(name + "_layer");
+			}
+			resolvedProgram = handle;
+		}
+		static_assert(sizeof(MaterialBlockEntry) == 32, "MaterialBlockEntry must match the std140 layout of material_texture.");
+
+		//Textures still uploading are drawn as the manager's placeholder of
+		//the same type; null only for types with no placeholder.
+		static const Texture* ReadyOrPlaceholder(const Texture& t)
+		{
+			if (t.IsReady()) return &t;
+			return GetPlaceholderTexture(GetTextureManager(), t.GetType()).get();
+		}
+
 		void Material::Bind() const
 		{
-			if (program != nullptr)
+			if (program == nullptr)
+			{
+				return;
+			}
+
+			program->Bind();
+			if (program->UsesMaterialBlock() && BindlessTexturesSupported())
+			{
+				BindTextureBlock();
+			}
+			else
+			{
+				BindTextureUnits();
+			}
+		}
+		void Material::BindSlotToUnit(const SlotBinding& t) const
+		{
+			auto unit = GLuint(TextureSlotToGL(t.slot));
+			auto shown = t.texture == nullptr ? nullptr : ReadyOrPlaceholder(*t.texture);
+			if (shown != nullptr)
+			{
+				shown->BindToUnit(unit);
+			}
+			else
+			{
+				UnbindTextureUnit(unit);
+			}
+			if (t.sampler != nullptr)
+			{
+				t.sampler->BindToUnit(unit);
+			}
+			else
+			{
+				UnbindSamplerUnit(unit);
+			}
+
+			//Shared programs hold the last material's values, so these
+			//are set every time.
+			if (t.regionLocation != -1)
+			{
+				glUniform4f(t.regionLocation, t.region.u, t.region.v, t.region.width, t.region.height);
+			}
+			if (t.layerLocation != -1)
+			{
+				glUniform1f(t.layerLocation, GLfloat(t.region.layer));
+			}
+		}
+		void Material::BindTextureUnits() const
+		{
+			//Rebuilt programs keep their object but not their handle.
+			if (resolvedProgram != program->GetHandle())
+			{
+				ResolveTextureUniforms();
+			}
+
+			for (const auto& t : textures)
+			{
+				BindSlotToUnit(t);
+			}
+		}
+		void Material::BindTextureBlock() const
+		{
+			//Rebuilt every bind, as handles change when a texture's storage
+			//is replaced under the memory budget.
+			std::array<MaterialBlockEntry, MaterialBlockSlotCount> block{};
+			for (const auto& t : textures)
+			{
+				auto index = std::size_t(t.slot);
+				//Slots past the block are read through sampler uniforms.
+				if (index >= block.size())
+				{
+					if (resolvedProgram != program->GetHandle())
+					{
+						ResolveTextureUniforms();
+					}
+					BindSlotToUnit(t);
+					continue;
+				}
+
+				auto& entry = block[index];
+				auto shown = t.texture == nullptr ? nullptr : ReadyOrPlaceholder(*t.texture);
+				if (shown != nullptr)
+				{
+					entry.handle = shown->GetBindlessHandle(t.sampler.get());
+				}
+				entry.layer = GLfloat(t.region.layer);
+				entry.region[0] = t.region.u;
+				entry.region[1] = t.region.v;
+				entry.region[2] = t.region.width;
+				entry.region[3] = t.region.height;
+			}
+
+			if (textureBlock.GetHandle() == MeshDataBuffer::invalidHandle)
+			{
+				textureBlock = MeshDataBuffer(BufferType::uniform, sizeof(block), block.data(),
+					GL_UNSIGNED_INT, 2, BufferUsage::dynamic_draw);
+				uploadedBlock = block;
+			}
+			else if (std::memcmp(block.data(), uploadedBlock.data(), sizeof(block)) != 0)
 			{
-				program->Bind();
+				textureBlock.Bind();
+				textureBlock.UpdateData(0, sizeof(block), block.data());
+				uploadedBlock = block;
 			}
+			textureBlock.BindBase(GLuint(ReservedBlock::Material));
 		}
 		const ShadingProgram * Material::GetProgram() const noexcept
 		{
 			return program.get();
 		}
+		void Material::SetTexture(TextureSlot slot, const LocalSharedPtr<Texture>& texture, const TextureRegion& region,
+			const LocalSharedPtr<Sampler>& sampler)
+		{
+			auto found = std::lower_bound(textures.begin(), textures.end(), slot,
+				[](const SlotBinding& b, TextureSlot s) { return b.slot < s; });
+			if (found == textures.end() || found->slot != slot)
+			{
+				found = textures.insert(found, SlotBinding{ slot, nullptr, nullptr, {} });
+			}
+			found->texture = texture;
+			found->sampler = sampler;
+			found->region = region;
+			resolvedProgram = ShadingProgram::invalidHandle;
+		}
+		void Material::ClearTexture(TextureSlot slot)
+		{
+			auto found = std::find_if(textures.begin(), textures.end(),
+				[slot](const SlotBinding& b) { return b.slot == slot; });
+			if (found != textures.end())
+			{
+				//The unit is left as it is; the next material to use it rebinds.
+				textures.erase(found);
+			}
+		}
+		const Texture* Material::GetTexture(TextureSlot slot) const noexcept
+		{
+			for (const auto& t : textures)
+			{
+				if (t.slot == slot) return t.texture.get();
+			}
+			return nullptr;
+		}
 		void Material::SetUniform(const UniformInformation& u, GLint i)
 		{
 			SetUniform(u, &i, 1);
@@ -460,11 +631,58 @@ namespace GlProj
 		}
 		GLint TextureSlotToGL(TextureSlot s)
 		{
-			return static_cast<GLint>(s);
+			return static_cast<GLint>(s) + 1;
+		}
+		std::string TextureSlotName(TextureSlot s)
+		{
+			switch (s)
+			{
+			case TextureSlot::Diffuse1:
+				return "diffuse0_map";
+			case TextureSlot::Diffuse2:
+				return "diffuse1_map";
+			case TextureSlot::Normal:
+				return "normal0_map";
+			case TextureSlot::Specular:
+				return "specular0_map";
+			case TextureSlot::Emissive:
+				return "emissive_map";
+			case TextureSlot::Gloss:
+				return "gloss_map";
+			case TextureSlot::Displacement:
+				return "displacement_map";
+			case TextureSlot::Opacity:
+				return "opacity_map";
+			default:
+				return "user" + std::to_string(static_cast<GLint>(s) - static_cast<GLint>(TextureSlot::User)) + "_map";
+			}
+		}
+
+		//Orders by what binding a material changes, so that materials sharing
+		//a program and textures sort next to one another.
+		static auto BindingKey(const LocalSharedPtr<ShadingProgram>& p) noexcept
+		{
+			return p == nullptr ? GLuint(0) : p->GetHandle() + 1;
+		}
+		template<typename T>
+		static GLuint HandleOf(const LocalSharedPtr<T>& p) noexcept
+		{
+			return p == nullptr ? GLuint(0) : p->GetHandle();
 		}
+
 		bool operator==(const Material& x, const Material& y) noexcept
 		{
-			return x.program == y.program;
+			if (x.program != y.program || x.textures.size() != y.textures.size()) return false;
+			for (std::size_t i = 0; i < x.textures.size(); ++i)
+			{
+				const auto& a = x.textures[i];
+				const auto& b = y.textures[i];
+				if (a.slot != b.slot || a.texture != b.texture || a.sampler != b.sampler || a.region != b.region)
+				{
+					return false;
+				}
+			}
+			return true;
 		}
 		bool operator!=(const Material& x, const Material& y) noexcept
 		{
@@ -472,10 +690,16 @@ namespace GlProj
 		}
 		bool operator<(const Material& x, const Material& y) noexcept
 		{
-			if (x == y) return false;
-			if (x.program == nullptr) return true;
-			if (y.program == nullptr) return false;
-			return x.program->GetHandle() < y.program->GetHandle();
+			if (x.program != y.program)
+			{
+				return BindingKey(x.program) < BindingKey(y.program);
+			}
+			return std::lexicographical_compare(x.textures.begin(), x.textures.end(), y.textures.begin(), y.textures.end(),
+				[](const Material::SlotBinding& a, const Material::SlotBinding& b)
+			{
+				return std::make_tuple(a.slot, HandleOf(a.texture), HandleOf(a.sampler), a.region)
+					< std::make_tuple(b.slot, HandleOf(b.texture), HandleOf(b.sampler), b.region);
+			});
 		}
 		bool operator<=(const Material& x, const Material& y) noexcept
 		{
@@ -1,8 +1,11 @@
 #include "Mesh.hpp"
+#include "GpuUploader.hpp"
+#include "MeshArena.hpp"
 #include "assimp/scene.h"
 #include "assimp/anim.h"
 #include <algorithm>
 #include <stdexcept>
+#include <utility>
 
 namespace GlProj
 {
@@ -34,6 +37,7 @@ namespace GlProj
 
 			Bind();
 			indices = MeshIndexBuffer(faceCount, mesh->mFaces);
+			indexType = indices.GetIndexType();
 
 			vertexData.resize(ReservedVertexSlots);
 
@@ -112,14 +116,128 @@ namespace GlProj
 
 			MeshArrayBuffer::UnBind();
 		}
+		Mesh::Mesh(MeshArena& a, const PackedMeshView& mesh)
+			: arrayBuffer(nullptr)
+			, primitiveCount(mesh.indexCount)
+			, vertsPerPrimitive(mesh.vertsPerPrimitive)
+			, indexType(mesh.indexType)
+		{
+			//Vertex data is owned by the arena; keep the slots so lookups stay valid.
+			vertexData.resize(ReservedVertexSlots);
+
+			auto range = a.Allocate(mesh);
+			arena = &a;
+			baseVertex = range.baseVertex;
+			firstIndex = range.firstIndex;
+			vertexCount = range.vertexCount;
+		}
+		Mesh::Mesh(MeshArena& a, const PackedMeshView& mesh, std::shared_ptr<const void> owner, GpuUploader& uploader)
+			: arrayBuffer(nullptr)
+			, primitiveCount(mesh.indexCount)
+			, vertsPerPrimitive(mesh.vertsPerPrimitive)
+			, indexType(mesh.indexType)
+		{
+			vertexData.resize(ReservedVertexSlots);
+
+			auto range = a.Reserve(mesh);
+			arena = &a;
+			baseVertex = range.baseVertex;
+			firstIndex = range.firstIndex;
+			vertexCount = range.vertexCount;
+
+			upload = uploader.Submit([&a, range, mesh, owner]()
+			{
+				a.Upload(range, mesh);
+			});
+		}
+		Mesh::Mesh(Mesh&& x) noexcept
+			: vertexData(std::move(x.vertexData))
+			, indices(std::move(x.indices))
+			, arrayBuffer(std::move(x.arrayBuffer))
+			, primitiveCount(x.primitiveCount)
+			, vertsPerPrimitive(x.vertsPerPrimitive)
+			, indexType(x.indexType)
+			, arena(x.arena)
+			, baseVertex(x.baseVertex)
+			, firstIndex(x.firstIndex)
+			, vertexCount(x.vertexCount)
+			, upload(std::move(x.upload))
+		{
+			x.arena = nullptr;
+		}
+		Mesh& Mesh::operator=(Mesh&& x) noexcept
+		{
+			if (this != &x)
+			{
+				ReleaseArenaRange();
+				vertexData = std::move(x.vertexData);
+				indices = std::move(x.indices);
+				arrayBuffer = std::move(x.arrayBuffer);
+				primitiveCount = x.primitiveCount;
+				vertsPerPrimitive = x.vertsPerPrimitive;
+				indexType = x.indexType;
+				arena = x.arena;
+				baseVertex = x.baseVertex;
+				firstIndex = x.firstIndex;
+				vertexCount = x.vertexCount;
+				upload = std::move(x.upload);
+
+				x.arena = nullptr;
+			}
+
+			return *this;
+		}
+		Mesh::~Mesh()
+		{
+			ReleaseArenaRange();
+		}
+		void Mesh::ReleaseArenaRange() noexcept
+		{
+			if (arena == nullptr) return;
+
+			//The range cannot be handed to another mesh mid-write.
+			if (upload != nullptr)
+			{
+				upload->Wait();
+				upload = nullptr;
+			}
 
+			MeshArenaRange range;
+			range.baseVertex = baseVertex;
+			range.firstIndex = firstIndex;
+			range.vertexCount = vertexCount;
+			range.indexCount = primitiveCount;
+			arena->Free(range);
+			arena = nullptr;
+		}
+
+		bool Mesh::IsReady() const
+		{
+			return GetUploadState() == UploadState::Complete;
+		}
+		UploadState Mesh::GetUploadState() const
+		{
+			return upload == nullptr ? UploadState::Complete : upload->GetState();
+		}
+		std::string Mesh::GetUploadError() const
+		{
+			return GetUploadState() == UploadState::Failed ? upload->GetError() : std::string();
+		}
 		const MeshDataBuffer& Mesh::GetMeshData(MeshSlots s) const
 		{
 			return vertexData[MeshSlotToGL(s)];
 		}
+		const MeshArrayBuffer& Mesh::GetArrayBuffer() const noexcept
+		{
+			if (arena != nullptr)
+			{
+				return arena->GetArrayBuffer();
+			}
+			return arrayBuffer;
+		}
 		void Mesh::Bind() const noexcept
 		{
-			arrayBuffer.Bind();
+			GetArrayBuffer().Bind();
 		}
 
 		void Mesh::SetAttributePointer(MeshSlots slot)
@@ -142,8 +260,11 @@ namespace GlProj
 
 		void Mesh::SetAttributePointer(MeshSlots s, const MeshDataBuffer& b, GLsizei stride, const void* offset)
 		{
-			glVertexAttribPointer(MeshSlotToGL(s), b.GetElementsPerVertex(),
-				b.GetDataType(), GL_FALSE, stride, offset);
+			SetAttributePointer(s, b.GetElementsPerVertex(), b.GetDataType(), stride, offset);
+		}
+		void Mesh::SetAttributePointer(MeshSlots s, GLint elements, GLenum type, GLsizei stride, const void* offset)
+		{
+			glVertexAttribPointer(MeshSlotToGL(s), elements, type, GL_FALSE, stride, offset);
 		}
 
 		void Mesh::SetAttributeDivisor(MeshSlots s, GLuint u)
@@ -170,7 +291,8 @@ namespace GlProj
 
 		bool operator==(const Mesh& x, const Mesh& y) noexcept
 		{
-			return x.vertexData == y.vertexData && x.indices == y.indices && x.arrayBuffer == y.arrayBuffer;
+			return x.vertexData == y.vertexData && x.indices == y.indices && x.arrayBuffer == y.arrayBuffer
+				&& x.arena == y.arena && x.baseVertex == y.baseVertex && x.firstIndex == y.firstIndex;
 		}
 		bool operator!=(const Mesh& x, const Mesh& y) noexcept
 		{
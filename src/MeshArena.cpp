@@ -0,0 +1,184 @@
+#include "MeshArena.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		RangeAllocator::RangeAllocator(GLsizeiptr count)
+			: freeRanges{ { 0, count } }
+			, capacity(count)
+		{
+		}
+		GLsizeiptr RangeAllocator::Capacity() const noexcept
+		{
+			return capacity;
+		}
+		bool RangeAllocator::CanAllocate(GLsizeiptr count) const noexcept
+		{
+			return std::any_of(freeRanges.begin(), freeRanges.end(), [count](const auto& x)
+			{
+				return x.second >= count;
+			});
+		}
+		GLsizeiptr RangeAllocator::Allocate(GLsizeiptr count)
+		{
+			auto found = std::find_if(freeRanges.begin(), freeRanges.end(), [count](const auto& x)
+			{
+				return x.second >= count;
+			});
+			if (found == freeRanges.end())
+			{
+				return invalidOffset;
+			}
+
+			auto offset = found->first;
+			found->first += count;
+			found->second -= count;
+			if (found->second == 0)
+			{
+				freeRanges.erase(found);
+			}
+			return offset;
+		}
+		void RangeAllocator::Free(GLsizeiptr offset, GLsizeiptr count)
+		{
+			if (count == 0) return;
+
+			auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), std::make_pair(offset, GLsizeiptr(0)));
+			auto pos = freeRanges.insert(next, { offset, count });
+
+			auto following = pos + 1;
+			if (following != freeRanges.end() && pos->first + pos->second == following->first)
+			{
+				pos->second += following->second;
+				freeRanges.erase(following);
+			}
+			if (pos != freeRanges.begin())
+			{
+				auto preceding = pos - 1;
+				if (preceding->first + preceding->second == pos->first)
+				{
+					preceding->second += pos->second;
+					freeRanges.erase(pos);
+				}
+			}
+		}
+
+		MeshArena::MeshArena(const VertexLayout& l, IndexType t, GLsizeiptr vertexCapacity, GLsizeiptr indexCapacity)
+			: layout(l)
+			, indexType(t)
+			, vertexRanges(vertexCapacity)
+			, indexRanges(indexCapacity)
+		{
+			arrayBuffer.Bind();
+
+			streams.reserve(layout.streamStrides.size());
+			for (auto stride : layout.streamStrides)
+			{
+				streams.emplace_back(BufferType::array, vertexCapacity * stride, nullptr, GL_UNSIGNED_BYTE, stride);
+			}
+			indices = MeshIndexBuffer(indexCapacity * SizeOfIndex(indexType), nullptr, indexType);
+
+			BindVertexLayout(layout, streams);
+
+			MeshArrayBuffer::UnBind();
+		}
+		const VertexLayout& MeshArena::GetLayout() const noexcept
+		{
+			return layout;
+		}
+		IndexType MeshArena::GetIndexType() const noexcept
+		{
+			return indexType;
+		}
+		const MeshArrayBuffer& MeshArena::GetArrayBuffer() const noexcept
+		{
+			return arrayBuffer;
+		}
+		bool MeshArena::CanFit(const PackedMeshView& mesh) const noexcept
+		{
+			return mesh.layout == layout
+				&& mesh.indexType == indexType
+				&& vertexRanges.CanAllocate(mesh.vertexCount)
+				&& indexRanges.CanAllocate(GLsizeiptr(mesh.indexCount));
+		}
+		MeshArenaRange MeshArena::Allocate(const PackedMeshView& mesh)
+		{
+			auto range = Reserve(mesh);
+			Upload(range, mesh);
+			return range;
+		}
+		MeshArenaRange MeshArena::Reserve(const PackedMeshView& mesh)
+		{
+			if (mesh.layout != layout)
+			{
+				throw std::logic_error("Mesh vertex layout does not match that of the arena.");
+			}
+			if (mesh.indexType != indexType)
+			{
+				throw std::logic_error("Mesh index type does not match that of the arena.");
+			}
+			if (mesh.indexDataType != indexType && mesh.indexDataType != IndexType::unsigned_int)
+			{
+				throw std::logic_error("Mesh indices cannot be converted to the index type of the arena.");
+			}
+
+			auto indexCount = GLsizeiptr(mesh.indexCount);
+			auto vertexOffset = vertexRanges.Allocate(mesh.vertexCount);
+			if (vertexOffset == RangeAllocator::invalidOffset)
+			{
+				throw std::runtime_error("Mesh arena has no room for the vertices of the mesh.");
+			}
+			auto indexOffset = indexRanges.Allocate(indexCount);
+			if (indexOffset == RangeAllocator::invalidOffset)
+			{
+				vertexRanges.Free(vertexOffset, mesh.vertexCount);
+				throw std::runtime_error("Mesh arena has no room for the indices of the mesh.");
+			}
+
+			MeshArenaRange range;
+			range.baseVertex = GLint(vertexOffset);
+			range.firstIndex = GLuint(indexOffset);
+			range.vertexCount = mesh.vertexCount;
+			range.indexCount = GLuint(indexCount);
+			return range;
+		}
+		void MeshArena::Upload(const MeshArenaRange& range, const PackedMeshView& mesh) const
+		{
+			//Vertex arrays are not shared between contexts, so the element
+			//buffer is written directly rather than through arrayBuffer.
+			for (std::size_t i = 0; i < streams.size(); ++i)
+			{
+				auto stride = layout.streamStrides[i];
+				glNamedBufferSubData(streams[i].GetHandle(), GLintptr(range.baseVertex) * stride,
+					GLsizeiptr(range.vertexCount) * stride, mesh.streams[i]);
+			}
+
+			auto indexSize = SizeOfIndex(indexType);
+			auto offset = GLintptr(range.firstIndex) * indexSize;
+			auto size = GLsizeiptr(range.indexCount) * indexSize;
+			if (mesh.indexDataType != indexType)
+			{
+				auto wide = static_cast<const unsigned int*>(mesh.indices);
+				std::vector<std::uint16_t> narrowIndices(wide, wide + range.indexCount);
+				glNamedBufferSubData(indices.GetHandle(), offset, size, narrowIndices.data());
+			}
+			else
+			{
+				glNamedBufferSubData(indices.GetHandle(), offset, size, mesh.indices);
+			}
+		}
+		void MeshArena::Free(const MeshArenaRange& range)
+		{
+			vertexRanges.Free(range.baseVertex, range.vertexCount);
+			indexRanges.Free(range.firstIndex, range.indexCount);
+		}
+		void MeshArena::Bind() const noexcept
+		{
+			arrayBuffer.Bind();
+		}
+	}
+}
@@ -9,6 +9,9 @@ namespace GlProj
 		{
 			glGenVertexArrays(1, &arrayBufferHandle);
 		}
+		MeshArrayBuffer::MeshArrayBuffer(std::nullptr_t) noexcept
+		{
+		}
 		MeshArrayBuffer::MeshArrayBuffer(MeshArrayBuffer&& x) noexcept
 			:arrayBufferHandle(x.arrayBufferHandle)
 		{
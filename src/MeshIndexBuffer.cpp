@@ -1,13 +1,29 @@
 #include "MeshIndexBuffer.hpp"
 #include "assimp/mesh.h"
 #include "assimp/scene.h"
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 
 namespace GlProj
 {
 	namespace Graphics
 	{
+		IndexType SmallestIndexType(GLsizeiptr vertexCount) noexcept
+		{
+			return vertexCount <= 0x10000 ? IndexType::unsigned_short : IndexType::unsigned_int;
+		}
+		GLsizeiptr SizeOfIndex(IndexType t) noexcept
+		{
+			return t == IndexType::unsigned_short ? sizeof(GLushort) : sizeof(GLuint);
+		}
+
 		MeshIndexBuffer::MeshIndexBuffer(GLsizeiptr dataSize, const GLvoid* data, GLenum usage)
+			: MeshIndexBuffer(dataSize, data, IndexType::unsigned_int, usage)
+		{
+		}
+		MeshIndexBuffer::MeshIndexBuffer(GLsizeiptr dataSize, const GLvoid* data, IndexType type, GLenum usage)
+			: indexType(type)
 		{
 			glGenBuffers(1, &indexDataHandle);
 			glBindBuffer(GetType(), GetHandle());
@@ -27,10 +43,20 @@ namespace GlProj
 				meshIndices.insert(meshIndices.cend(), faces[i].mIndices, faces[i].mIndices + faces[i].mNumIndices);
 			}
 
+			auto maxIndex = meshIndices.empty() ? 0u : *std::max_element(meshIndices.begin(), meshIndices.end());
+			indexType = SmallestIndexType(GLsizeiptr(maxIndex) + 1);
+			if (indexType == IndexType::unsigned_short)
+			{
+				std::vector<std::uint16_t> narrowIndices(meshIndices.begin(), meshIndices.end());
+				glBufferData(GetType(), narrowIndices.size() * sizeof(std::uint16_t), narrowIndices.data(), usage);
+				return;
+			}
+
 			glBufferData(GetType(), meshIndices.size() * sizeof(unsigned int), meshIndices.data(), usage);
 		}
 		MeshIndexBuffer::MeshIndexBuffer(MeshIndexBuffer&& x) noexcept
 			: indexDataHandle(x.indexDataHandle)
+			, indexType(x.indexType)
 		{
 			x.indexDataHandle = invalidHandle;
 		}
@@ -43,6 +69,7 @@ namespace GlProj
 					glDeleteBuffers(1, &indexDataHandle);
 				}
 				indexDataHandle = x.indexDataHandle;
+				indexType = x.indexType;
 
 				x.indexDataHandle = invalidHandle;
 			}
@@ -64,6 +91,10 @@ namespace GlProj
 		{
 			return GL_ELEMENT_ARRAY_BUFFER;
 		}
+		IndexType MeshIndexBuffer::GetIndexType() const noexcept
+		{
+			return indexType;
+		}
 		void MeshIndexBuffer::UpdateData(GLintptr offset, GLsizeiptr dataSize, const GLvoid* data) const noexcept
 		{
 			glBufferSubData(GetType(), offset, dataSize, data);
@@ -2,9 +2,14 @@
 #include "gl_core_4_5.h"
 #include "GLFW/glfw3.h"
 #include "Mesh.hpp"
+#include "MeshArena.hpp"
+#include "VertexLayout.hpp"
+#include <algorithm>
+#include <memory>
 #include <stdexcept>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 namespace GlProj
 {
@@ -16,11 +21,45 @@ namespace GlProj
 		class MeshManager
 		{
 			std::unordered_map<std::string, LocalWeakPtr<Mesh>> registeredMeshes;
+			//Arenas are never moved once created, as meshes point into them.
+			std::vector<std::unique_ptr<MeshArena>> arenas;
+			MeshOptimisationReport optimisationTotals;
+
+			MeshArena& FindArena(const PackedMeshView& mesh)
+			{
+				auto found = std::find_if(arenas.begin(), arenas.end(), [&mesh](const auto& a)
+				{
+					return a->CanFit(mesh);
+				});
+				if (found != arenas.end())
+				{
+					return **found;
+				}
+
+				auto vertexCapacity = std::max(MeshArena::DefaultVertexCapacity, GLsizeiptr(mesh.vertexCount));
+				auto indexCapacity = std::max(MeshArena::DefaultIndexCapacity, GLsizeiptr(mesh.indexCount));
+				arenas.push_back(std::make_unique<MeshArena>(mesh.layout, mesh.indexType, vertexCapacity, indexCapacity));
+				return *arenas.back();
+			}
+			void AccumulateReport(const MeshOptimisationReport& report)
+			{
+				auto total = optimisationTotals.triangleCount + report.triangleCount;
+				if (total == 0) return;
+
+				auto weight = float(report.triangleCount) / float(total);
+				optimisationTotals.acmrBefore += (report.acmrBefore - optimisationTotals.acmrBefore) * weight;
+				optimisationTotals.acmrAfter += (report.acmrAfter - optimisationTotals.acmrAfter) * weight;
+				optimisationTotals.triangleCount = total;
+			}
 		public:
-			LocalSharedPtr<Mesh> RegisterMesh(aiMesh* mesh, const std::string& name)
+			LocalSharedPtr<Mesh> RegisterMesh(StagedMesh&& mesh, GpuUploader* uploader)
 			{
-				auto newPtr = make_localshared<Mesh>(mesh);
-				auto inserted = registeredMeshes.insert({ name, newPtr });
+				AccumulateReport(mesh.report);
+				auto& arena = FindArena(mesh.view);
+				auto newPtr = uploader == nullptr
+					? make_localshared<Mesh>(arena, mesh.view)
+					: make_localshared<Mesh>(arena, mesh.view, std::move(mesh.owner), *uploader);
+				auto inserted = registeredMeshes.insert({ std::move(mesh.name), newPtr });
 				if (!inserted.second)
 				{
 					inserted.first->second = newPtr;
@@ -38,6 +77,11 @@ namespace GlProj
 				return found->second.lock();
 			}
 
+			const MeshOptimisationReport& GetOptimisationReport() const noexcept
+			{
+				return optimisationTotals;
+			}
+
 			void CleanUpDangling()
 			{
 				auto begin = registeredMeshes.begin();
@@ -59,6 +103,16 @@ namespace GlProj
 			static MeshManager instance;
 			return &instance;
 		}
+		StagedMesh StageMesh(const aiMesh* mesh, const std::string& name)
+		{
+			auto packed = std::make_shared<PackedMesh>(PackMesh(mesh, InterleavedLayout(mesh)));
+			StagedMesh staged;
+			staged.name = name;
+			staged.report = OptimiseMesh(*packed);
+			staged.view = ViewOf(*packed);
+			staged.owner = std::move(packed);
+			return staged;
+		}
 		LocalSharedPtr<Mesh> RegisterMesh(MeshManager* manager, aiMesh* mesh, const std::string& name, bool replace)
 		{
 			if(!replace)
@@ -70,7 +124,33 @@ namespace GlProj
 				}
 			}
 
-			return manager->RegisterMesh(mesh, name);
+			return manager->RegisterMesh(StageMesh(mesh, name), nullptr);
+		}
+		LocalSharedPtr<Mesh> RegisterMesh(MeshManager* manager, StagedMesh&& mesh, bool replace)
+		{
+			if(!replace)
+			{
+				auto ptr = FindCachedMeshByName(manager, mesh.name);
+				if(ptr != nullptr)
+				{
+					return std::move(ptr);
+				}
+			}
+
+			return manager->RegisterMesh(std::move(mesh), nullptr);
+		}
+		LocalSharedPtr<Mesh> RegisterMesh(MeshManager* manager, GpuUploader& uploader, StagedMesh&& mesh, bool replace)
+		{
+			if(!replace)
+			{
+				auto ptr = FindCachedMeshByName(manager, mesh.name);
+				if(ptr != nullptr)
+				{
+					return std::move(ptr);
+				}
+			}
+
+			return manager->RegisterMesh(std::move(mesh), &uploader);
 		}
 		LocalSharedPtr<Mesh> FindCachedMeshByName(const MeshManager* manager, const std::string& name)
 		{
@@ -80,5 +160,9 @@ namespace GlProj
 		{
 			manager->CleanUpDangling();
 		}
+		MeshOptimisationReport GetOptimisationReport(const MeshManager* manager)
+		{
+			return manager->GetOptimisationReport();
+		}
 	}
 }
\ No newline at end of file
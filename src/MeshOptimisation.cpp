@@ -0,0 +1,283 @@
+#include "MeshOptimisation.hpp"
+#include "VertexLayout.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <utility>
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		//Tuning values from Forsyth's "Linear-Speed Vertex Cache Optimisation".
+		static const constexpr int ForsythCacheSize = 32;
+		static const constexpr float CacheDecayPower = 1.5f;
+		static const constexpr float LastTriangleScore = 0.75f;
+		static const constexpr float ValenceBoostScale = 2.0f;
+		static const constexpr float ValenceBoostPower = 0.5f;
+
+		static const constexpr unsigned int noTriangle = static_cast<unsigned int>(-1);
+
+		static float VertexScore(int cachePosition, unsigned int remainingTriangles)
+		{
+			if (remainingTriangles == 0)
+			{
+				return -1.0f;
+			}
+
+			float score = 0.0f;
+			if (cachePosition >= 0)
+			{
+				if (cachePosition < 3)
+				{
+					//The vertices of the last triangle are scored flat, so the
+					//next triangle does not simply follow the previous one.
+					score = LastTriangleScore;
+				}
+				else
+				{
+					const float scaler = 1.0f / (ForsythCacheSize - 3);
+					score = std::pow(1.0f - (cachePosition - 3) * scaler, CacheDecayPower);
+				}
+			}
+
+			//Favour vertices with few triangles left, to finish them off.
+			score += ValenceBoostScale * std::pow(float(remainingTriangles), -ValenceBoostPower);
+			return score;
+		}
+
+		float AverageCacheMissRatio(const std::vector<unsigned int>& indices, unsigned int vertexCount,
+			unsigned int cacheSize)
+		{
+			auto triangleCount = indices.size() / 3;
+			if (triangleCount == 0)
+			{
+				return 0.0f;
+			}
+
+			//A vertex is cached while fewer than 'cacheSize' others have been
+			//inserted since it was.
+			std::vector<unsigned int> insertedAt(vertexCount, 0);
+			unsigned int clock = cacheSize + 1;
+			std::size_t misses = 0;
+			for (auto i : indices)
+			{
+				if (clock - insertedAt[i] > cacheSize)
+				{
+					insertedAt[i] = clock++;
+					++misses;
+				}
+			}
+
+			return float(misses) / float(triangleCount);
+		}
+
+		void OptimiseVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount)
+		{
+			//Degenerate triangles draw nothing, and a repeated vertex would
+			//list the same triangle twice in that vertex's adjacency.
+			std::size_t kept = 0;
+			for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				auto a = indices[i];
+				auto b = indices[i + 1];
+				auto c = indices[i + 2];
+				if (a == b || b == c || a == c)
+				{
+					continue;
+				}
+				indices[kept++] = a;
+				indices[kept++] = b;
+				indices[kept++] = c;
+			}
+			indices.resize(kept);
+
+			auto triangleCount = static_cast<unsigned int>(indices.size() / 3);
+			if (triangleCount == 0)
+			{
+				return;
+			}
+
+			//Triangles using each vertex, packed into one array.
+			std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+			for (auto i : indices)
+			{
+				++adjacencyOffsets[i + 1];
+			}
+			std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+
+			std::vector<unsigned int> adjacency(indices.size());
+			std::vector<unsigned int> remaining(vertexCount, 0);
+			for (unsigned int t = 0; t < triangleCount; ++t)
+			{
+				for (int k = 0; k < 3; ++k)
+				{
+					auto v = indices[t * 3 + k];
+					adjacency[adjacencyOffsets[v] + remaining[v]++] = t;
+				}
+			}
+
+			std::vector<int> cachePosition(vertexCount, -1);
+			std::vector<float> vertexScores(vertexCount);
+			for (unsigned int v = 0; v < vertexCount; ++v)
+			{
+				vertexScores[v] = VertexScore(-1, remaining[v]);
+			}
+
+			std::vector<float> triangleScores(triangleCount);
+			std::vector<bool> emitted(triangleCount, false);
+			unsigned int bestTriangle = 0;
+			for (unsigned int t = 0; t < triangleCount; ++t)
+			{
+				triangleScores[t] = vertexScores[indices[t * 3]]
+					+ vertexScores[indices[t * 3 + 1]]
+					+ vertexScores[indices[t * 3 + 2]];
+				if (triangleScores[t] > triangleScores[bestTriangle])
+				{
+					bestTriangle = t;
+				}
+			}
+
+			std::vector<unsigned int> result;
+			result.reserve(indices.size());
+			std::vector<unsigned int> cache;
+			std::vector<unsigned int> nextCache;
+			cache.reserve(ForsythCacheSize + 3);
+			nextCache.reserve(ForsythCacheSize + 3);
+			unsigned int scanCursor = 0;
+
+			while (result.size() < indices.size())
+			{
+				if (bestTriangle == noTriangle)
+				{
+					//Nothing in the cache has triangles left; resume from the
+					//first triangle not yet emitted.
+					while (emitted[scanCursor])
+					{
+						++scanCursor;
+					}
+					bestTriangle = scanCursor;
+				}
+
+				emitted[bestTriangle] = true;
+				nextCache.clear();
+				for (int k = 0; k < 3; ++k)
+				{
+					auto v = indices[bestTriangle * 3 + k];
+					result.push_back(v);
+
+					auto first = adjacency.begin() + adjacencyOffsets[v];
+					auto last = first + remaining[v];
+					auto found = std::find(first, last, bestTriangle);
+					assert(found != last);
+					std::iter_swap(found, last - 1);
+					--remaining[v];
+
+					if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+					{
+						nextCache.push_back(v);
+					}
+				}
+				auto triangleVertices = nextCache.size();
+				for (auto v : cache)
+				{
+					auto triangleEnd = nextCache.begin() + triangleVertices;
+					if (std::find(nextCache.begin(), triangleEnd, v) == triangleEnd)
+					{
+						nextCache.push_back(v);
+					}
+				}
+
+				for (std::size_t i = 0; i < nextCache.size(); ++i)
+				{
+					auto v = nextCache[i];
+					cachePosition[v] = i < ForsythCacheSize ? int(i) : -1;
+					vertexScores[v] = VertexScore(cachePosition[v], remaining[v]);
+				}
+
+				//Only triangles touching the updated vertices change score,
+				//and only those touching the cache are worth considering.
+				bestTriangle = noTriangle;
+				float bestScore = -1.0f;
+				for (auto v : nextCache)
+				{
+					auto first = adjacency.begin() + adjacencyOffsets[v];
+					auto last = first + remaining[v];
+					for (; first != last; ++first)
+					{
+						auto t = *first;
+						auto score = vertexScores[indices[t * 3]]
+							+ vertexScores[indices[t * 3 + 1]]
+							+ vertexScores[indices[t * 3 + 2]];
+						triangleScores[t] = score;
+						if (cachePosition[v] >= 0 && score > bestScore)
+						{
+							bestScore = score;
+							bestTriangle = t;
+						}
+					}
+				}
+
+				if (nextCache.size() > ForsythCacheSize)
+				{
+					nextCache.resize(ForsythCacheSize);
+				}
+				std::swap(cache, nextCache);
+			}
+
+			indices = std::move(result);
+		}
+
+		void OptimiseVertexFetch(PackedMesh& mesh)
+		{
+			const unsigned int unused = static_cast<unsigned int>(-1);
+			std::vector<unsigned int> remap(mesh.vertexCount, unused);
+			unsigned int nextVertex = 0;
+			for (auto& i : mesh.indices)
+			{
+				if (remap[i] == unused)
+				{
+					remap[i] = nextVertex++;
+				}
+				i = remap[i];
+			}
+
+			for (std::size_t s = 0; s < mesh.streams.size(); ++s)
+			{
+				auto stride = std::size_t(mesh.layout.streamStrides[s]);
+				const auto& source = mesh.streams[s];
+				std::vector<unsigned char> reordered(stride * nextVertex);
+				for (unsigned int v = 0; v < mesh.vertexCount; ++v)
+				{
+					if (remap[v] != unused)
+					{
+						std::memcpy(reordered.data() + remap[v] * stride, source.data() + v * stride, stride);
+					}
+				}
+				mesh.streams[s] = std::move(reordered);
+			}
+
+			mesh.vertexCount = nextVertex;
+			mesh.indexType = SmallestIndexType(nextVertex);
+		}
+
+		MeshOptimisationReport OptimiseMesh(PackedMesh& mesh)
+		{
+			MeshOptimisationReport report;
+			if (mesh.vertsPerPrimitive != 3)
+			{
+				return report;
+			}
+
+			report.triangleCount = static_cast<unsigned int>(mesh.indices.size() / 3);
+			report.acmrBefore = AverageCacheMissRatio(mesh.indices, mesh.vertexCount);
+			OptimiseVertexCache(mesh.indices, mesh.vertexCount);
+			OptimiseVertexFetch(mesh);
+			report.acmrAfter = AverageCacheMissRatio(mesh.indices, mesh.vertexCount);
+
+			return report;
+		}
+	}
+}
@@ -1,20 +1,224 @@
 #include "gl_core_4_5.h"
 #include "GLFW/glfw3.h"
 #include "Model.hpp"
+#include "GpuUploader.hpp"
 #include "Material.hpp"
 #include "Mesh.hpp"
+#include "TransformKernels.hpp"
+#include "JobSystem.hpp"
+#include <algorithm>
 #include <utility>
 
 namespace GlProj
 {
 	namespace Graphics
 	{
+		//Smaller levels cost more to gather into SoA form than they save.
+		static const constexpr std::size_t MinimumBatchedTransforms = 8;
+
+		Model::Model(const std::vector<Renderable>& renderables,
+						const SceneGraph<ModelData>& hierarchy)
+			:submeshes(renderables)
+			,hierarchy(hierarchy)
+			,worldTransforms(this->hierarchy.size(), glm::mat4(1))
+			,dirtyNodes(this->hierarchy.size(), true)
+			,anyDirty(!this->hierarchy.empty())
+		{
+			ComputeDepths();
+		}
 		Model::Model(const std::vector<Renderable>& renderables,
-						SceneGraph<ModelData>&& hierarchy)
+						LinearSceneGraph<ModelData>&& hierarchy)
 			:submeshes(renderables)
 			,hierarchy(std::move(hierarchy))
+			,worldTransforms(this->hierarchy.size(), glm::mat4(1))
+			,dirtyNodes(this->hierarchy.size(), true)
+			,anyDirty(!this->hierarchy.empty())
+		{
+			ComputeDepths();
+		}
+		void Model::SetRootTransform(const glm::mat4& t)
+		{
+			rootTransform = t;
+			for (node_index i = 0; i < hierarchy.size(); i = hierarchy.subtree_end(i))
+			{
+				dirtyNodes[i] = true;
+			}
+			anyDirty = !hierarchy.empty();
+		}
+		bool Model::IsReady() const
+		{
+			return std::all_of(submeshes.begin(), submeshes.end(), [](const Renderable& r)
+			{
+				return r.mesh == nullptr || r.mesh->IsReady();
+			});
+		}
+		UploadState Model::GetUploadState() const
+		{
+			auto state = UploadState::Complete;
+			for (const auto& r : submeshes)
+			{
+				if (r.mesh == nullptr) continue;
+				auto s = r.mesh->GetUploadState();
+				if (s == UploadState::Failed) return s;
+				if (s == UploadState::Pending) state = s;
+			}
+			return state;
+		}
+		std::string Model::GetUploadError() const
+		{
+			for (const auto& r : submeshes)
+			{
+				if (r.mesh == nullptr) continue;
+				auto error = r.mesh->GetUploadError();
+				if (!error.empty()) return error;
+			}
+			return {};
+		}
+		const glm::mat4& Model::GetRootTransform() const noexcept
+		{
+			return rootTransform;
+		}
+		void Model::SetLocalTransform(node_index n, const glm::mat4& t)
+		{
+			hierarchy[n].transform = t;
+			dirtyNodes[n] = true;
+			anyDirty = true;
+		}
+		const glm::mat4& Model::GetLocalTransform(node_index n) const noexcept
 		{
+			return hierarchy[n].transform;
+		}
+		const glm::mat4& Model::GetWorldTransform(node_index n) const noexcept
+		{
+			return worldTransforms[n];
+		}
+		const std::vector<Model::node_index>& Model::UpdateWorldTransforms()
+		{
+			updatedNodes.clear();
+			if (!anyDirty) return updatedNodes;
+
+			UpdateRange(0, hierarchy.size(), updatedNodes, scratch);
+
+			anyDirty = false;
+			return updatedNodes;
+		}
+		const std::vector<Model::node_index>& Model::UpdateWorldTransforms(Utilities::JobSystem& jobs)
+		{
+			updatedNodes.clear();
+			if (!anyDirty) return updatedNodes;
+
+			//Imported scenes usually hang everything off a single root, so
+			//the roots are done here and their children become the tasks.
+			//Sibling subtrees share no nodes, so tasks never write to the
+			//same element of worldTransforms or dirtyNodes.
+			taskRoots.clear();
+			for (node_index r = 0; r < hierarchy.size(); r = hierarchy.subtree_end(r))
+			{
+				bool rootDirty = dirtyNodes[r] != 0;
+				if (rootDirty)
+				{
+					MultiplyTransform(rootTransform, hierarchy[r].transform, worldTransforms[r]);
+					dirtyNodes[r] = false;
+					updatedNodes.push_back(r);
+				}
+				for (auto c = hierarchy.first_child(r); c != hierarchy.npos; c = hierarchy.next_sibling(c))
+				{
+					if (rootDirty) dirtyNodes[c] = true;
+					taskRoots.push_back(c);
+				}
+			}
+
+			if (taskUpdates.size() < taskRoots.size())
+			{
+				taskUpdates.resize(taskRoots.size());
+				taskScratch.resize(taskRoots.size());
+			}
+			jobs.ParallelFor(taskRoots.size(), [this](std::size_t t)
+			{
+				auto c = taskRoots[t];
+				taskUpdates[t].clear();
+				UpdateRange(c, hierarchy.subtree_end(c), taskUpdates[t], taskScratch[t]);
+			});
+
+			//Roots first, then each subtree; still parents before children.
+			for (std::size_t t = 0; t < taskRoots.size(); ++t)
+			{
+				updatedNodes.insert(updatedNodes.end(), taskUpdates[t].begin(), taskUpdates[t].end());
+			}
+
+			anyDirty = false;
+			return updatedNodes;
+		}
+		void Model::ComputeDepths()
+		{
+			nodeDepths.resize(hierarchy.size());
+			for (node_index i = 0; i < hierarchy.size(); ++i)
+			{
+				auto parent = hierarchy.parent(i);
+				nodeDepths[i] = parent == hierarchy.npos ? 0 : nodeDepths[parent] + 1;
+			}
+		}
+		void Model::UpdateRange(node_index i, node_index last, std::vector<node_index>& updated, TransformScratch& s)
+		{
+			//Nodes at the same depth only read the level above, so every
+			//dirty node is bucketed by depth and each level is one batch.
+			auto firstUpdated = updated.size();
+			for (auto& level : s.levels)
+			{
+				level.clear();
+			}
+			while (i < last)
+			{
+				if (!dirtyNodes[i])
+				{
+					++i;
+					continue;
+				}
+
+				//A dirty node invalidates its whole subtree.
+				auto subtreeEnd = hierarchy.subtree_end(i);
+				for (; i < subtreeEnd; ++i)
+				{
+					auto depth = nodeDepths[i];
+					if (s.levels.size() <= depth)
+					{
+						s.levels.resize(depth + 1);
+					}
+					s.levels[depth].push_back(i);
+					dirtyNodes[i] = false;
+					updated.push_back(i);
+				}
+			}
+			if (updated.size() == firstUpdated) return;
+
+			for (const auto& level : s.levels)
+			{
+				auto n = level.size();
+				if (n < MinimumBatchedTransforms)
+				{
+					for (auto node : level)
+					{
+						auto parent = hierarchy.parent(node);
+						const auto& parentWorld = parent == hierarchy.npos ? rootTransform : worldTransforms[parent];
+						MultiplyTransform(parentWorld, hierarchy[node].transform, worldTransforms[node]);
+					}
+					continue;
+				}
 
+				s.parents.resize(n);
+				s.locals.resize(n);
+				for (std::size_t j = 0; j < n; ++j)
+				{
+					auto parent = hierarchy.parent(level[j]);
+					s.parents.Set(j, parent == hierarchy.npos ? rootTransform : worldTransforms[parent]);
+					s.locals.Set(j, hierarchy[level[j]].transform);
+				}
+				MultiplyTransforms(s.parents, s.locals, s.worlds);
+				for (std::size_t j = 0; j < n; ++j)
+				{
+					worldTransforms[level[j]] = s.worlds.Get(j);
+				}
+			}
 		}
 		ModelData::ModelData(const glm::mat4& trans, 
 							std::vector<unsigned int>&& indices, 
@@ -24,4 +228,4 @@ namespace GlProj
 			, name(name)
 		{}
 	}
-}
\ No newline at end of file
+}
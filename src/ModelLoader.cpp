@@ -0,0 +1,308 @@
+#include "ModelLoader.hpp"
+#include "assimp/Importer.hpp"
+#include "assimp/postprocess.h"
+#include "assimp/scene.h"
+#include "AssetManager.hpp"
+#include "BakedModel.hpp"
+#include "JobSystem.hpp"
+#include "MappedFile.hpp"
+#include "MeshManager.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		using Utilities::FileStamp;
+		using Utilities::JobSystem;
+		using Utilities::SceneNode;
+
+		namespace
+		{
+			//Everything one import carries between its jobs.
+			struct ModelImport
+			{
+				Assimp::Importer importer;
+				const aiScene* scene = nullptr;
+				BakedModel model;
+				std::promise<Model> result;
+			};
+
+			glm::mat4 aiToGlm(const aiMatrix4x4& o)
+			{
+				return{ o.a1, o.a2, o.a3, o.a4,
+					   o.b1, o.b2, o.b3, o.b4,
+					   o.c1, o.c2, o.c3, o.c4,
+					   o.d1, o.d2, o.d3, o.d4 };
+			}
+
+			template<typename I>
+			//requires value_type of iterator is std::string
+			void MakeNamesUnique(I first, I last)
+			{
+				auto firstMesh = first;
+				while (firstMesh != last)
+				{
+					auto pairStart = std::adjacent_find(firstMesh, last);
+					if (pairStart == last)
+					{
+						break;
+					}
+					int i = 0;
+
+					std::string prev = *pairStart;
+					first = pairStart;
+					//First duplicate will have a 0-suffix
+					*first += std::to_string(i);
+					++i;
+					++pairStart;
+					//Second duplicate will have a 1-suffix
+					*pairStart += std::to_string(i);
+					++pairStart;
+					++i;
+					//Subsequent duplicates will have
+					while (pairStart != last && *pairStart == prev)
+					{
+						*pairStart += std::to_string(i);
+						++pairStart;
+						++i;
+					}
+					firstMesh = pairStart;
+				}
+			}
+
+			void AddChildren(SceneGraph<ModelData>& graph, SceneNode<ModelData>* parent, const aiNode* node)
+			{
+				for (int i = 0; i < int(node->mNumChildren); ++i)
+				{
+					graph.emplace(parent, aiToGlm(node->mChildren[i]->mTransformation),
+						std::vector<unsigned int>(node->mChildren[i]->mMeshes, node->mChildren[i]->mMeshes + node->mChildren[i]->mNumMeshes),
+						node->mChildren[i]->mName.C_Str());
+				}
+
+				for (int i = 0; i < int(node->mNumChildren); ++i)
+				{
+					AddChildren(graph, parent->children->data() + i, node->mChildren[i]);
+				}
+			}
+
+			void PopulateGraph(SceneGraph<ModelData>& graph, const aiNode* root)
+			{
+				auto parent = graph.emplace(nullptr, aiToGlm(root->mTransformation),
+					std::vector<unsigned int>(root->mMeshes, root->mMeshes + root->mNumMeshes),
+					root->mName.C_Str());
+
+				AddChildren(graph, parent, root);
+			}
+
+			void ImportScene(ModelImport& import, const std::string& path, const ModelImportSettings& settings)
+			{
+				auto& importer = import.importer;
+				importer.SetPropertyInteger(AI_CONFIG_PP_SLM_TRIANGLE_LIMIT, settings.splitTriangleLimit);
+				importer.SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT, settings.splitVertexLimit);
+				auto scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_SortByPType
+					| aiProcess_GenUVCoords | aiProcess_OptimizeGraph
+					| aiProcess_OptimizeMeshes | aiProcess_GenSmoothNormals);
+				if (scene != nullptr)
+				{
+					scene = importer.ApplyPostProcessing(aiProcess_SplitLargeMeshes | aiProcess_CalcTangentSpace | aiProcess_ValidateDataStructure);
+				}
+
+				if (scene == nullptr)
+				{
+					std::string err;
+					err += importer.GetErrorString();
+					throw std::runtime_error(err);
+				}
+				import.scene = scene;
+			}
+
+			void StageMeshes(JobSystem& jobs, ModelImport& import)
+			{
+				auto scene = import.scene;
+
+				std::vector<std::string> meshNames;
+				meshNames.reserve(scene->mNumMeshes);
+				std::transform(scene->mMeshes, scene->mMeshes + scene->mNumMeshes, std::back_inserter(meshNames),
+					[](const auto& x)
+				{
+					return x->mName.C_Str();
+				});
+
+				MakeNamesUnique(meshNames.begin(), meshNames.end());
+
+				auto& meshes = import.model.meshes;
+				meshes.resize(scene->mNumMeshes);
+				//Jobs must not throw, so the first failure is carried out.
+				std::mutex failureLock;
+				std::exception_ptr failure;
+				jobs.ParallelFor(scene->mNumMeshes, [&meshes, &meshNames, &failureLock, &failure, scene](std::size_t i)
+				{
+					try
+					{
+						meshes[i] = StageMesh(scene->mMeshes[i], meshNames[i]);
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(failureLock);
+						if (failure == nullptr)
+						{
+							failure = std::current_exception();
+						}
+					}
+				});
+				if (failure != nullptr)
+				{
+					std::rethrow_exception(failure);
+				}
+
+				SceneGraph<ModelData> graph;
+				PopulateGraph(graph, scene->mRootNode);
+				import.model.hierarchy = LinearSceneGraph<ModelData>(graph);
+
+				//Everything needed is staged, so the scene can go early.
+				import.importer.FreeScene();
+				import.scene = nullptr;
+			}
+
+			//LocalSharedPtr counts are not atomic, so the meshes and the
+			//model that owns them are only ever created on the main thread.
+			void UploadModel(ModelImport& import, const ModelImportSettings& settings, GpuUploader* uploader)
+			{
+				std::vector<Renderable> submeshes;
+				submeshes.reserve(import.model.meshes.size());
+				for (auto& m : import.model.meshes)
+				{
+					auto mesh = uploader == nullptr
+						? RegisterMesh(GetMeshManager(), std::move(m), settings.replaceMeshes)
+						: RegisterMesh(GetMeshManager(), *uploader, std::move(m), settings.replaceMeshes);
+					submeshes.push_back({ std::move(mesh), nullptr });
+				}
+				import.model.meshes.clear();
+
+				import.result.set_value(Model{ submeshes, std::move(import.model.hierarchy) });
+			}
+
+			//Where an import's bake lives, and the key that tells whether the
+			//bake there is of the current source.
+			struct BakeLocation
+			{
+				std::string path;
+				std::uint64_t sourceKey = 0;
+				std::string settings;
+			};
+
+			std::string DescribeSettings(const ModelImportSettings& settings)
+			{
+				return "model split:" + std::to_string(settings.splitTriangleLimit)
+					+ ',' + std::to_string(settings.splitVertexLimit);
+			}
+
+			//With a project open, bakes are found by the source's contents,
+			//so touching or copying a source costs no re-import. Otherwise
+			//the bake sits beside the source and is keyed by its stamp.
+			bool LocateBake(const std::string& source, const ModelImportSettings& settings, BakeLocation& out)
+			{
+				if (!settings.useBakedCache) return false;
+
+				auto assets = Utilities::GetAssetManager();
+				if (assets != nullptr)
+				{
+					std::uint64_t hash;
+					if (!GetContentHash(assets, source, hash)) return false;
+					out.settings = DescribeSettings(settings);
+					out.sourceKey = Utilities::MakeArtifactKey(hash, out.settings);
+					if (!FindArtifact(assets, out.sourceKey, out.path))
+					{
+						out.path = GetArtifactPath(assets, out.sourceKey, ".bake");
+					}
+					return true;
+				}
+
+				FileStamp stamp;
+				if (!Utilities::GetFileStamp(source, stamp)) return false;
+				out.path = BakedModelPath(source);
+				out.sourceKey = Utilities::HashBytes(&stamp.modified, sizeof(stamp.modified),
+					Utilities::HashBytes(&stamp.size, sizeof(stamp.size)));
+				return true;
+			}
+			bool TryReadBake(ModelImport& import, const BakeLocation& bake, const ModelImportSettings& settings)
+			{
+				try
+				{
+					return ReadBakedModel(bake.path, bake.sourceKey, settings, import.model);
+				}
+				catch (const std::exception&)
+				{
+					return false;
+				}
+			}
+			//A bake that cannot be written only costs the next load its speed.
+			void TryWriteBake(const ModelImport& import, const std::string& source, const BakeLocation& bake,
+				const ModelImportSettings& settings)
+			{
+				try
+				{
+					WriteBakedModel(bake.path, bake.sourceKey, settings, import.model);
+					if (auto assets = Utilities::GetAssetManager())
+					{
+						RecordImport(assets, source, bake.settings, bake.sourceKey, bake.path);
+					}
+				}
+				catch (const std::exception&)
+				{
+				}
+			}
+		}
+
+		std::future<Model> LoadModelAsync(JobSystem& jobs, const std::string& path, const ModelImportSettings& settings,
+			GpuUploader* uploader)
+		{
+			auto import = std::make_shared<ModelImport>();
+			auto result = import->result.get_future();
+
+			jobs.Run([&jobs, import, path, settings, uploader]()
+			{
+				try
+				{
+					BakeLocation bake;
+					auto useBake = LocateBake(path, settings, bake);
+					if (!useBake || !TryReadBake(*import, bake, settings))
+					{
+						ImportScene(*import, path, settings);
+						StageMeshes(jobs, *import);
+						if (useBake) TryWriteBake(*import, path, bake, settings);
+					}
+				}
+				catch (...)
+				{
+					import->result.set_exception(std::current_exception());
+					return;
+				}
+
+				jobs.RunOnMainThread([import, settings, uploader]()
+				{
+					try
+					{
+						UploadModel(*import, settings, uploader);
+					}
+					catch (...)
+					{
+						import->result.set_exception(std::current_exception());
+					}
+				});
+			});
+
+			return result;
+		}
+	}
+}
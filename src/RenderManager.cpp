@@ -1,14 +1,18 @@
 #include "RenderManager.hpp"
 #include "Camera.hpp"
+#include "GpuUploader.hpp"
 #include "Material.hpp"
 #include "Mesh.hpp"
 #include "MeshDataBuffer.hpp"
 #include "ShadingProgram.hpp"
+#include "StreamingBuffer.hpp"
 #include "Transform.hpp"
 
+#include "GLFW/glfw3.h"
 #include "glm/mat4x4.hpp"
 
 #include <algorithm>
+#include <iterator>
 #include <string>
 #include <type_traits>
 #include <utility>
@@ -27,16 +31,24 @@ namespace GlProj
 			friend void DrawRenderable(RenderManager*, RenderBatch*, RenderableHandle*);
 
 			static const constexpr auto MaxBatchedDraws = GLsizeiptr(500);
+			static const constexpr auto BatchedDrawsPerFrame = GLsizeiptr(64);
 
 		public:
-			MeshDataBuffer transformBuffer;
+			//Per-frame streamed data: instance transforms and per-draw state.
+			StreamingBuffer transformBuffer;
+			StreamingBuffer drawDataBuffer;
 			std::vector<LocalWeakPtr<RenderBatch>> batches;
+			GLsizeiptr transformCapacity;
+			GLint storageAlignment = 1;
 			bool dirty = true;
 
 			explicit RenderManager(GLsizeiptr s = MaxBatchedDraws)
-				:transformBuffer(BufferType::array, s * sizeof(glm::mat4), nullptr, GL_FLOAT, 4, BufferUsage::stream_draw)
+				:transformBuffer(BufferType::array, s * sizeof(glm::mat4) * BatchedDrawsPerFrame)
+				, drawDataBuffer(BufferType::shader_storage, s * sizeof(glm::mat4) * BatchedDrawsPerFrame)
 				, batches()
+				, transformCapacity(s)
 			{
+				glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
 
 			}
 
@@ -49,6 +61,28 @@ namespace GlProj
 			void OptimiseBatchOrder();
 			void CleanStale();
 		};
+		//Layout mandated by glMultiDrawElementsIndirect.
+		struct DrawElementsIndirectCommand
+		{
+			GLuint count;
+			GLuint instanceCount;
+			GLuint firstIndex;
+			GLint baseVertex;
+			GLuint baseInstance;
+		};
+
+		//A run of indirect commands sharing one material and vertex array,
+		//submitted with a single multi-draw call.
+		struct IndirectDrawGroup
+		{
+			Material* material;
+			const Mesh* mesh;
+			GLsizei firstCommand;
+			GLsizei commandCount;
+			std::size_t firstHandle;
+			std::size_t handleCount;
+		};
+
 		class RenderBatch final
 		{
 			friend void DrawBatch(RenderManager*, RenderBatch*);
@@ -66,17 +100,27 @@ namespace GlProj
 
 			glm::mat4 projectionTransform = glm::mat4(1);
 			glm::mat4 viewTransform = glm::mat4(1);
+			glm::mat4 viewProjectionTransform = glm::mat4(1);
+			MeshDataBuffer cameraBuffer;
+
+			std::vector<DrawElementsIndirectCommand> indirectCommands;
+			std::vector<IndirectDrawGroup> indirectGroups;
+			MeshDataBuffer indirectBuffer;
 
 			Material* overrideMaterial = nullptr;
 
 			BatchType type;
+			BatchSubmission submission = BatchSubmission::Direct;
 			int priority;
 			bool groupedByMaterial;
 			bool groupedByMesh;
 			bool dirty = false;
+			bool cameraDirty = true;
+			bool indirectDirty = true;
 
 			RenderBatch() = default;
-			RenderBatch(BatchType t, int priority, bool groupMat, bool groupMesh);
+			RenderBatch(BatchType t, int priority, bool groupMat, bool groupMesh,
+				BatchSubmission submit = BatchSubmission::Direct);
 
 			template <typename I, typename H>
 			inline std::pair<I, I> FindHandleSubrange(I first, I last, const H& h)
@@ -95,6 +139,8 @@ namespace GlProj
 				return elemRange;
 			}
 
+			void UploadCamera();
+			void BuildIndirectCommands();
 			LocalSharedPtr<RenderableHandle> AddHandle(LocalWeakPtr<RenderableHandle> h);
 			bool RemoveHandle(const LocalWeakPtr<RenderableHandle>& h);
 
@@ -107,6 +153,17 @@ namespace GlProj
 				return std::upper_bound(first, last, *first, pred);
 			}
 		};
+		//Matches the std140 layout of the reserved camera_block.
+		struct CameraBlockData
+		{
+			glm::mat4 view;
+			glm::mat4 projection;
+			glm::mat4 viewProjection;
+			glm::mat4 inverseView;
+			glm::mat4 inverseProjection;
+			glm::mat4 inverseViewProjection;
+		};
+
 		class RenderableHandle final
 		{
 			friend void DrawRenderable(RenderManager*, RenderBatch*, RenderableHandle*);
@@ -120,24 +177,57 @@ namespace GlProj
 			RenderableHandle(Mesh* me, Material* ma) : mesh(me), material(ma) {}
 		};
 
-		static const std::string bm_transform_id = "bm_transform";
-		static const std::string m_transform_id = "m_transform";
-		static const std::string v_transform_id = "v_transform";
-		static const std::string p_transform_id = "p_transform";
-		static const std::string mv_transform_id = "mv_transform";
-		static const std::string vp_transform_id = "vp_transform";
-		static const std::string mvp_transform_id = "mvp_transform";
-
-		static const std::string i_m_transform_id = "im_transform";
-		static const std::string i_v_transform_id = "iv_transform";
-		static const std::string i_p_transform_id = "ip_transform";
-		static const std::string i_mv_transform_id = "imv_transform";
-		static const std::string i_vp_transform_id = "ivp_transform";
-		static const std::string i_mvp_transform_id = "imvp_transform";
-		
 		void UpdateTransforms(Material* m, glm::mat4 model, glm::mat4 view, glm::mat4 projection,
 			bool updateModel = true, bool updateView = true, bool updateProject = true);
 
+		//Points the instanced model transform attributes of the bound VAO
+		//at 'buffer'. A mat4 attribute spans four consecutive slots.
+		void BindInstanceTransforms(const StreamingBuffer& buffer)
+		{
+			buffer.Bind();
+			for (GLuint i = 0; i < 4; ++i)
+			{
+				auto slot = MeshSlots(MeshSlotToGL(InstanceTransformSlot) + i);
+				Mesh::EnableAttribute(slot);
+				Mesh::SetAttributePointer(slot, 4, GL_FLOAT, sizeof(glm::mat4),
+					reinterpret_cast<const void*>(i * sizeof(glm::vec4)));
+				Mesh::SetAttributeDivisor(slot, 1);
+			}
+		}
+
+		//Draws every handle in [first, last) with one instanced call per
+		//'transformCapacity' handles. All handles must share the bound mesh.
+		//Transforms are written straight into the mapped stream buffer and
+		//selected through the base instance, so the attribute setup is
+		//shared by every chunk.
+		template<typename I>
+		void DrawInstanced(RenderManager* mngr, const Mesh& mesh, I first, I last)
+		{
+			auto& buffer = mngr->transformBuffer;
+			BindInstanceTransforms(buffer);
+
+			while (first != last)
+			{
+				auto count = std::min(GLsizeiptr(std::distance(first, last)), mngr->transformCapacity);
+				auto allocation = buffer.Allocate(count * sizeof(glm::mat4), sizeof(glm::mat4));
+				auto transforms = static_cast<glm::mat4*>(allocation.data);
+
+				for (GLsizeiptr i = 0; i < count; ++i, ++first)
+				{
+					transforms[i] = first->lock()->transform;
+				}
+
+				glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, mesh.PrimitiveCount(), GLenum(mesh.GetIndexType()),
+					mesh.IndexOffset(), GLsizei(count), mesh.BaseVertex(), GLuint(allocation.offset / sizeof(glm::mat4)));
+			}
+		}
+
+		bool MultiDrawIndirectSupported()
+		{
+			static const bool supported = glfwExtensionSupported("GL_ARB_shader_draw_parameters") != 0;
+			return supported;
+		}
+
 		RenderManager* GetRenderManager()
 		{
 			static RenderManager manager{};
@@ -148,9 +238,10 @@ namespace GlProj
 			BatchType bt,
 			int pr,
 			bool gMat,
-			bool gMesh)
+			bool gMesh,
+			BatchSubmission submit)
 		{
-			auto newBatch = Utilities::make_localshared<RenderBatch>(bt, pr, gMat, gMesh);
+			auto newBatch = Utilities::make_localshared<RenderBatch>(bt, pr, gMat, gMesh, submit);
 			mngr->RegisterBatch(newBatch);
 
 			return newBatch;
@@ -161,6 +252,7 @@ namespace GlProj
 			auto prev = batch->overrideMaterial;
 			batch->overrideMaterial = mat;
 			batch->dirty = true;
+			batch->indirectDirty = true;
 			return prev;
 		}
 
@@ -168,6 +260,8 @@ namespace GlProj
 		{
 			batch->viewTransform = cam.View();
 			batch->projectionTransform = cam.Projection();
+			batch->viewProjectionTransform = cam.ViewProjection();
+			batch->cameraDirty = true;
 		}
 
 		local_shared_ptr<RenderableHandle> SubmitRenderable(RenderBatch* batch,
@@ -191,6 +285,7 @@ namespace GlProj
 			auto prev = rnd->material;
 			rnd->material = mat;
 			batch->dirty = true;
+			batch->indirectDirty = true;
 			return prev;
 		}
 
@@ -206,20 +301,122 @@ namespace GlProj
 		void Draw(RenderManager* mngr)
 		{
 			mngr->OptimiseBatchOrder();
+			mngr->transformBuffer.BeginFrame();
+			mngr->drawDataBuffer.BeginFrame();
 			for (auto& b : mngr->batches)
 			{
 				DrawBatch(mngr, b.lock().get());
 			}
+			mngr->drawDataBuffer.EndFrame();
+			mngr->transformBuffer.EndFrame();
+		}
+
+		//The camera block is only uploaded and bound once a program in the
+		//batch reads it.
+		void BindCameraBlock(RenderBatch* batch, const Material& material, bool& bound)
+		{
+			if (bound) return;
+			auto program = material.GetProgram();
+			if (program == nullptr || !program->UsesCameraBlock()) return;
+
+			batch->UploadCamera();
+			batch->cameraBuffer.BindBase(GLuint(ReservedBlock::Camera));
+			bound = true;
 		}
 
-		void DrawBatch(RenderManager*, RenderBatch* batch)
+		//Draws an indirect group's commands as DrawBatch would: instanced when
+		//the program reads instance_transform, otherwise a draw per handle.
+		void DrawGroupDirect(RenderManager* mngr, RenderBatch* batch, Material* material, const IndirectDrawGroup& group)
+		{
+			const bool instanced = material->GetProgram()->TransformsAreBatchable();
+			const auto groupBegin = batch->handles.begin() + group.firstHandle;
+			for (auto c = group.firstCommand; c < group.firstCommand + group.commandCount; ++c)
+			{
+				const auto& command = batch->indirectCommands[c];
+				auto first = groupBegin + command.baseInstance;
+				auto last = first + command.instanceCount;
+				auto& mesh = *first->lock()->mesh;
+				mesh.Bind();
+
+				if (instanced)
+				{
+					DrawInstanced(mngr, mesh, first, last);
+					continue;
+				}
+				for (; first != last; ++first)
+				{
+					UpdateTransforms(material, first->lock()->transform, batch->viewTransform, batch->projectionTransform, true, false, false);
+					glDrawElementsBaseVertex(GL_TRIANGLES, mesh.PrimitiveCount(), GLenum(mesh.GetIndexType()),
+						mesh.IndexOffset(), mesh.BaseVertex());
+				}
+			}
+		}
+
+		//Submits each indirect group with one multi-draw. Per-draw model
+		//matrices are streamed into the transform block in handle order, so
+		//each command's base instance indexes its first matrix.
+		void DrawBatchIndirect(RenderManager* mngr, RenderBatch* batch)
+		{
+			batch->BuildIndirectCommands();
+			batch->indirectBuffer.Bind();
+
+			const bool usingOverride = batch->overrideMaterial != nullptr;
+			Material* boundMaterial = nullptr;
+			bool cameraBound = false;
+
+			for (const auto& group : batch->indirectGroups)
+			{
+				auto material = usingOverride ? batch->overrideMaterial : group.material;
+				if (material != boundMaterial)
+				{
+					material->Bind();
+					BindCameraBlock(batch, *material, cameraBound);
+					UpdateTransforms(material, glm::mat4(1), batch->viewTransform, batch->projectionTransform, false, true, true);
+					boundMaterial = material;
+				}
+
+				auto first = batch->handles.begin() + group.firstHandle;
+				auto last = first + group.handleCount;
+				group.mesh->Bind();
+
+				if (!material->GetProgram()->UsesTransformBlock())
+				{
+					//Programs without the block cannot index per-draw data.
+					DrawGroupDirect(mngr, batch, material, group);
+					continue;
+				}
+
+				auto allocation = mngr->drawDataBuffer.Allocate(group.handleCount * sizeof(glm::mat4),
+					mngr->storageAlignment);
+				auto transforms = static_cast<glm::mat4*>(allocation.data);
+				for (; first != last; ++first, ++transforms)
+				{
+					*transforms = first->lock()->transform;
+				}
+				mngr->drawDataBuffer.BindRange(GLuint(ReservedBlock::Transforms), allocation);
+
+				auto commandOffset = group.firstCommand * sizeof(DrawElementsIndirectCommand);
+				glMultiDrawElementsIndirect(GL_TRIANGLES, GLenum(group.mesh->GetIndexType()),
+					reinterpret_cast<const void*>(commandOffset), group.commandCount, 0);
+			}
+		}
+
+		void DrawBatch(RenderManager* mngr, RenderBatch* batch)
 		{
 			batch->OptimiseBatch();
 
+			if (batch->submission == BatchSubmission::MultiDrawIndirect && MultiDrawIndirectSupported())
+			{
+				DrawBatchIndirect(mngr, batch);
+				return;
+			}
+
 			const bool usingOverride = batch->overrideMaterial != nullptr;
+			bool cameraBound = false;
 			if (usingOverride)
 			{
 				batch->overrideMaterial->Bind();
+				BindCameraBlock(batch, *batch->overrideMaterial, cameraBound);
 				UpdateTransforms(batch->overrideMaterial, glm::mat4(1), batch->viewTransform, batch->projectionTransform, false, true, true);
 			}
 
@@ -233,6 +430,8 @@ namespace GlProj
 			{
 				auto pinnedMaterial = materialBegin->lock();
 				auto& materialInUse = usingOverride ? *batch->overrideMaterial : *pinnedMaterial->material;
+				auto programInUse = materialInUse.GetProgram();
+				const bool instanced = programInUse != nullptr && programInUse->TransformsAreBatchable();
 
 				//Bind shared material
 				if (usingOverride)
@@ -242,6 +441,7 @@ namespace GlProj
 				else
 				{
 					materialInUse.Bind();
+					BindCameraBlock(batch, materialInUse, cameraBound);
 					//Apply non-static bind information to Material
 					UpdateTransforms(&materialInUse, glm::mat4(1), batch->viewTransform, batch->projectionTransform, false, true, true);
 				}
@@ -253,22 +453,33 @@ namespace GlProj
 
 				while (meshBegin != materialEnd)
 				{
-					//Bind shared meshes
-					//Initialize instance buffer
-					//Render
 					auto pinnedMesh = meshBegin->lock();
 					auto& meshInUse = *pinnedMesh->mesh;
-					meshInUse.Bind();
 
-					while (meshBegin != meshEnd)
+					if (!meshInUse.IsReady())
+					{
+						//Still uploading, or the upload failed.
+						meshBegin = meshEnd;
+					}
+					else if (instanced)
 					{
-						UpdateTransforms(&materialInUse, meshBegin->lock()->transform, batch->viewTransform, batch->projectionTransform, true, false, false);
+						meshInUse.Bind();
+						DrawInstanced(mngr, meshInUse, meshBegin, meshEnd);
+						meshBegin = meshEnd;
+					}
+					else
+					{
+						meshInUse.Bind();
+						while (meshBegin != meshEnd)
+						{
+							UpdateTransforms(&materialInUse, meshBegin->lock()->transform, batch->viewTransform, batch->projectionTransform, true, false, false);
 
-						glDrawElements(GL_TRIANGLES, meshInUse.PrimitiveCount(), GL_UNSIGNED_INT, nullptr);
+							glDrawElementsBaseVertex(GL_TRIANGLES, meshInUse.PrimitiveCount(), GLenum(meshInUse.GetIndexType()),
+								meshInUse.IndexOffset(), meshInUse.BaseVertex());
 
-						++meshBegin;
+							++meshBegin;
+						}
 					}
-					//
 
 					meshEnd = batch->GetNextSubrange(meshBegin,
 						materialEnd,
@@ -291,98 +502,71 @@ namespace GlProj
 		inline void UpdateTransforms(Material* m, glm::mat4 model, glm::mat4 view, glm::mat4 projection,
 									bool updateModel, bool updateView, bool updateProject)
 		{
+			using U = ReservedUniform;
+			static const constexpr auto modelDependent = ReservedUniformBit(U::Model) | ReservedUniformBit(U::InverseModel);
+			static const constexpr auto viewDependent = ReservedUniformBit(U::View) | ReservedUniformBit(U::InverseView);
+			static const constexpr auto projectionDependent = ReservedUniformBit(U::Projection) | ReservedUniformBit(U::InverseProjection);
+			static const constexpr auto modelViewDependent = ReservedUniformBit(U::ModelView) | ReservedUniformBit(U::InverseModelView);
+			static const constexpr auto viewProjectionDependent = ReservedUniformBit(U::ViewProjection) | ReservedUniformBit(U::InverseViewProjection);
+			static const constexpr auto allDependent = ReservedUniformBit(U::ModelViewProjection) | ReservedUniformBit(U::InverseModelViewProjection);
+
 			auto prog = m->GetProgram();
 
-			const auto uniformEnd = prog->UniformsEnd();
+			auto wanted = ReservedUniformMask(0);
+			wanted |= updateModel ? modelDependent : 0;
+			wanted |= updateView ? viewDependent : 0;
+			wanted |= updateProject ? projectionDependent : 0;
+			wanted |= (updateModel || updateView) ? modelViewDependent : 0;
+			wanted |= (updateView || updateProject) ? viewProjectionDependent : 0;
+			wanted |= (updateModel || updateView || updateProject) ? allDependent : 0;
 
-			if (updateModel)
-			{
-				auto m_transform_h = prog->FindUniform(m_transform_id);
-				auto i_m_transform_h = prog->FindUniform(i_m_transform_id);
+			//Only products and inverses the program actually consumes are computed.
+			const auto mask = wanted & prog->GetReservedUniformMask();
+			if (mask == 0) return;
 
-				if (m_transform_h != uniformEnd)
-				{
-					m->SetUniform(*m_transform_h, model);
-				}
-				if (i_m_transform_h != uniformEnd)
-				{
-					m->SetUniform(*i_m_transform_h, glm::inverse(model));
-				}
-			}
-			if (updateView)
+			auto has = [mask](U u)
 			{
-				auto v_transform_h = prog->FindUniform(v_transform_id);
-				auto i_v_transform_h = prog->FindUniform(i_v_transform_id);
-
-				if (v_transform_h != uniformEnd)
-				{
-					m->SetUniform(*v_transform_h, view);
-				}
-				if (i_v_transform_h != uniformEnd)
-				{
-					m->SetUniform(*i_v_transform_h, glm::inverse(view));
-				}
-			}
-			if (updateModel || updateView)
+				return (mask & ReservedUniformBit(u)) != 0;
+			};
+			auto set = [m, prog, &has](U u, const glm::mat4& value)
 			{
-				auto mv_transform_h = prog->FindUniform(mv_transform_id);
-				auto i_mv_transform_h = prog->FindUniform(i_mv_transform_id);
-
-				auto mvTran = view * model;
-
-				if (mv_transform_h != uniformEnd)
-				{
-					m->SetUniform(*mv_transform_h, mvTran);
-				}
-				if (i_mv_transform_h != uniformEnd)
+				if (has(u))
 				{
-					m->SetUniform(*i_mv_transform_h, glm::inverse(mvTran));
+					m->SetUniform(prog->GetReservedUniform(u), value);
 				}
-			}
-			if (updateProject)
+			};
+			auto setInverse = [m, prog, &has](U u, const glm::mat4& value)
 			{
-				auto p_transform_h = prog->FindUniform(p_transform_id);
-				auto i_p_transform_h = prog->FindUniform(i_p_transform_id);
-
-				if (p_transform_h != uniformEnd)
-				{
-					m->SetUniform(*p_transform_h, projection);
-				}
-				if (i_p_transform_h != uniformEnd)
+				if (has(u))
 				{
-					m->SetUniform(*i_p_transform_h, glm::inverse(projection));
+					m->SetUniform(prog->GetReservedUniform(u), glm::inverse(value));
 				}
-			}
-			if (updateView || updateProject)
-			{
-				auto vp_transform_h = prog->FindUniform(vp_transform_id);
-				auto i_vp_transform_h = prog->FindUniform(i_vp_transform_id);
+			};
 
-				auto vpTran = projection * view;
+			set(U::Model, model);
+			setInverse(U::InverseModel, model);
+			set(U::View, view);
+			setInverse(U::InverseView, view);
+			set(U::Projection, projection);
+			setInverse(U::InverseProjection, projection);
 
-				if (vp_transform_h != uniformEnd)
-				{
-					m->SetUniform(*vp_transform_h, vpTran);
-				}
-				if (i_vp_transform_h != uniformEnd)
-				{
-					m->SetUniform(*i_vp_transform_h, glm::inverse(vpTran));
-				}
+			if ((mask & modelViewDependent) != 0)
+			{
+				auto mvTran = view * model;
+				set(U::ModelView, mvTran);
+				setInverse(U::InverseModelView, mvTran);
 			}
-			if (updateModel || updateView || updateProject)
+			if ((mask & (viewProjectionDependent | allDependent)) != 0)
 			{
-				auto mvp_transform_h = prog->FindUniform(mvp_transform_id);
-				auto i_mvp_transform_h = prog->FindUniform(i_mvp_transform_id);
-
-				auto mvp = projection * view * model;
+				auto vpTran = projection * view;
+				set(U::ViewProjection, vpTran);
+				setInverse(U::InverseViewProjection, vpTran);
 
-				if (mvp_transform_h != uniformEnd)
-				{
-					m->SetUniform(*mvp_transform_h, mvp);
-				}
-				if (i_mvp_transform_h != uniformEnd)
+				if ((mask & allDependent) != 0)
 				{
-					m->SetUniform(*i_mvp_transform_h, glm::inverse(mvp));
+					auto mvp = vpTran * model;
+					set(U::ModelViewProjection, mvp);
+					setInverse(U::InverseModelViewProjection, mvp);
 				}
 			}
 		}
@@ -509,12 +693,100 @@ namespace GlProj
 		inline RenderBatch::RenderBatch(BatchType t,
 			int priority,
 			bool groupMat,
-			bool groupMesh)
+			bool groupMesh,
+			BatchSubmission submit)
 			: type(t),
+			submission(submit),
 			priority(priority),
 			groupedByMaterial(groupMat),
 			groupedByMesh(groupMesh)
 		{
+			cameraBuffer = MeshDataBuffer(BufferType::uniform, sizeof(CameraBlockData), nullptr,
+				GL_FLOAT, 16, BufferUsage::dynamic_draw);
+		}
+		inline void RenderBatch::UploadCamera()
+		{
+			if (!cameraDirty) return;
+
+			CameraBlockData block;
+			block.view = viewTransform;
+			block.projection = projectionTransform;
+			block.viewProjection = viewProjectionTransform;
+			block.inverseView = glm::inverse(viewTransform);
+			block.inverseProjection = glm::inverse(projectionTransform);
+			block.inverseViewProjection = glm::inverse(viewProjectionTransform);
+
+			cameraBuffer.Bind();
+			cameraBuffer.UpdateData(0, sizeof(block), &block);
+			cameraDirty = false;
+		}
+		void RenderBatch::BuildIndirectCommands()
+		{
+			if (!indirectDirty) return;
+
+			indirectCommands.clear();
+			indirectGroups.clear();
+
+			const bool usingOverride = overrideMaterial != nullptr;
+			const auto handlesBegin = handles.begin();
+			const auto handlesEnd = handles.end();
+			//Meshes still uploading are left out until a later rebuild;
+			//failed ones are left out for good.
+			bool anyPending = false;
+			bool skippedMesh = false;
+
+			auto materialBegin = handlesBegin;
+			while (materialBegin != handlesEnd)
+			{
+				//With an override material, handles are only ordered by mesh.
+				auto materialEnd = usingOverride ? handlesEnd
+					: GetNextSubrange(materialBegin, handlesEnd, OrderHandlesByMaterial);
+				auto material = usingOverride ? overrideMaterial : materialBegin->lock()->material;
+
+				auto meshBegin = materialBegin;
+				while (meshBegin != materialEnd)
+				{
+					auto meshEnd = GetNextSubrange(meshBegin, materialEnd, OrderHandlesByMesh);
+					auto mesh = meshBegin->lock()->mesh;
+
+					auto state = mesh->GetUploadState();
+					if (state != UploadState::Complete)
+					{
+						anyPending = anyPending || state == UploadState::Pending;
+						//A group's handles must stay contiguous.
+						skippedMesh = true;
+						meshBegin = meshEnd;
+						continue;
+					}
+
+					//Consecutive meshes can share a multi-draw only while they
+					//source vertices from the same vertex array.
+					bool extendsGroup = !skippedMesh && !indirectGroups.empty()
+						&& indirectGroups.back().material == material
+						&& indirectGroups.back().mesh->GetArrayBuffer() == mesh->GetArrayBuffer();
+					if (!extendsGroup)
+					{
+						indirectGroups.push_back({ material, mesh, GLsizei(indirectCommands.size()), 0,
+							std::size_t(meshBegin - handlesBegin), 0 });
+						skippedMesh = false;
+					}
+					auto& group = indirectGroups.back();
+					auto instances = std::size_t(meshEnd - meshBegin);
+
+					indirectCommands.push_back({ mesh->PrimitiveCount(), GLuint(instances), mesh->FirstIndex(),
+						mesh->BaseVertex(), GLuint(group.handleCount) });
+					++group.commandCount;
+					group.handleCount += instances;
+
+					meshBegin = meshEnd;
+				}
+				materialBegin = materialEnd;
+			}
+
+			indirectBuffer = MeshDataBuffer(BufferType::draw_indirect,
+				indirectCommands.size() * sizeof(DrawElementsIndirectCommand), indirectCommands.data(),
+				GL_UNSIGNED_INT, 5);
+			indirectDirty = anyPending;
 		}
 		inline LocalSharedPtr<RenderableHandle> RenderBatch::AddHandle(
 			LocalWeakPtr<RenderableHandle> h)
@@ -531,6 +803,7 @@ namespace GlProj
 			}
 			auto sp = h.lock();
 			handles.insert(elemPos, std::move(h));
+			indirectDirty = true;
 
 			return sp;
 		}
@@ -544,15 +817,20 @@ namespace GlProj
 			if (elemPos != elemRange.second)
 			{
 				handles.erase(elemPos);
+				indirectDirty = true;
 				return true;
 			}
 			return false;
 		}
 		void RenderBatch::CleanStale()
 		{
-			handles.erase(std::remove_if(handles.begin(), handles.end(),
-				[](const auto& x) { return x.expired(); }),
-				handles.end());
+			auto staleBegin = std::remove_if(handles.begin(), handles.end(),
+				[](const auto& x) { return x.expired(); });
+			if (staleBegin != handles.end())
+			{
+				handles.erase(staleBegin, handles.end());
+				indirectDirty = true;
+			}
 		}
 		void RenderBatch::OptimiseBatch()
 		{
@@ -569,6 +847,7 @@ namespace GlProj
 					std::stable_sort(handles.begin(), handles.end(), OrderHandlesByMaterial);
 				}
 				dirty = false;
+				indirectDirty = true;
 			}
 		}
 	}
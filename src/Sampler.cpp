@@ -1,19 +1,44 @@
 #include "Sampler.hpp"
 #include "gl_core_4_5.h"
 #include "GLFW/glfw3.h"
+#include <algorithm>
+#include <vector>
 
 namespace GlProj
 {
 	namespace Graphics
 	{
+		//What BindToUnit last left on each unit; 0 for nothing.
+		static std::vector<GLuint> unitBindings;
+
+		static bool UpdateUnitBinding(GLuint unit, GLuint handle)
+		{
+			if (unit >= unitBindings.size())
+			{
+				unitBindings.resize(unit + 1, 0);
+			}
+			if (unitBindings[unit] == handle) return false;
+			unitBindings[unit] = handle;
+			return true;
+		}
+		static void ForgetUnitBindings(GLuint handle) noexcept
+		{
+			std::replace(unitBindings.begin(), unitBindings.end(), handle, GLuint(0));
+		}
+
+		static std::uint64_t nextSamplerId = 0;
+
 		Sampler::Sampler() noexcept
+			:samplerId(++nextSamplerId)
 		{
 			glGenSamplers(1, &samplerHandle);
 		}
 		Sampler::Sampler(Sampler&& x) noexcept
 			:samplerHandle(x.samplerHandle)
+			,samplerId(x.samplerId)
 		{
 			x.samplerHandle = invalidHandle;
+			x.samplerId = 0;
 		}
 		Sampler& Sampler::operator=(Sampler&& x) noexcept
 		{
@@ -21,10 +46,13 @@ namespace GlProj
 			{
 				if (samplerHandle != invalidHandle)
 				{
+					ForgetUnitBindings(samplerHandle);
 					glDeleteSamplers(1, &samplerHandle);
 				}
 				samplerHandle = x.samplerHandle;
+				samplerId = x.samplerId;
 				x.samplerHandle = invalidHandle;
+				x.samplerId = 0;
 			}
 
 			return *this;
@@ -33,6 +61,7 @@ namespace GlProj
 		{
 			if (samplerHandle != invalidHandle)
 			{
+				ForgetUnitBindings(samplerHandle);
 				glDeleteSamplers(1, &samplerHandle);
 			}
 		}
@@ -40,11 +69,29 @@ namespace GlProj
 		{
 			return samplerHandle;
 		}
+		std::uint64_t Sampler::GetId() const noexcept
+		{
+			return samplerId;
+		}
 
 		void Sampler::Bind(GLuint unit) const noexcept
 		{
 			glBindSampler(unit, samplerHandle);
 		}
+		void Sampler::BindToUnit(GLuint unit) const noexcept
+		{
+			if (UpdateUnitBinding(unit, samplerHandle))
+			{
+				glBindSampler(unit, samplerHandle);
+			}
+		}
+		void UnbindSamplerUnit(GLuint unit) noexcept
+		{
+			if (UpdateUnitBinding(unit, 0))
+			{
+				glBindSampler(unit, 0);
+			}
+		}
 
 		template<>
 		void Sampler::GetParameter(GLenum name, GLint& value)
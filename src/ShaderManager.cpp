@@ -1,15 +1,21 @@
 #include "ShaderManager.hpp"
 #include "gl_core_4_5.h"
 #include "GLFW/glfw3.h"
+#include "AssetManager.hpp"
+#include "MappedFile.hpp"
 #include "Shader.hpp"
 #include "ShadingProgram.hpp"
 #include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <istream>
 #include <iterator>
 #include <stdexcept>
 #include <system_error>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 
@@ -99,54 +105,72 @@ namespace GlProj
 			}
 		};
 
-		ShaderManager* GetShaderManager()
-		{
-			static ShaderManager instance;
-			return &instance;
-		}
-		LocalSharedPtr<Shader> LoadShader(ShaderManager* manager, GLenum shaderType, const std::string& path, bool replace)
+		namespace
 		{
-			if(!replace)
+			std::string ReadShaderSource(const std::string& path)
 			{
-				auto ptr = FindCachedShaderByPath(manager, path);
-				if(ptr != nullptr)
+				auto shaderFile = std::ifstream(path);
+				auto errnum = errno;
+				if(!shaderFile.is_open())
 				{
-					return std::move(ptr);
+					std::string errMessage = "Shader file could not be opened.\n";
+					errMessage += "File: "; 
+					errMessage += path + '\n';
+					errMessage += "Error: ";
+					errMessage += std::error_code(errnum, std::system_category()).message();
+					errMessage += '\n';
+
+					throw std::runtime_error(errMessage);
 				}
+				shaderFile.exceptions(std::ios_base::badbit);
+				shaderFile.imbue(std::locale::classic());
+				shaderFile.unsetf(std::ios_base::skipws);
+
+				return std::string{ std::istream_iterator<char>(shaderFile),
+									std::istream_iterator<char>() };
 			}
 
-			auto shaderFile = std::ifstream(path);
-			auto errnum = errno;
-			if(!shaderFile.is_open())
+			//#version must stay the first directive, so the defines go after it.
+			std::string InsertDefines(std::string source, const std::vector<std::string>& defines)
 			{
-				std::string errMessage = "Shader file could not be opened.\n";
-				errMessage += "File: "; 
-				errMessage += path + '\n';
-				errMessage += "Error: ";
-				errMessage += std::error_code(errnum, std::system_category()).message();
-				errMessage += '\n';
+				if (defines.empty()) return source;
 
-				throw std::runtime_error(errMessage);
+				std::string block;
+				for (const auto& d : defines)
+				{
+					block += "#define " + d + '\n';
+				}
+				auto version = source.find("#version");
+				auto insertAt = version == std::string::npos ? 0 : source.find('\n', version);
+				if (insertAt == std::string::npos)
+				{
+					source += '\n';
+					insertAt = source.size();
+				}
+				else if (version != std::string::npos)
+				{
+					++insertAt;
+				}
+				source.insert(insertAt, block);
+				return source;
 			}
-			shaderFile.exceptions(std::ios_base::badbit);
-			shaderFile.imbue(std::locale::classic());
-			shaderFile.unsetf(std::ios_base::skipws);
 
-			std::string shaderSource{ std::istream_iterator<char>(shaderFile),
-										std::istream_iterator<char>() };
-
-			shaderFile.close();
-
-			auto shaderID = glCreateShader(shaderType);
-			auto source = shaderSource.data();
-			auto sourceSize = GLint(shaderSource.size());
-			glShaderSource(shaderID, 1, &source, &sourceSize);
-			glCompileShader(shaderID);
-
-			GLint compileStatus;
-			glGetShaderiv(shaderID, GL_COMPILE_STATUS, &compileStatus);
-			if (compileStatus != GL_TRUE)
+			GLuint IssueCompile(GLenum shaderType, const std::string& shaderSource)
 			{
+				auto shaderID = glCreateShader(shaderType);
+				auto source = shaderSource.data();
+				auto sourceSize = GLint(shaderSource.size());
+				glShaderSource(shaderID, 1, &source, &sourceSize);
+				glCompileShader(shaderID);
+				return shaderID;
+			}
+			//Empty if the shader compiled. Waits for the compile to finish.
+			std::string CompileError(GLuint shaderID, const std::string& path)
+			{
+				GLint compileStatus;
+				glGetShaderiv(shaderID, GL_COMPILE_STATUS, &compileStatus);
+				if (compileStatus == GL_TRUE) return{};
+
 				GLint logLength;
 				glGetShaderiv(shaderID, GL_INFO_LOG_LENGTH, &logLength);
 				auto log = std::make_unique<char[]>(logLength);
@@ -154,11 +178,183 @@ namespace GlProj
 				std::string err = "Shader Compile Error.\n";
 				err += "File: " + path + '\n';
 				err += log.get();
+				return err;
+			}
+			//Empty if the program linked. Waits for the link to finish.
+			std::string LinkError(GLuint handle)
+			{
+				GLint linkStatus;
+				glGetProgramiv(handle, GL_LINK_STATUS, &linkStatus);
+				if (linkStatus == GL_TRUE) return{};
 
-				glDeleteShader(shaderID);
-				throw std::runtime_error(err);
+				GLint logLength;
+				glGetProgramiv(handle, GL_INFO_LOG_LENGTH, &logLength);
+				auto logBuffer = std::make_unique<char[]>(logLength);
+				glGetProgramInfoLog(handle, logLength, nullptr, logBuffer.get());
+				std::string err = "Shader Program Linking Error.\n";
+				err += "Error: ";
+				err += logBuffer.get();
+				return err;
+			}
+			GLuint CompileShader(GLenum shaderType, const std::string& shaderSource, const std::string& path)
+			{
+				auto shaderID = IssueCompile(shaderType, shaderSource);
+				auto err = CompileError(shaderID, path);
+				if (!err.empty())
+				{
+					glDeleteShader(shaderID);
+					throw std::runtime_error(err);
+				}
+				return shaderID;
+			}
+
+			//GL_KHR_parallel_shader_compile, or the ARB extension it came
+			//from; both share these values. Not in the generated loader.
+			static const constexpr GLenum GL_MAX_SHADER_COMPILER_THREADS = 0x91B0;
+			static const constexpr GLenum GL_COMPLETION_STATUS = 0x91B1;
+
+			bool ParallelCompileSupported()
+			{
+				static const bool supported = []()
+				{
+					using MaxThreadsProc = void (APIENTRY*)(GLuint);
+					auto maxThreads = reinterpret_cast<MaxThreadsProc>(glfwExtensionSupported("GL_KHR_parallel_shader_compile")
+						? glfwGetProcAddress("glMaxShaderCompilerThreadsKHR")
+						: glfwExtensionSupported("GL_ARB_parallel_shader_compile")
+							? glfwGetProcAddress("glMaxShaderCompilerThreadsARB")
+							: nullptr);
+					if (maxThreads == nullptr) return false;
+					//Lets the driver pick how many threads to use.
+					maxThreads(0xFFFFFFFF);
+					return true;
+				}();
+				return supported;
+			}
+			bool ShaderIsComplete(GLuint shader)
+			{
+				GLint complete;
+				glGetShaderiv(shader, GL_COMPLETION_STATUS, &complete);
+				return complete == GL_TRUE;
+			}
+			bool ProgramIsComplete(GLuint handle)
+			{
+				GLint complete;
+				glGetProgramiv(handle, GL_COMPLETION_STATUS, &complete);
+				return complete == GL_TRUE;
+			}
+
+			//A binary is only valid for the driver that produced it.
+			std::uint64_t HashDriver()
+			{
+				auto hash = FnvOffsetBasis;
+				for (auto name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+				{
+					auto value = reinterpret_cast<const char*>(glGetString(name));
+					if (value != nullptr)
+					{
+						hash = HashBytes(value, std::strlen(value) + 1, hash);
+					}
+				}
+				return hash;
+			}
+
+			static const constexpr std::uint32_t ProgramBinaryMagic = 0x42505047; //"GPPB"
+			static const constexpr std::uint32_t ProgramBinaryVersion = 1;
+
+			struct ProgramBinaryHeader
+			{
+				std::uint32_t magic;
+				std::uint32_t version;
+				std::uint64_t key;
+				std::uint32_t format;
+				std::uint32_t length;
+			};
+
+			//False if there is no usable binary file. The driver may still
+			//reject the binary, e.g. after an update that kept the version
+			//string, which shows as a failed link.
+			bool IssueProgramBinary(GLuint handle, const std::string& path, std::uint64_t key)
+			{
+				FileStamp stamp;
+				if (!GetFileStamp(path, stamp)) return false;
+
+				MappedFile file;
+				try
+				{
+					file = MappedFile(path);
+				}
+				catch (const std::runtime_error&)
+				{
+					return false;
+				}
+
+				ProgramBinaryHeader header;
+				if (file.Size() < sizeof(header)) return false;
+				std::memcpy(&header, file.Data(), sizeof(header));
+				if (header.magic != ProgramBinaryMagic
+					|| header.version != ProgramBinaryVersion
+					|| header.key != key
+					|| header.length > file.Size() - sizeof(header))
+				{
+					return false;
+				}
+
+				glProgramBinary(handle, GLenum(header.format), file.Data() + sizeof(header), GLsizei(header.length));
+				return true;
+			}
+
+			//Failing to save only costs the next run a compile.
+			void SaveProgramBinary(GLuint handle, const std::string& path, std::uint64_t key)
+			{
+				GLint length = 0;
+				glGetProgramiv(handle, GL_PROGRAM_BINARY_LENGTH, &length);
+				if (length <= 0) return;
+
+				std::vector<char> binary(sizeof(ProgramBinaryHeader) + std::size_t(length));
+				GLenum format;
+				glGetProgramBinary(handle, length, &length, &format, binary.data() + sizeof(ProgramBinaryHeader));
+
+				ProgramBinaryHeader header{ ProgramBinaryMagic, ProgramBinaryVersion, key, format, std::uint32_t(length) };
+				std::memcpy(binary.data(), &header, sizeof(header));
+
+				auto tempPath = path + ".tmp";
+				{
+					std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+					file.write(binary.data(), std::streamsize(sizeof(header) + std::size_t(length)));
+					if (!file)
+					{
+						file.close();
+						std::remove(tempPath.c_str());
+						return;
+					}
+				}
+				std::remove(path.c_str());
+				if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+				{
+					std::remove(tempPath.c_str());
+				}
+			}
+		}
+
+		ShaderManager* GetShaderManager()
+		{
+			static ShaderManager instance;
+			return &instance;
+		}
+		LocalSharedPtr<Shader> LoadShader(ShaderManager* manager, GLenum shaderType, const std::string& path, bool replace)
+		{
+			if(!replace)
+			{
+				auto ptr = FindCachedShaderByPath(manager, path);
+				if(ptr != nullptr)
+				{
+					return std::move(ptr);
+				}
 			}
 
+			auto shaderSource = ReadShaderSource(path);
+			auto shaderID = CompileShader(shaderType, shaderSource, path);
+
 			return manager->RegisterShader(shaderType, shaderID, NormalisePath(path));
 		}
 		LocalSharedPtr<Shader> RegisterShader(ShaderManager* manager, GLenum type, GLuint handle, const std::string& name, bool replace)
@@ -190,6 +386,205 @@ namespace GlProj
 			manager->CleanUpDangling();
 		}
 		
+		ProgramBatch::~ProgramBatch()
+		{
+			for (auto& e : entries)
+			{
+				DeleteShaders(e);
+			}
+		}
+		std::size_t ProgramBatch::Add(std::initializer_list<ShaderStage> stages, const std::vector<std::string>& defines)
+		{
+			if (submitted)
+			{
+				throw std::logic_error("Programs cannot be added to a batch once it is submitted.");
+			}
+
+			Entry e;
+			e.stages.assign(stages.begin(), stages.end());
+			e.key = HashDriver();
+			for (const auto& d : defines)
+			{
+				e.key = HashString(d, e.key);
+			}
+			for (const auto& stage : stages)
+			{
+				e.sources.push_back(InsertDefines(ReadShaderSource(stage.path), defines));
+				e.key = HashBytes(&stage.type, sizeof(stage.type), e.key);
+				e.key = HashString(e.sources.back(), e.key);
+			}
+			entries.push_back(std::move(e));
+			return entries.size() - 1;
+		}
+		void ProgramBatch::Submit()
+		{
+			if (submitted) return;
+			submitted = true;
+			parallel = ParallelCompileSupported();
+
+			GLint binaryFormats = 0;
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+			if (binaryFormats > 0)
+			{
+				assets = GetAssetManager();
+			}
+
+			for (auto& e : entries)
+			{
+				e.program = GenerateProgram();
+				if (assets != nullptr && IssueProgramBinary(e.program->GetHandle(), GetArtifactPath(assets, e.key, ".glbin"), e.key))
+				{
+					e.state = State::Restoring;
+					e.issuedAt = polls;
+				}
+				else
+				{
+					StartCompile(e);
+				}
+			}
+			remaining = entries.size();
+			++polls;
+		}
+		bool ProgramBatch::Poll()
+		{
+			if (!submitted)
+			{
+				throw std::logic_error("Program batch polled before being submitted.");
+			}
+			if (remaining == 0) return true;
+
+			//Without the extension, any status query waits for its result.
+			//Only querying work issued by an earlier Poll gives the driver
+			//the whole of the previous stage to pipeline first.
+			auto ready = [this](const Entry& e)
+			{
+				return parallel || e.issuedAt < polls;
+			};
+
+			for (auto& e : entries)
+			{
+				if (e.state != State::Restoring && e.state != State::Linking) continue;
+				auto handle = e.program->GetHandle();
+				if (!ready(e) || (parallel && !ProgramIsComplete(handle))) continue;
+
+				auto err = LinkError(handle);
+				if (err.empty())
+				{
+					for (auto s : e.shaders)
+					{
+						glDetachShader(handle, s);
+					}
+					DeleteShaders(e);
+					e.program->FetchProgramInfo();
+					if (e.state == State::Linking && assets != nullptr)
+					{
+						SaveProgramBinary(handle, GetArtifactPath(assets, e.key, ".glbin"), e.key);
+					}
+					e.state = State::Done;
+					--remaining;
+				}
+				else if (e.state == State::Restoring)
+				{
+					StartCompile(e);
+				}
+				else
+				{
+					Fail(e, std::move(err));
+				}
+			}
+
+			for (auto& e : entries)
+			{
+				if (e.state != State::Compiling || !ready(e)) continue;
+				if (parallel && !std::all_of(e.shaders.begin(), e.shaders.end(), ShaderIsComplete)) continue;
+
+				std::string err;
+				for (std::size_t i = 0; i < e.shaders.size() && err.empty(); ++i)
+				{
+					err = CompileError(e.shaders[i], e.stages[i].path);
+				}
+				if (!err.empty())
+				{
+					Fail(e, std::move(err));
+					continue;
+				}
+
+				auto handle = e.program->GetHandle();
+				for (auto s : e.shaders)
+				{
+					glAttachShader(handle, s);
+				}
+				if (assets != nullptr)
+				{
+					glProgramParameteri(handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+				}
+				glLinkProgram(handle);
+				e.state = State::Linking;
+				e.issuedAt = polls;
+			}
+
+			++polls;
+			return remaining == 0;
+		}
+		void ProgramBatch::Wait()
+		{
+			Submit();
+			while (!Poll())
+			{
+				if (parallel) std::this_thread::yield();
+			}
+		}
+		bool ProgramBatch::IsDone(std::size_t i) const
+		{
+			return entries.at(i).state == State::Done || entries[i].state == State::Failed;
+		}
+		LocalSharedPtr<ShadingProgram> ProgramBatch::Get(std::size_t i) const
+		{
+			const auto& e = entries.at(i);
+			if (e.state == State::Failed)
+			{
+				throw std::runtime_error(e.error);
+			}
+			if (e.state != State::Done)
+			{
+				throw std::logic_error("Program is not finished building.");
+			}
+			return e.program;
+		}
+		void ProgramBatch::StartCompile(Entry& e)
+		{
+			for (std::size_t i = 0; i < e.stages.size(); ++i)
+			{
+				e.shaders.push_back(IssueCompile(e.stages[i].type, e.sources[i]));
+			}
+			e.state = State::Compiling;
+			e.issuedAt = polls;
+		}
+		void ProgramBatch::Fail(Entry& e, std::string err)
+		{
+			DeleteShaders(e);
+			e.program = nullptr;
+			e.error = std::move(err);
+			e.state = State::Failed;
+			--remaining;
+		}
+		void ProgramBatch::DeleteShaders(Entry& e)
+		{
+			for (auto s : e.shaders)
+			{
+				glDeleteShader(s);
+			}
+			e.shaders.clear();
+		}
+
+		LocalSharedPtr<ShadingProgram> LoadProgram(ShaderManager*, std::initializer_list<ShaderStage> stages,
+			const std::vector<std::string>& defines)
+		{
+			ProgramBatch batch;
+			auto i = batch.Add(stages, defines);
+			batch.Wait();
+			return batch.Get(i);
+		}
 		LocalSharedPtr<ShadingProgram> GenerateProgram()
 		{
 			return make_localshared<ShadingProgram>(glCreateProgram());
@@ -207,17 +602,9 @@ namespace GlProj
 			auto handle = program->GetHandle();
 			glLinkProgram(handle);
 
-			GLint linkStatus;
-			glGetProgramiv(handle, GL_LINK_STATUS, &linkStatus);
-			if (linkStatus != GL_TRUE)
+			auto err = LinkError(handle);
+			if (!err.empty())
 			{
-				GLint logLength;
-				glGetProgramiv(handle, GL_INFO_LOG_LENGTH, &logLength);
-				auto logBuffer = std::make_unique<char[]>(logLength);
-				glGetProgramInfoLog(handle, logLength, nullptr, logBuffer.get());
-				std::string err = "Shader Program Linking Error.\n";
-				err += "Error: ";
-				err += logBuffer.get();
 				throw std::runtime_error(err);
 			}
 
@@ -27,6 +27,47 @@ namespace GlProj
 			}
 		};
 
+		static const std::string reservedUniformNames[] =
+		{
+			"m_transform",
+			"v_transform",
+			"p_transform",
+			"mv_transform",
+			"vp_transform",
+			"mvp_transform",
+			"im_transform",
+			"iv_transform",
+			"ip_transform",
+			"imv_transform",
+			"ivp_transform",
+			"imvp_transform",
+		};
+		static_assert(sizeof(reservedUniformNames) / sizeof(*reservedUniformNames) == std::size_t(ReservedUniform::Count),
+			"Every reserved uniform requires a name.");
+
+		const std::string& ReservedUniformName(ReservedUniform u)
+		{
+			return reservedUniformNames[int(u)];
+		}
+
+		static const std::string cameraBlockName = "camera_block";
+		static const std::string transformBlockName = "transform_block";
+		static const std::string materialBlockName = "material_block";
+
+		const std::string& ReservedBlockName(ReservedBlock b)
+		{
+			switch (b)
+			{
+			default:
+			case ReservedBlock::Camera:
+				return cameraBlockName;
+			case ReservedBlock::Transforms:
+				return transformBlockName;
+			case ReservedBlock::Material:
+				return materialBlockName;
+			}
+		}
+
 		bool operator==(const ShadingProgram& x, const ShadingProgram& y) noexcept
 		{
 			return x.programHandle == y.programHandle;
@@ -36,10 +77,16 @@ namespace GlProj
 			return !(x == y);
 		}
 		ShadingProgram::ShadingProgram(ShadingProgram&& x) noexcept
-			: programHandle(x.programHandle)
-			, attributes(std::move(x.attributes))
+			: attributes(std::move(x.attributes))
 			, uniforms(std::move(x.uniforms))
+			, uniformNameRef(std::move(x.uniformNameRef))
+			, reservedUniforms(x.reservedUniforms)
+			, reservedUniformMask(x.reservedUniformMask)
+			, programHandle(x.programHandle)
 			, transformsAreBatchable(x.transformsAreBatchable)
+			, usesCameraBlock(x.usesCameraBlock)
+			, usesTransformBlock(x.usesTransformBlock)
+			, usesMaterialBlock(x.usesMaterialBlock)
 		{
 			x.programHandle = invalidHandle;
 		}
@@ -54,7 +101,13 @@ namespace GlProj
 				programHandle = x.programHandle;
 				attributes = std::move(x.attributes);
 				uniforms = std::move(x.uniforms);
+				uniformNameRef = std::move(x.uniformNameRef);
+				reservedUniforms = x.reservedUniforms;
+				reservedUniformMask = x.reservedUniformMask;
 				transformsAreBatchable = x.transformsAreBatchable;
+				usesCameraBlock = x.usesCameraBlock;
+				usesTransformBlock = x.usesTransformBlock;
+				usesMaterialBlock = x.usesMaterialBlock;
 				x.programHandle = invalidHandle;
 			}
 
@@ -74,6 +127,22 @@ namespace GlProj
 		{
 			return programHandle;
 		}
+		bool ShadingProgram::TransformsAreBatchable() const noexcept
+		{
+			return transformsAreBatchable;
+		}
+		bool ShadingProgram::UsesCameraBlock() const noexcept
+		{
+			return usesCameraBlock;
+		}
+		bool ShadingProgram::UsesTransformBlock() const noexcept
+		{
+			return usesTransformBlock;
+		}
+		bool ShadingProgram::UsesMaterialBlock() const noexcept
+		{
+			return usesMaterialBlock;
+		}
 		ShadingProgram::VertexAttribConstIterator ShadingProgram::FindAttribute(const std::string& name) const
 		{
 			return std::find_if(attributes.cbegin(), attributes.cend(), [&name](const auto& x)
@@ -110,6 +179,15 @@ namespace GlProj
 			});
 		}
 
+		ReservedUniformMask ShadingProgram::GetReservedUniformMask() const noexcept
+		{
+			return reservedUniformMask;
+		}
+		const UniformInformation& ShadingProgram::GetReservedUniform(ReservedUniform u) const noexcept
+		{
+			return uniforms[reservedUniforms[int(u)]];
+		}
+
 		ShadingProgram::VertexAttribConstIterator ShadingProgram::AttributesEnd() const
 		{
 			return attributes.cend();
@@ -153,6 +231,12 @@ namespace GlProj
 				attributes.push_back({ attribNameBuf, GLenum(attribInfo[1]), attribInfo[2], attribInfo[3] });
 			}
 
+			//Programs that source their model matrix from a per-instance
+			//attribute can be drawn with one call per mesh.
+			auto instanceTransform = FindAttribute(InstanceTransformSlot);
+			transformsAreBatchable = instanceTransform != attributes.cend()
+				&& instanceTransform->type == GL_FLOAT_MAT4;
+
 			auto numActiveUniforms = GLint();
 			glGetProgramInterfaceiv(GetHandle(), GL_UNIFORM, GL_ACTIVE_RESOURCES, &numActiveUniforms);
 			auto maxUniformNameLen = GLint();
@@ -183,6 +267,49 @@ namespace GlProj
 				return{ x.name, &x };
 			});
 			std::sort(uniformNameRef.begin(), uniformNameRef.end(), UniformNameLess{});
+
+			reservedUniformMask = 0;
+			for (int i = 0; i < int(ReservedUniform::Count); ++i)
+			{
+				auto u = ReservedUniform(i);
+				auto found = FindUniform(ReservedUniformName(u));
+				//Block members report no location and cannot be set directly.
+				if (found == uniforms.cend() || found->location == -1)
+				{
+					reservedUniforms[i] = -1;
+					continue;
+				}
+				reservedUniforms[i] = int(found - uniforms.cbegin());
+				reservedUniformMask |= ReservedUniformBit(u);
+			}
+
+			//Camera matrices are shared by every program through one buffer,
+			//so the block is pinned to its reserved binding point.
+			auto cameraBlock = glGetProgramResourceIndex(GetHandle(), GL_UNIFORM_BLOCK,
+				ReservedBlockName(ReservedBlock::Camera).c_str());
+			usesCameraBlock = cameraBlock != GL_INVALID_INDEX;
+			if (usesCameraBlock)
+			{
+				glUniformBlockBinding(GetHandle(), cameraBlock, GLuint(ReservedBlock::Camera));
+			}
+
+			//Model matrices for indirect draws, indexed by draw and instance.
+			auto transformBlock = glGetProgramResourceIndex(GetHandle(), GL_SHADER_STORAGE_BLOCK,
+				ReservedBlockName(ReservedBlock::Transforms).c_str());
+			usesTransformBlock = transformBlock != GL_INVALID_INDEX;
+			if (usesTransformBlock)
+			{
+				glShaderStorageBlockBinding(GetHandle(), transformBlock, GLuint(ReservedBlock::Transforms));
+			}
+
+			//Bindless texture handles, written by each material; see Material.hpp.
+			auto materialBlock = glGetProgramResourceIndex(GetHandle(), GL_UNIFORM_BLOCK,
+				ReservedBlockName(ReservedBlock::Material).c_str());
+			usesMaterialBlock = materialBlock != GL_INVALID_INDEX;
+			if (usesMaterialBlock)
+			{
+				glUniformBlockBinding(GetHandle(), materialBlock, GLuint(ReservedBlock::Material));
+			}
 		}
 	}
 }
@@ -0,0 +1,198 @@
+#include "StreamingBuffer.hpp"
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		static const constexpr GLsizeiptr RegionAlignment = 256;
+		static const constexpr GLuint64 FenceTimeout = 1000000000ull;
+
+		StreamingBuffer::StreamingBuffer(BufferType bufferType, GLsizeiptr size, int regionCount)
+			: regionFences(regionCount > 0 ? regionCount : 0, nullptr)
+			, bufferType(GLenum(bufferType))
+			, regionSize((size + RegionAlignment - 1) / RegionAlignment * RegionAlignment)
+		{
+			if (regionCount < 1)
+			{
+				throw std::logic_error("Streaming buffer requires at least one region.");
+			}
+
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			const auto totalSize = regionSize * regionCount;
+
+			glGenBuffers(1, &bufferHandle);
+			glBindBuffer(this->bufferType, bufferHandle);
+			glBufferStorage(this->bufferType, totalSize, nullptr, flags);
+
+			mappedData = static_cast<unsigned char*>(glMapBufferRange(this->bufferType, 0, totalSize, flags));
+			if (mappedData == nullptr)
+			{
+				glDeleteBuffers(1, &bufferHandle);
+				bufferHandle = invalidHandle;
+				throw std::runtime_error("Streaming buffer could not be persistently mapped.");
+			}
+		}
+		StreamingBuffer::StreamingBuffer(StreamingBuffer&& x) noexcept
+			: regionFences(std::move(x.regionFences))
+			, mappedData(x.mappedData)
+			, bufferHandle(x.bufferHandle)
+			, bufferType(x.bufferType)
+			, regionSize(x.regionSize)
+			, regionHead(x.regionHead)
+			, currentRegion(x.currentRegion)
+		{
+			x.mappedData = nullptr;
+			x.bufferHandle = invalidHandle;
+		}
+		StreamingBuffer& StreamingBuffer::operator=(StreamingBuffer&& x) noexcept
+		{
+			if (this != &x)
+			{
+				for (auto& f : regionFences)
+				{
+					if (f != nullptr) glDeleteSync(f);
+				}
+				if (bufferHandle != invalidHandle)
+				{
+					glDeleteBuffers(1, &bufferHandle);
+				}
+				regionFences = std::move(x.regionFences);
+				mappedData = x.mappedData;
+				bufferHandle = x.bufferHandle;
+				bufferType = x.bufferType;
+				regionSize = x.regionSize;
+				regionHead = x.regionHead;
+				currentRegion = x.currentRegion;
+
+				x.mappedData = nullptr;
+				x.bufferHandle = invalidHandle;
+			}
+
+			return *this;
+		}
+		StreamingBuffer::~StreamingBuffer()
+		{
+			for (auto& f : regionFences)
+			{
+				if (f != nullptr) glDeleteSync(f);
+			}
+			//Deleting the buffer implicitly unmaps it.
+			if (bufferHandle != invalidHandle)
+			{
+				glDeleteBuffers(1, &bufferHandle);
+			}
+		}
+		GLuint StreamingBuffer::GetHandle() const noexcept
+		{
+			return bufferHandle;
+		}
+		BufferType StreamingBuffer::GetBufferType() const noexcept
+		{
+			return BufferType(bufferType);
+		}
+		GLsizeiptr StreamingBuffer::GetRegionSize() const noexcept
+		{
+			return regionSize;
+		}
+		int StreamingBuffer::GetRegionCount() const noexcept
+		{
+			return int(regionFences.size());
+		}
+		void StreamingBuffer::WaitForRegion(int region)
+		{
+			auto& fence = regionFences[region];
+			if (fence == nullptr) return;
+
+			GLbitfield waitFlags = 0;
+			while (true)
+			{
+				auto result = glClientWaitSync(fence, waitFlags, FenceTimeout);
+				if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+				{
+					break;
+				}
+				if (result == GL_WAIT_FAILED)
+				{
+					throw std::runtime_error("Waiting on a streaming buffer fence failed.");
+				}
+				//Ensure the fence itself has been submitted before waiting again.
+				waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+			}
+
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+		void StreamingBuffer::BeginFrame()
+		{
+			//Default-constructed buffers have no regions to cycle through.
+			if (regionFences.empty()) return;
+			WaitForRegion(currentRegion);
+			regionHead = 0;
+		}
+		void StreamingBuffer::EndFrame()
+		{
+			if (regionFences.empty()) return;
+			auto& fence = regionFences[currentRegion];
+			if (fence != nullptr)
+			{
+				glDeleteSync(fence);
+			}
+			fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+			currentRegion = (currentRegion + 1) % GetRegionCount();
+			regionHead = 0;
+		}
+		StreamingAllocation StreamingBuffer::Allocate(GLsizeiptr size, GLsizeiptr alignment)
+		{
+			if (regionFences.empty())
+			{
+				throw std::logic_error("Allocation from a default-constructed streaming buffer.");
+			}
+			if (size > regionSize)
+			{
+				std::string err = "Streaming allocation exceeds region size.\nRequested: ";
+				err += std::to_string(size);
+				err += "\nRegion size: ";
+				err += std::to_string(regionSize);
+				throw std::length_error(err);
+			}
+
+			//Regions begin on a RegionAlignment boundary, so aligning the
+			//head also aligns the absolute offset for any smaller power of two.
+			auto start = (regionHead + alignment - 1) / alignment * alignment;
+			if (start + size > regionSize)
+			{
+				EndFrame();
+				BeginFrame();
+				start = 0;
+			}
+			regionHead = start + size;
+
+			auto offset = GLintptr(regionSize * currentRegion + start);
+			return{ mappedData + offset, offset, size };
+		}
+		void StreamingBuffer::Bind() const noexcept
+		{
+			glBindBuffer(bufferType, GetHandle());
+		}
+		void StreamingBuffer::BindRange(GLuint index, const StreamingAllocation& a) const noexcept
+		{
+			BindRange(index, a.offset, a.size);
+		}
+		void StreamingBuffer::BindRange(GLuint index, GLintptr offset, GLsizeiptr size) const noexcept
+		{
+			glBindBufferRange(bufferType, index, GetHandle(), offset, size);
+		}
+		bool operator==(const StreamingBuffer& x, const StreamingBuffer& y) noexcept
+		{
+			return x.bufferHandle == y.bufferHandle;
+		}
+		bool operator!=(const StreamingBuffer& x, const StreamingBuffer& y) noexcept
+		{
+			return !(x == y);
+		}
+	}
+}
@@ -1,14 +1,124 @@
 #include "Texture.hpp"
 #include "gl_core_4_5.h"
 #include "GLFW/glfw3.h"
+#include "CompressedImage.hpp"
+#include "GpuUploader.hpp"
+#include "Sampler.hpp"
+#include <algorithm>
+#include <cassert>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 namespace GlProj
 {
 	namespace Graphics
 	{
+		//Bind order, for finding the least recently used textures. Textures
+		//are only bound on the main thread.
+		static std::uint64_t bindClock = 0;
+		//What BindToUnit last left on each unit; 0 for nothing.
+		static std::vector<GLuint> unitBindings;
+
+		static bool UpdateUnitBinding(GLuint unit, GLuint handle)
+		{
+			//Unit 0 also takes plain glBindTexture calls, so what it holds
+			//is never known.
+			if (unit == 0) return true;
+			if (unit >= unitBindings.size())
+			{
+				unitBindings.resize(unit + 1, 0);
+			}
+			if (unitBindings[unit] == handle) return false;
+			unitBindings[unit] = handle;
+			return true;
+		}
+
+		namespace
+		{
+			//GL_ARB_bindless_texture entry points; not in the generated loader.
+			struct BindlessProcs
+			{
+				using GetTextureHandleProc = GLuint64 (APIENTRY*)(GLuint);
+				using GetTextureSamplerHandleProc = GLuint64 (APIENTRY*)(GLuint, GLuint);
+				using HandleResidencyProc = void (APIENTRY*)(GLuint64);
+
+				GetTextureHandleProc getTextureHandle = nullptr;
+				GetTextureSamplerHandleProc getTextureSamplerHandle = nullptr;
+				HandleResidencyProc makeResident = nullptr;
+				HandleResidencyProc makeNonResident = nullptr;
+			};
+
+			const BindlessProcs& Bindless()
+			{
+				static const BindlessProcs procs = []()
+				{
+					BindlessProcs p;
+					if (!glfwExtensionSupported("GL_ARB_bindless_texture")) return p;
+
+					p.getTextureHandle = reinterpret_cast<BindlessProcs::GetTextureHandleProc>(
+						glfwGetProcAddress("glGetTextureHandleARB"));
+					p.getTextureSamplerHandle = reinterpret_cast<BindlessProcs::GetTextureSamplerHandleProc>(
+						glfwGetProcAddress("glGetTextureSamplerHandleARB"));
+					p.makeResident = reinterpret_cast<BindlessProcs::HandleResidencyProc>(
+						glfwGetProcAddress("glMakeTextureHandleResidentARB"));
+					p.makeNonResident = reinterpret_cast<BindlessProcs::HandleResidencyProc>(
+						glfwGetProcAddress("glMakeTextureHandleNonResidentARB"));
+					if (p.getTextureHandle == nullptr || p.getTextureSamplerHandle == nullptr
+						|| p.makeResident == nullptr || p.makeNonResident == nullptr)
+					{
+						return BindlessProcs{};
+					}
+					return p;
+				}();
+				return procs;
+			}
+		}
+
+		bool BindlessTexturesSupported()
+		{
+			return Bindless().getTextureHandle != nullptr;
+		}
+
+		GLsizei FullMipCount(GLsizei width, GLsizei height) noexcept
+		{
+			GLsizei levels = 1;
+			for (auto size = std::max(width, height); size > 1; size /= 2)
+			{
+				++levels;
+			}
+			return levels;
+		}
+		std::size_t TextureLevelSize(GLenum internalFormat, GLsizei width, GLsizei height) noexcept
+		{
+			if (BlockSize(internalFormat) != 0)
+			{
+				return CompressedLevelSize(internalFormat, width, height);
+			}
+
+			std::size_t texelSize;
+			switch (internalFormat)
+			{
+			case GL_R8:
+				texelSize = 1;
+				break;
+			case GL_RG8:
+				texelSize = 2;
+				break;
+			default:
+				texelSize = 4;
+				break;
+			}
+			return texelSize * std::size_t(width) * std::size_t(height);
+		}
+
 		Texture::Texture(Texture&& o) noexcept
 			: textureHandle(o.textureHandle)
 			, textureType(o.textureType)
+			, upload(std::move(o.upload))
+			, storage(o.storage)
+			, lastBound(o.lastBound)
+			, residentHandles(std::move(o.residentHandles))
 		{
 			o.textureHandle = invalidHandle;
 		}
@@ -16,20 +126,39 @@ namespace GlProj
 		{
 			if (&o != this)
 			{
-				if (textureHandle != invalidHandle)
-				{
-					glDeleteTextures(1, &textureHandle);
-				}
+				Release();
 				textureHandle = o.textureHandle;
 				textureType = o.textureType;
+				upload = std::move(o.upload);
+				storage = o.storage;
+				lastBound = o.lastBound;
+				residentHandles = std::move(o.residentHandles);
 				o.textureHandle = invalidHandle;
 			}
 			return *this;
 		}
 		Texture::~Texture()
 		{
+			Release();
+		}
+		void Texture::Release() noexcept
+		{
+			//Deleting the name mid-upload would let the upload thread
+			//recreate it behind our back.
+			if (upload != nullptr)
+			{
+				upload->Wait();
+				upload = nullptr;
+			}
+			for (const auto& resident : residentHandles)
+			{
+				Bindless().makeNonResident(resident.second);
+			}
+			residentHandles.clear();
 			if (textureHandle != invalidHandle)
 			{
+				//Deletion unbinds the name everywhere, and it may be reused.
+				std::replace(unitBindings.begin(), unitBindings.end(), textureHandle, GLuint(0));
 				glDeleteTextures(1, &textureHandle);
 			}
 		}
@@ -38,6 +167,19 @@ namespace GlProj
 			, textureType(type)
 		{
 		}
+		Texture::Texture(GLenum type, GLuint handle, const TextureStorage& s, std::shared_ptr<UploadFence> pending) noexcept
+			: textureHandle(handle)
+			, textureType(type)
+			, upload(std::move(pending))
+			, storage(s)
+		{
+		}
+		void Texture::ReplaceStorage(GLuint handle, const TextureStorage& s) noexcept
+		{
+			Release();
+			textureHandle = handle;
+			storage = s;
+		}
 		GLuint Texture::GetHandle() const noexcept
 		{
 			return textureHandle;
@@ -46,9 +188,91 @@ namespace GlProj
 		{
 			return textureType;
 		}
+		bool Texture::IsReady() const
+		{
+			return GetUploadState() == UploadState::Complete;
+		}
+		UploadState Texture::GetUploadState() const
+		{
+			return upload == nullptr ? UploadState::Complete : upload->GetState();
+		}
+		std::string Texture::GetUploadError() const
+		{
+			return GetUploadState() == UploadState::Failed ? upload->GetError() : std::string();
+		}
+		const TextureStorage& Texture::GetStorage() const noexcept
+		{
+			return storage;
+		}
+		std::size_t Texture::SizeInBytes() const noexcept
+		{
+			std::size_t size = 0;
+			auto width = storage.width, height = storage.height;
+			for (GLsizei level = 0; level < storage.levels; ++level)
+			{
+				size += TextureLevelSize(storage.internalFormat, width, height) * std::size_t(storage.layers);
+				width = std::max(width / 2, 1);
+				height = std::max(height / 2, 1);
+			}
+			return size;
+		}
+		std::uint64_t Texture::LastBound() const noexcept
+		{
+			return lastBound;
+		}
 		void Texture::Bind() const noexcept
 		{
+#ifndef NDEBUG
+			GLint activeUnit;
+			glGetIntegerv(GL_ACTIVE_TEXTURE, &activeUnit);
+			assert(activeUnit == GL_TEXTURE0);
+#endif
 			glBindTexture(textureType, textureHandle);
+			lastBound = ++bindClock;
+		}
+		void Texture::BindToUnit(GLuint unit) const noexcept
+		{
+			if (UpdateUnitBinding(unit, textureHandle))
+			{
+				glBindTextureUnit(unit, textureHandle);
+			}
+			lastBound = ++bindClock;
+		}
+		GLuint64 Texture::GetBindlessHandle(const Sampler* sampler) const
+		{
+			//Sampling through a handle counts as a bind for the budget.
+			lastBound = ++bindClock;
+			auto samplerId = sampler == nullptr ? std::uint64_t(0) : sampler->GetId();
+			for (const auto& resident : residentHandles)
+			{
+				if (resident.first == samplerId) return resident.second;
+			}
+
+			const auto& procs = Bindless();
+			auto handle = sampler == nullptr ? procs.getTextureHandle(textureHandle)
+				: procs.getTextureSamplerHandle(textureHandle, sampler->GetHandle());
+			procs.makeResident(handle);
+			residentHandles.emplace_back(samplerId, handle);
+			return handle;
+		}
+		void UnbindTextureUnit(GLuint unit) noexcept
+		{
+			if (UpdateUnitBinding(unit, 0))
+			{
+				glBindTextureUnit(unit, 0);
+			}
+		}
+		bool operator==(const TextureRegion& x, const TextureRegion& y) noexcept
+		{
+			return x.u == y.u && x.v == y.v && x.width == y.width && x.height == y.height && x.layer == y.layer;
+		}
+		bool operator!=(const TextureRegion& x, const TextureRegion& y) noexcept
+		{
+			return !(x == y);
+		}
+		bool operator<(const TextureRegion& x, const TextureRegion& y) noexcept
+		{
+			return std::tie(x.layer, x.u, x.v, x.width, x.height) < std::tie(y.layer, y.u, y.v, y.width, y.height);
 		}
 		bool operator==(const Texture& x, const Texture& y) noexcept
 		{
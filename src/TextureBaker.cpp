@@ -0,0 +1,153 @@
+#include "TextureBaker.hpp"
+#include "stb_image.h"
+#define STB_DXT_IMPLEMENTATION
+#include "stb_dxt.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		namespace
+		{
+			struct Level
+			{
+				int width;
+				int height;
+				std::vector<unsigned char> pixels;
+			};
+
+			//Averages each 2x2 footprint; an odd edge reuses its last texel.
+			Level Downsample(const Level& src)
+			{
+				Level dst{ std::max(src.width / 2, 1), std::max(src.height / 2, 1), {} };
+				dst.pixels.resize(std::size_t(dst.width) * dst.height * 4);
+				for (int y = 0; y < dst.height; ++y)
+				{
+					auto y0 = std::min(y * 2, src.height - 1), y1 = std::min(y * 2 + 1, src.height - 1);
+					for (int x = 0; x < dst.width; ++x)
+					{
+						auto x0 = std::min(x * 2, src.width - 1), x1 = std::min(x * 2 + 1, src.width - 1);
+						for (int c = 0; c < 4; ++c)
+						{
+							auto texel = [&src, c](int tx, int ty)
+							{
+								return unsigned(src.pixels[(std::size_t(ty) * src.width + tx) * 4 + c]);
+							};
+							auto sum = texel(x0, y0) + texel(x1, y0) + texel(x0, y1) + texel(x1, y1);
+							dst.pixels[(std::size_t(y) * dst.width + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+						}
+					}
+				}
+				return dst;
+			}
+
+			void CompressLevel(const Level& level, bool alpha, int mode, std::vector<unsigned char>& out)
+			{
+				auto blockBytes = alpha ? 16 : 8;
+				unsigned char block[16 * 4];
+				unsigned char compressed[16];
+				for (int by = 0; by < level.height; by += 4)
+				{
+					for (int bx = 0; bx < level.width; bx += 4)
+					{
+						//Blocks hanging off the edge repeat the edge texels.
+						for (int y = 0; y < 4; ++y)
+						{
+							auto sy = std::min(by + y, level.height - 1);
+							for (int x = 0; x < 4; ++x)
+							{
+								auto sx = std::min(bx + x, level.width - 1);
+								std::copy_n(&level.pixels[(std::size_t(sy) * level.width + sx) * 4], 4, &block[(y * 4 + x) * 4]);
+							}
+						}
+						stb_compress_dxt_block(compressed, block, alpha ? 1 : 0, mode);
+						out.insert(out.end(), compressed, compressed + blockBytes);
+					}
+				}
+			}
+
+			void Write32(std::vector<unsigned char>& out, std::uint32_t value)
+			{
+				for (int i = 0; i < 4; ++i)
+				{
+					out.push_back(static_cast<unsigned char>(value >> (i * 8)));
+				}
+			}
+		}
+
+		void BakeCompressedTexture(const std::string& source, const std::string& destination, bool highQuality)
+		{
+			int width, height, components;
+			std::unique_ptr<stbi_uc, void(*)(void*)> decoded(stbi_load(source.c_str(), &width, &height, &components, 4), stbi_image_free);
+			if (decoded == nullptr)
+			{
+				std::string err = "Baking of texture failed.\n";
+				err += "Path: " + source + '\n';
+				err += "Reason: ";
+				err += stbi_failure_reason();
+				err += '\n';
+				throw std::runtime_error(err);
+			}
+
+			std::vector<Level> levels;
+			levels.push_back({ width, height, std::vector<unsigned char>(decoded.get(), decoded.get() + std::size_t(width) * height * 4) });
+			decoded.reset();
+			while (levels.back().width > 1 || levels.back().height > 1)
+			{
+				levels.push_back(Downsample(levels.back()));
+			}
+
+			const auto& top = levels.front().pixels;
+			bool alpha = false;
+			for (std::size_t i = 3; i < top.size() && !alpha; i += 4)
+			{
+				alpha = top[i] != 255;
+			}
+			auto mode = highQuality ? STB_DXT_HIGHQUAL : STB_DXT_NORMAL;
+
+			std::vector<unsigned char> data;
+			for (const auto& level : levels)
+			{
+				CompressLevel(level, alpha, mode, data);
+			}
+			auto topSize = std::uint32_t((std::max(width, 1) + 3) / 4) * std::uint32_t((std::max(height, 1) + 3) / 4) * (alpha ? 16 : 8);
+
+			//A legacy DDS header; DXT1 and DXT5 need no DX10 extension.
+			std::vector<unsigned char> header;
+			const std::uint32_t caps = 0x1, heightFlag = 0x2, widthFlag = 0x4, pixelFormat = 0x1000,
+				mipCount = 0x20000, linearSize = 0x80000;
+			Write32(header, 0x20534444); //"DDS "
+			Write32(header, 124);
+			Write32(header, caps | heightFlag | widthFlag | pixelFormat | mipCount | linearSize);
+			Write32(header, std::uint32_t(height));
+			Write32(header, std::uint32_t(width));
+			Write32(header, topSize);
+			Write32(header, 0);
+			Write32(header, std::uint32_t(levels.size()));
+			for (int i = 0; i < 11; ++i) Write32(header, 0);
+			const std::uint32_t fourCCFlag = 0x4;
+			Write32(header, 32);
+			Write32(header, fourCCFlag);
+			Write32(header, alpha ? 0x35545844 : 0x31545844); //"DXT5" or "DXT1"
+			for (int i = 0; i < 5; ++i) Write32(header, 0);
+			const std::uint32_t textureCaps = 0x1000, complexCaps = 0x8, mipmapCaps = 0x400000;
+			Write32(header, textureCaps | (levels.size() > 1 ? complexCaps | mipmapCaps : 0));
+			for (int i = 0; i < 4; ++i) Write32(header, 0);
+
+			std::ofstream file(destination, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(header.data()), std::streamsize(header.size()));
+			file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+			if (!file)
+			{
+				throw std::runtime_error("Failed to write baked texture.\nPath: " + destination + '\n');
+			}
+		}
+	}
+}
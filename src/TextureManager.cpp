@@ -1,13 +1,22 @@
 #include "TextureManager.hpp"
 #include "gl_core_4_5.h"
 #include "GLFW/glfw3.h"
+#include "CompressedImage.hpp"
+#include "GpuUploader.hpp"
+#include "JobSystem.hpp"
+#include "StreamingBuffer.hpp"
 #include "Texture.hpp"
 #include "Sampler.hpp"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "stb_rect_pack.h"
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 using namespace GlProj::Utilities;
 
@@ -23,14 +32,205 @@ namespace GlProj
 			}
 		};
 
+		//Textures are not shrunk past this size along their longer side.
+		static const constexpr GLsizei MinimumResidentSize = 64;
+
+		//From EXT/ARB_texture_filter_anisotropic; core only from 4.6.
+		static const constexpr GLenum GL_TEXTURE_MAX_ANISOTROPY = 0x84FE;
+
+		//Sampling state set on the texture itself, rather than on a sampler,
+		//carried over when its storage is replaced. Level and LOD values are
+		//shifted down, as the new level 0 is the old level 'levelShift'.
+		static void CopyTextureParameters(GLuint from, GLuint to, GLint levelShift)
+		{
+			static const GLenum integerParameters[] = {
+				GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER,
+				GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_WRAP_R,
+				GL_TEXTURE_COMPARE_MODE, GL_TEXTURE_COMPARE_FUNC,
+			};
+			for (auto p : integerParameters)
+			{
+				GLint value;
+				glGetTextureParameteriv(from, p, &value);
+				glTextureParameteri(to, p, value);
+			}
+
+			GLint swizzle[4];
+			glGetTextureParameteriv(from, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+			glTextureParameteriv(to, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+			GLfloat border[4];
+			glGetTextureParameterfv(from, GL_TEXTURE_BORDER_COLOR, border);
+			glTextureParameterfv(to, GL_TEXTURE_BORDER_COLOR, border);
+
+			GLint baseLevel, maxLevel;
+			glGetTextureParameteriv(from, GL_TEXTURE_BASE_LEVEL, &baseLevel);
+			glGetTextureParameteriv(from, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+			glTextureParameteri(to, GL_TEXTURE_BASE_LEVEL, std::max(baseLevel - levelShift, 0));
+			glTextureParameteri(to, GL_TEXTURE_MAX_LEVEL, std::max(maxLevel - levelShift, 0));
+
+			GLfloat minLod, maxLod, lodBias;
+			glGetTextureParameterfv(from, GL_TEXTURE_MIN_LOD, &minLod);
+			glGetTextureParameterfv(from, GL_TEXTURE_MAX_LOD, &maxLod);
+			glGetTextureParameterfv(from, GL_TEXTURE_LOD_BIAS, &lodBias);
+			glTextureParameterf(to, GL_TEXTURE_MIN_LOD, minLod - GLfloat(levelShift));
+			glTextureParameterf(to, GL_TEXTURE_MAX_LOD, maxLod - GLfloat(levelShift));
+			glTextureParameterf(to, GL_TEXTURE_LOD_BIAS, lodBias);
+
+			static const bool anisotropySupported = glfwExtensionSupported("GL_EXT_texture_filter_anisotropic") == GLFW_TRUE
+				|| glfwExtensionSupported("GL_ARB_texture_filter_anisotropic") == GLFW_TRUE;
+			if (anisotropySupported)
+			{
+				GLfloat anisotropy;
+				glGetTextureParameterfv(from, GL_TEXTURE_MAX_ANISOTROPY, &anisotropy);
+				glTextureParameterf(to, GL_TEXTURE_MAX_ANISOTROPY, anisotropy);
+			}
+		}
+
+		//One opaque white texel in every layer or face; 0 for targets that
+		//cannot be filled from client memory.
+		static GLuint CreatePlaceholder(GLenum target)
+		{
+			static const unsigned char white[6 * 4] = {
+				255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+				255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+			};
+
+			GLuint handle;
+			glCreateTextures(target, 1, &handle);
+			switch (target)
+			{
+			case GL_TEXTURE_1D:
+				glTextureStorage1D(handle, 1, GL_RGBA8, 1);
+				glTextureSubImage1D(handle, 0, 0, 1, GL_RGBA, GL_UNSIGNED_BYTE, white);
+				break;
+			case GL_TEXTURE_1D_ARRAY:
+			case GL_TEXTURE_2D:
+			case GL_TEXTURE_RECTANGLE:
+				glTextureStorage2D(handle, 1, GL_RGBA8, 1, 1);
+				glTextureSubImage2D(handle, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, white);
+				break;
+			case GL_TEXTURE_CUBE_MAP:
+				glTextureStorage2D(handle, 1, GL_RGBA8, 1, 1);
+				glTextureSubImage3D(handle, 0, 0, 0, 0, 1, 1, 6, GL_RGBA, GL_UNSIGNED_BYTE, white);
+				break;
+			case GL_TEXTURE_2D_ARRAY:
+			case GL_TEXTURE_3D:
+				glTextureStorage3D(handle, 1, GL_RGBA8, 1, 1, 1);
+				glTextureSubImage3D(handle, 0, 0, 0, 0, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, white);
+				break;
+			case GL_TEXTURE_CUBE_MAP_ARRAY:
+				glTextureStorage3D(handle, 1, GL_RGBA8, 1, 1, 6);
+				glTextureSubImage3D(handle, 0, 0, 0, 0, 1, 1, 6, GL_RGBA, GL_UNSIGNED_BYTE, white);
+				break;
+			default:
+				glDeleteTextures(1, &handle);
+				return 0;
+			}
+			return handle;
+		}
+
+		//Storage GL reports for a texture allocated elsewhere, so it is
+		//counted against the budget. 3D textures are counted as if every
+		//level kept the full depth.
+		static TextureStorage QueryStorage(GLenum type, GLuint handle)
+		{
+			GLint format = GL_NONE, width = 0, height = 0, depth = 0;
+			glGetTextureLevelParameteriv(handle, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+			glGetTextureLevelParameteriv(handle, 0, GL_TEXTURE_WIDTH, &width);
+			glGetTextureLevelParameteriv(handle, 0, GL_TEXTURE_HEIGHT, &height);
+			glGetTextureLevelParameteriv(handle, 0, GL_TEXTURE_DEPTH, &depth);
+
+			TextureStorage storage{ GLenum(format), width, height, 0 };
+			switch (type)
+			{
+			case GL_TEXTURE_1D_ARRAY:
+				storage.layers = height;
+				storage.height = 1;
+				break;
+			case GL_TEXTURE_2D_ARRAY:
+			case GL_TEXTURE_CUBE_MAP_ARRAY:
+			case GL_TEXTURE_3D:
+				storage.layers = depth;
+				break;
+			case GL_TEXTURE_CUBE_MAP:
+				storage.layers = 6;
+				break;
+			default:
+				break;
+			}
+			if (width == 0) return storage;
+
+			GLint immutable = GL_FALSE;
+			glGetTextureParameteriv(handle, GL_TEXTURE_IMMUTABLE_FORMAT, &immutable);
+			if (immutable == GL_TRUE)
+			{
+				GLint levels;
+				glGetTextureParameteriv(handle, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+				storage.levels = levels;
+				return storage;
+			}
+			//Mutable storage ends at the first level never specified.
+			auto maxLevels = FullMipCount(storage.width, storage.height);
+			for (GLint levelWidth = width; storage.levels < maxLevels && levelWidth != 0; )
+			{
+				++storage.levels;
+				glGetTextureLevelParameteriv(handle, storage.levels, GL_TEXTURE_WIDTH, &levelWidth);
+			}
+			return storage;
+		}
+
 		class TextureManager
 		{
+			struct PackedEntry
+			{
+				LocalWeakPtr<Texture> texture;
+				TextureRegion region;
+			};
+
 			std::unordered_map<std::string, LocalWeakPtr<Texture>> registeredTextures;
+			std::unordered_map<std::string, PackedEntry> packedTextures;
+			//Kept alive here; never counted against the budget or dropped.
+			std::unordered_map<GLenum, LocalSharedPtr<Texture>> placeholders;
+			std::size_t budget = 0;
+
+			//Swaps in storage with one level fewer, copying the rest over.
+			static std::size_t DropTopLevel(Texture& texture)
+			{
+				const auto& old = texture.GetStorage();
+				TextureStorage storage{ old.internalFormat, std::max(old.width / 2, 1),
+					std::max(old.height / 2, 1), old.levels - 1 };
+
+				GLuint handle;
+				glCreateTextures(GL_TEXTURE_2D, 1, &handle);
+				glTextureStorage2D(handle, storage.levels, storage.internalFormat, storage.width, storage.height);
+				CopyTextureParameters(texture.GetHandle(), handle, 1);
+
+				auto width = storage.width, height = storage.height;
+				for (GLsizei level = 0; level < storage.levels; ++level)
+				{
+					glCopyImageSubData(texture.GetHandle(), GL_TEXTURE_2D, level + 1, 0, 0, 0,
+						handle, GL_TEXTURE_2D, level, 0, 0, 0, width, height, 1);
+					width = std::max(width / 2, 1);
+					height = std::max(height / 2, 1);
+				}
+
+				auto before = texture.SizeInBytes();
+				texture.ReplaceStorage(handle, storage);
+				return before - texture.SizeInBytes();
+			}
+			static bool CanDropLevel(const Texture& texture)
+			{
+				const auto& storage = texture.GetStorage();
+				return texture.GetType() == GL_TEXTURE_2D && texture.IsReady() && storage.levels > 1
+					&& std::max(storage.width, storage.height) > MinimumResidentSize;
+			}
 		public:
-			LocalSharedPtr<Texture> RegisterTexture(GLenum type, GLuint handle, const std::string& name)
+			LocalSharedPtr<Texture> RegisterTexture(GLenum type, GLuint handle, const TextureStorage& storage,
+				const std::string& name, std::shared_ptr<UploadFence> upload = nullptr)
 			{
-				auto newPtr = make_localshared<Texture>(type, handle);
+				auto newPtr = make_localshared<Texture>(type, handle, storage, std::move(upload));
 				registeredTextures[name] = newPtr;
+				EnforceBudget();
 				return std::move(newPtr);
 			}
 			LocalSharedPtr<Texture> FindByName(const std::string& name) const
@@ -43,6 +243,35 @@ namespace GlProj
 
 				return found->second.lock();
 			}
+			void RegisterPacked(const std::string& path, const LocalSharedPtr<Texture>& texture, const TextureRegion& region)
+			{
+				packedTextures[path] = PackedEntry{ texture, region };
+			}
+			PackedTexture FindPacked(const std::string& path) const
+			{
+				auto found = packedTextures.find(path);
+				if (found == packedTextures.end())
+				{
+					return{};
+				}
+
+				return{ found->second.texture.lock(), found->second.region };
+			}
+
+			LocalSharedPtr<Texture> Placeholder(GLenum target)
+			{
+				auto& placeholder = placeholders[target];
+				if (placeholder == nullptr)
+				{
+					auto handle = CreatePlaceholder(target);
+					if (handle != 0)
+					{
+						placeholder = make_localshared<Texture>(target, handle, TextureStorage{ GL_RGBA8, 1, 1, 1,
+							target == GL_TEXTURE_CUBE_MAP || target == GL_TEXTURE_CUBE_MAP_ARRAY ? 6 : 1 });
+					}
+				}
+				return placeholder;
+			}
 
 			void CleanUpDangling()
 			{
@@ -57,18 +286,348 @@ namespace GlProj
 					}
 					begin = registeredTextures.erase(begin);
 				}
+
+				for (auto packed = packedTextures.begin(); packed != packedTextures.end();)
+				{
+					if (packed->second.texture.expired())
+					{
+						packed = packedTextures.erase(packed);
+					}
+					else
+					{
+						++packed;
+					}
+				}
+			}
+
+			void SetBudget(std::size_t bytes) noexcept
+			{
+				budget = bytes;
+			}
+			std::size_t GetBudget() const noexcept
+			{
+				return budget;
+			}
+			std::size_t MemoryUsage() const
+			{
+				std::size_t usage = 0;
+				for (const auto& entry : registeredTextures)
+				{
+					auto texture = entry.second.lock();
+					if (texture != nullptr)
+					{
+						usage += texture->SizeInBytes();
+					}
+				}
+				return usage;
+			}
+			std::size_t EnforceBudget()
+			{
+				if (budget == 0) return 0;
+				auto usage = MemoryUsage();
+				if (usage <= budget) return 0;
+
+				//Freed textures are already gone, so the only memory left to
+				//reclaim is in the mips of textures still in use.
+				//Held so nothing is freed mid-way; sorted through raw pointers.
+				std::vector<LocalSharedPtr<Texture>> live;
+				std::vector<Texture*> candidates;
+				for (const auto& entry : registeredTextures)
+				{
+					auto texture = entry.second.lock();
+					if (texture != nullptr && CanDropLevel(*texture))
+					{
+						candidates.push_back(texture.get());
+						live.push_back(std::move(texture));
+					}
+				}
+				std::sort(candidates.begin(), candidates.end(), [](const Texture* a, const Texture* b)
+				{
+					return a->LastBound() < b->LastBound();
+				});
+
+				std::size_t released = 0;
+				for (auto texture : candidates)
+				{
+					while (usage - released > budget && CanDropLevel(*texture))
+					{
+						released += DropTopLevel(*texture);
+					}
+					if (usage - released <= budget) break;
+				}
+				return released;
 			}
 		};
 
 		using stbiDataPtr = std::unique_ptr<stbi_uc, stbiImageDeleter>;
 
+		static std::string LoadErrorMessage(const std::string& path)
+		{
+			std::string err = "Loading of image file failed.\n";
+			err += "Path: ";
+			err += path;
+			err += "\nReason: ";
+			err += stbi_failure_reason();
+			err += '\n';
+			return err;
+		}
+		[[noreturn]] static void ThrowLoadError(const std::string& path)
+		{
+			throw std::runtime_error(LoadErrorMessage(path));
+		}
+
+		static GLenum DimensionsForHeight(int height) noexcept
+		{
+			return height == 1 ? GL_TEXTURE_1D : GL_TEXTURE_2D;
+		}
+
+		struct PixelFormat
+		{
+			GLint internalFormat;
+			GLenum externalFormat;
+		};
+
+		static PixelFormat FormatForComponents(int components)
+		{
+			switch (components)
+			{
+			default:
+				throw std::runtime_error("Invalid number of components in texture.");
+			case 1:
+				return{ GL_R8, GL_RED };
+			case 2:
+				return{ GL_RG8, GL_RG };
+			case 3:
+				return{ GL_RGB8, GL_RGB };
+			case 4:
+				return{ GL_RGBA8, GL_RGBA };
+			}
+		}
+
+		//Leaves the texture bound to 'target'.
+		//Sets GL_UNPACK_ALIGNMENT for its lifetime, then puts back what was
+		//there, so uploads here do not change it for anyone else.
+		class ScopedUnpackAlignment
+		{
+			GLint previous;
+		public:
+			explicit ScopedUnpackAlignment(GLint alignment)
+			{
+				glGetIntegerv(GL_UNPACK_ALIGNMENT, &previous);
+				glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+			}
+			ScopedUnpackAlignment(const ScopedUnpackAlignment&) = delete;
+			ScopedUnpackAlignment& operator=(const ScopedUnpackAlignment&) = delete;
+			~ScopedUnpackAlignment()
+			{
+				glPixelStorei(GL_UNPACK_ALIGNMENT, previous);
+			}
+		};
+
+		static void UploadImage(GLenum target, GLuint handle, int width, int height, PixelFormat format, const void* pixels,
+			GLsizei levels)
+		{
+			glBindTexture(target, handle);
+			//stb_image rows are tightly packed, which RGB rows often are not by default.
+			ScopedUnpackAlignment alignment(1);
+
+			if(target == GL_TEXTURE_2D)
+			{
+				glTexStorage2D(target, levels, format.internalFormat, width, height);
+				glTexSubImage2D(target, 0, 0, 0, width, height, format.externalFormat, GL_UNSIGNED_BYTE, pixels);
+			}
+			else
+			{
+				glTexStorage1D(target, levels, format.internalFormat, width);
+				glTexSubImage1D(target, 0, 0, width, format.externalFormat, GL_UNSIGNED_BYTE, pixels);
+			}
+			if (levels > 1)
+			{
+				glGenerateMipmap(target);
+			}
+		}
+		//Leaves the texture bound to GL_TEXTURE_2D.
+		static void UploadImage(GLuint handle, const CompressedImage& image)
+		{
+			glBindTexture(GL_TEXTURE_2D, handle);
+			//Storage sized to the levels present keeps a partial chain complete.
+			glTexStorage2D(GL_TEXTURE_2D, GLsizei(image.levels.size()), image.internalFormat, image.width, image.height);
+			for (std::size_t i = 0; i < image.levels.size(); ++i)
+			{
+				const auto& level = image.levels[i];
+				glCompressedTexSubImage2D(GL_TEXTURE_2D, GLint(i), 0, 0, level.width, level.height, image.internalFormat,
+					GLsizei(level.size), image.LevelData(i));
+			}
+		}
+
+		static TextureStorage StorageFor(const CompressedImage& image) noexcept
+		{
+			return{ image.internalFormat, GLsizei(image.width), GLsizei(image.height), GLsizei(image.levels.size()) };
+		}
+		static TextureStorage StorageFor(GLenum target, int width, int height, PixelFormat format, bool generateMipmaps) noexcept
+		{
+			//1D textures only halve along their width.
+			auto levelHeight = target == GL_TEXTURE_1D ? 1 : height;
+			auto levels = generateMipmaps ? FullMipCount(width, levelHeight) : 1;
+			return{ GLenum(format.internalFormat), width, height, levels };
+		}
+
+		//An image in a LoadTextures batch, waiting to be decoded.
+		struct PendingImage
+		{
+			std::string path;
+			std::size_t index;
+			GLenum target;
+			PixelFormat format;
+			int components;
+			TextureStorage storage;
+			GLsizeiptr size;
+			//Empty when the image is too large to stage.
+			StreamingAllocation staging;
+			//Only kept when there is no staging memory to decode into.
+			stbiDataPtr pixels;
+			//Jobs must not throw, so failures are passed back here.
+			std::string error;
+		};
+
+		static const constexpr GLsizeiptr StagingAlignment = 4;
+
+		static GLsizeiptr StagingSize(const PendingImage& image) noexcept
+		{
+			return (image.size + StagingAlignment - 1) / StagingAlignment * StagingAlignment;
+		}
+		//Runs on a worker thread.
+		static void DecodeImage(PendingImage& image)
+		{
+			stbiImageDeleter deleter;
+			int width, height, fileComponents;
+			auto pixelData = stbiDataPtr(stbi_load(image.path.c_str(), &width, &height, &fileComponents, image.components), deleter);
+			if (pixelData == nullptr)
+			{
+				image.error = LoadErrorMessage(image.path);
+				return;
+			}
+			//The staging memory was sized from the header.
+			if (width != image.storage.width || height != image.storage.height)
+			{
+				image.error = "Image changed size while loading.\nPath: " + image.path + '\n';
+				return;
+			}
+
+			if (image.staging.data != nullptr)
+			{
+				//The buffer is coherently mapped, so no flush is needed.
+				std::memcpy(image.staging.data, pixelData.get(), std::size_t(image.size));
+			}
+			else
+			{
+				image.pixels = std::move(pixelData);
+			}
+		}
+		//Uploads images [first, last) of 'pending', decoding them meanwhile.
+		static void UploadBatch(TextureManager* manager, JobSystem& jobs, StreamingBuffer& staging,
+			std::vector<PendingImage>& pending, std::size_t first, std::size_t last,
+			std::vector<LocalSharedPtr<Texture>>& results)
+		{
+			//Claims a whole region, so the fence placed after these uploads
+			//is what guards the memory they read.
+			staging.BeginFrame();
+			for (auto i = first; i < last; ++i)
+			{
+				if (StagingSize(pending[i]) <= staging.GetRegionSize())
+				{
+					pending[i].staging = staging.Allocate(pending[i].size, StagingAlignment);
+				}
+			}
+
+			auto count = last - first;
+			std::unique_ptr<JobCounter[]> decoded(new JobCounter[count]);
+			for (std::size_t k = 0; k < count; ++k)
+			{
+				auto image = &pending[first + k];
+				jobs.Run([image]()
+				{
+					DecodeImage(*image);
+				}, &decoded[k]);
+			}
+
+			//Every job is waited on, even after a failure, as they refer to
+			//'pending'.
+			std::string error;
+			for (std::size_t k = 0; k < count; ++k)
+			{
+				jobs.Wait(decoded[k]);
+
+				auto& image = pending[first + k];
+				if (!error.empty()) continue;
+				if (!image.error.empty())
+				{
+					error = std::move(image.error);
+					continue;
+				}
+
+				GLuint handle;
+				glGenTextures(1, &handle);
+				if (image.staging.data != nullptr)
+				{
+					staging.Bind();
+					UploadImage(image.target, handle, image.storage.width, image.storage.height, image.format,
+						reinterpret_cast<const void*>(image.staging.offset), image.storage.levels);
+					glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				}
+				else
+				{
+					UploadImage(image.target, handle, image.storage.width, image.storage.height, image.format,
+						image.pixels.get(), image.storage.levels);
+					image.pixels.reset();
+				}
+				glBindTexture(image.target, 0);
+
+				results[image.index] = manager->RegisterTexture(image.target, handle, image.storage, NormalisePath(image.path));
+			}
+			staging.EndFrame();
+
+			if (!error.empty())
+			{
+				throw std::runtime_error(error);
+			}
+		}
+
+		//Texels of edge repeated around each packed image. Mip levels past
+		//log2 of this start to blend neighbours, so arrays stop there.
+		static const constexpr int PackPadding = 8;
+		static const constexpr GLsizei PackedLevelCount = 4;
+
+		//Kept a multiple of the padding, so every rect starts on a texel
+		//that survives into the last level.
+		static int PackedExtent(int size) noexcept
+		{
+			return (size + 2 * PackPadding + PackPadding - 1) / PackPadding * PackPadding;
+		}
+		//Copies the image to its rect, repeating the edge texels out over
+		//the padding.
+		static void BlitPadded(unsigned char* layer, GLsizei layerSize, const stbrp_rect& rect,
+			const unsigned char* pixels, int width, int height)
+		{
+			for (int y = -PackPadding; y < height + PackPadding; ++y)
+			{
+				auto sourceY = std::min(std::max(y, 0), height - 1);
+				auto dest = layer + (std::size_t(rect.y + PackPadding + y) * layerSize + rect.x) * 4;
+				for (int x = -PackPadding; x < width + PackPadding; ++x)
+				{
+					auto sourceX = std::min(std::max(x, 0), width - 1);
+					std::memcpy(dest + (x + PackPadding) * 4, pixels + (std::size_t(sourceY) * width + sourceX) * 4, 4);
+				}
+			}
+		}
+
 		TextureManager* GetTextureManager()
 		{
 			static TextureManager instance;
 			return &instance;
 		}
 
-		LocalSharedPtr<Texture> LoadTexture(TextureManager* manager, const std::string& path, bool replace)
+		LocalSharedPtr<Texture> LoadTexture(TextureManager* manager, const std::string& path, bool replace, bool generateMipmaps)
 		{
 			if(!replace)
 			{
@@ -79,65 +638,311 @@ namespace GlProj
 				}
 			}
 
+			if (IsCompressedImageFile(path))
+			{
+				auto image = ReadCompressedImage(path);
+				GLuint handle;
+				glGenTextures(1, &handle);
+				UploadImage(handle, image);
+				return manager->RegisterTexture(GL_TEXTURE_2D, handle, StorageFor(image), NormalisePath(path));
+			}
+
 			stbiImageDeleter deleter;
 			int width, height, components;
 			auto pixelData = stbiDataPtr(stbi_load(path.c_str(), &width, &height, &components, 0), deleter);
 
 			if (pixelData == nullptr)
 			{
-				std::string err = "Loading of image file failed.\n";
-				err += "Path: ";
-				err += path;
-				err += "\nReason: ";
-				err += stbi_failure_reason();
-				err += '\n';
-				throw std::runtime_error(err);
+				ThrowLoadError(path);
 			}
 
-			GLenum textureDimensions = GL_TEXTURE_2D;
-			if(height == 1)
+			auto textureDimensions = DimensionsForHeight(height);
+			auto format = FormatForComponents(components);
+			auto storage = StorageFor(textureDimensions, width, height, format, generateMipmaps);
+
+			GLuint handle;
+			glGenTextures(1, &handle);
+
+			UploadImage(textureDimensions, handle, width, height, format, pixelData.get(), storage.levels);
+
+			return manager->RegisterTexture(textureDimensions, handle, storage, NormalisePath(path));
+		}
+		LocalSharedPtr<Texture> LoadTexture(TextureManager* manager, GpuUploader& uploader, const std::string& path, bool replace, bool generateMipmaps)
+		{
+			if (!replace)
 			{
-				textureDimensions = GL_TEXTURE_1D;
+				auto ptr = FindCachedTextureByPath(manager, path);
+				if (ptr != nullptr)
+				{
+					return std::move(ptr);
+				}
 			}
-			GLint internalFormat, externalFormat;
 
-			switch (components)
+			if (IsCompressedImageFile(path))
 			{
-			default:
-				throw std::runtime_error("Invalid number of components in texture.");
-			case 1:
-				internalFormat = GL_R8;
-				externalFormat = GL_RED;
-				break;
-			case 2:
-				internalFormat = GL_RG_INTEGER; 
-				externalFormat = GL_RG;
-				break;
-			case 3:
-				internalFormat = GL_RGB_INTEGER;
-				externalFormat = GL_RGB;
-				break;
-			case 4:
-				internalFormat = GL_RGBA_INTEGER;
-				externalFormat = GL_RGBA;
-				break;
+				//Parsing only maps the file; the upload reads straight from it.
+				auto image = ReadCompressedImage(path);
+				GLuint handle;
+				glGenTextures(1, &handle);
+				auto fence = uploader.Submit([handle, image]()
+				{
+					UploadImage(handle, image);
+					glBindTexture(GL_TEXTURE_2D, 0);
+				});
+				return manager->RegisterTexture(GL_TEXTURE_2D, handle, StorageFor(image), NormalisePath(path), std::move(fence));
+			}
+
+			//The target must be known up front, so the header is read now.
+			int width, height, components;
+			if (stbi_info(path.c_str(), &width, &height, &components) == 0)
+			{
+				ThrowLoadError(path);
 			}
+			auto textureDimensions = DimensionsForHeight(height);
+			auto format = FormatForComponents(components);
+			auto storage = StorageFor(textureDimensions, width, height, format, generateMipmaps);
 
+			//Names are shared between contexts, so this one is usable by
+			//the upload thread straight away.
 			GLuint handle;
 			glGenTextures(1, &handle);
 
-			glBindTexture(textureDimensions, handle);
+			auto fence = uploader.Submit([textureDimensions, handle, format, components, storage, path]()
+			{
+				//Asks for the component count read from the header, in case
+				//the file changed in between. The size must match too, as
+				//the budget was charged for it.
+				stbiImageDeleter deleter;
+				int width, height, fileComponents;
+				auto pixelData = stbiDataPtr(stbi_load(path.c_str(), &width, &height, &fileComponents, components), deleter);
+				if (pixelData == nullptr)
+				{
+					ThrowLoadError(path);
+				}
+				if (width != storage.width || height != storage.height)
+				{
+					throw std::runtime_error("Image changed size while loading.\nPath: " + path + '\n');
+				}
+
+				UploadImage(textureDimensions, handle, width, height, format, pixelData.get(), storage.levels);
+				glBindTexture(textureDimensions, 0);
+			});
 
-			if(textureDimensions == GL_TEXTURE_2D)
+			return manager->RegisterTexture(textureDimensions, handle, storage, NormalisePath(path), std::move(fence));
+		}
+		std::vector<LocalSharedPtr<Texture>> LoadTextures(TextureManager* manager, JobSystem& jobs, StreamingBuffer& staging,
+			const std::vector<std::string>& paths, bool replace, bool generateMipmaps)
+		{
+			if (staging.GetBufferType() != BufferType::pixel_unpack)
 			{
-				glTexImage2D(textureDimensions, 0, internalFormat, width, height, 0, externalFormat, GL_UNSIGNED_BYTE, pixelData.get());
+				throw std::logic_error("Texture staging buffer must be a pixel_unpack buffer.");
 			}
-			else
+
+			std::vector<LocalSharedPtr<Texture>> results(paths.size());
+			std::vector<PendingImage> pending;
+			for (std::size_t i = 0; i < paths.size(); ++i)
 			{
-				glTexImage1D(textureDimensions, 0, internalFormat, width, 0, externalFormat, GL_UNSIGNED_BYTE, pixelData.get());
+				const auto& path = paths[i];
+				if (!replace)
+				{
+					results[i] = FindCachedTextureByPath(manager, path);
+					if (results[i] != nullptr) continue;
+				}
+
+				//Nothing to decode; these upload straight from the mapped file.
+				if (IsCompressedImageFile(path))
+				{
+					results[i] = LoadTexture(manager, path, true, generateMipmaps);
+					continue;
+				}
+
+				int width, height, components;
+				if (stbi_info(path.c_str(), &width, &height, &components) == 0)
+				{
+					ThrowLoadError(path);
+				}
+				auto target = DimensionsForHeight(height);
+				auto format = FormatForComponents(components);
+				auto storage = StorageFor(target, width, height, format, generateMipmaps);
+				auto size = GLsizeiptr(width) * height * components;
+				pending.push_back(PendingImage{ path, i, target, format, components, storage, size, {}, nullptr, {} });
 			}
 
-			return manager->RegisterTexture(textureDimensions, handle, NormalisePath(path));
+			//Batches fill a region each; an image too large for one goes alone.
+			std::size_t next = 0;
+			while (next < pending.size())
+			{
+				auto first = next;
+				GLsizeiptr used = 0;
+				while (next < pending.size())
+				{
+					auto size = StagingSize(pending[next]);
+					if (size > staging.GetRegionSize())
+					{
+						if (next == first) ++next;
+						break;
+					}
+					if (used + size > staging.GetRegionSize()) break;
+					used += size;
+					++next;
+				}
+				UploadBatch(manager, jobs, staging, pending, first, next, results);
+			}
+
+			return results;
+		}
+		LocalSharedPtr<Texture> PackTextureArray(TextureManager* manager, const std::string& name,
+			const std::vector<std::string>& paths, GLsizei layerSize)
+		{
+			struct PackedImage
+			{
+				std::string path;
+				int width;
+				int height;
+			};
+
+			std::vector<PackedImage> images;
+			std::vector<stbrp_rect> rects;
+			for (const auto& path : paths)
+			{
+				if (IsCompressedImageFile(path)) continue;
+
+				int width, height, components;
+				if (stbi_info(path.c_str(), &width, &height, &components) == 0)
+				{
+					ThrowLoadError(path);
+				}
+				if (PackedExtent(width) > layerSize || PackedExtent(height) > layerSize) continue;
+
+				stbrp_rect rect{};
+				rect.id = int(rects.size());
+				rect.w = PackedExtent(width);
+				rect.h = PackedExtent(height);
+				rects.push_back(rect);
+				images.push_back({ path, width, height });
+			}
+			if (rects.empty())
+			{
+				return nullptr;
+			}
+
+			//Each pass fills a fresh layer with whatever of the rest fits.
+			//Every rect fits an empty layer, so each pass places at least one.
+			std::vector<stbrp_node> nodes(layerSize);
+			std::vector<GLsizei> layerOf(rects.size());
+			std::vector<stbrp_rect> pending = rects;
+			GLsizei layers = 0;
+			while (!pending.empty())
+			{
+				stbrp_context context;
+				stbrp_init_target(&context, layerSize, layerSize, nodes.data(), int(nodes.size()));
+				stbrp_pack_rects(&context, pending.data(), int(pending.size()));
+
+				std::vector<stbrp_rect> unplaced;
+				for (const auto& rect : pending)
+				{
+					if (rect.was_packed)
+					{
+						rects[rect.id] = rect;
+						layerOf[rect.id] = layers;
+					}
+					else
+					{
+						unplaced.push_back(rect);
+					}
+				}
+				pending.swap(unplaced);
+				++layers;
+			}
+
+			TextureStorage storage{ GL_RGBA8, layerSize, layerSize,
+				std::min(PackedLevelCount, FullMipCount(layerSize, layerSize)), layers };
+
+			GLuint handle;
+			glGenTextures(1, &handle);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, handle);
+			glTexStorage3D(GL_TEXTURE_2D_ARRAY, storage.levels, storage.internalFormat, layerSize, layerSize, layers);
+			ScopedUnpackAlignment alignment(1);
+
+			//Filled and uploaded a layer at a time, so only one is held.
+			std::vector<unsigned char> layerData(std::size_t(layerSize) * layerSize * 4);
+			for (GLsizei layer = 0; layer < layers; ++layer)
+			{
+				std::fill(layerData.begin(), layerData.end(), static_cast<unsigned char>(0));
+				for (std::size_t i = 0; i < images.size(); ++i)
+				{
+					if (layerOf[i] != layer) continue;
+
+					const auto& image = images[i];
+					stbiImageDeleter deleter;
+					int width, height, components;
+					auto pixelData = stbiDataPtr(stbi_load(image.path.c_str(), &width, &height, &components, 4), deleter);
+					if (pixelData == nullptr || width != image.width || height != image.height)
+					{
+						glDeleteTextures(1, &handle);
+						ThrowLoadError(image.path);
+					}
+					BlitPadded(layerData.data(), layerSize, rects[i], pixelData.get(), width, height);
+				}
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, layerSize, layerSize, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+					layerData.data());
+			}
+			if (storage.levels > 1)
+			{
+				glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+			}
+			glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+			auto texture = manager->RegisterTexture(GL_TEXTURE_2D_ARRAY, handle, storage, name);
+			auto scale = 1.0f / GLfloat(layerSize);
+			for (std::size_t i = 0; i < images.size(); ++i)
+			{
+				TextureRegion region;
+				region.u = GLfloat(rects[i].x + PackPadding) * scale;
+				region.v = GLfloat(rects[i].y + PackPadding) * scale;
+				region.width = GLfloat(images[i].width) * scale;
+				region.height = GLfloat(images[i].height) * scale;
+				region.layer = layerOf[i];
+				manager->RegisterPacked(NormalisePath(images[i].path), texture, region);
+			}
+			return texture;
+		}
+		PackedTexture LoadPackedTexture(TextureManager* manager, const std::string& path)
+		{
+			auto packed = manager->FindPacked(NormalisePath(path));
+			if (packed.texture != nullptr)
+			{
+				return packed;
+			}
+
+			return{ LoadTexture(manager, path), TextureRegion{} };
+		}
+		std::vector<PackedTexture> LoadPackedTextures(TextureManager* manager, JobSystem& jobs, StreamingBuffer& staging,
+			const std::vector<std::string>& paths, bool replace)
+		{
+			std::vector<PackedTexture> results(paths.size());
+			std::vector<std::string> unpacked;
+			std::vector<std::size_t> unpackedIndices;
+			for (std::size_t i = 0; i < paths.size(); ++i)
+			{
+				results[i] = manager->FindPacked(NormalisePath(paths[i]));
+				if (results[i].texture == nullptr)
+				{
+					unpacked.push_back(paths[i]);
+					unpackedIndices.push_back(i);
+				}
+			}
+
+			auto loaded = LoadTextures(manager, jobs, staging, unpacked, replace);
+			for (std::size_t i = 0; i < loaded.size(); ++i)
+			{
+				results[unpackedIndices[i]].texture = std::move(loaded[i]);
+			}
+			return results;
+		}
+		LocalSharedPtr<Texture> GetPlaceholderTexture(TextureManager* manager, GLenum target)
+		{
+			return manager->Placeholder(target);
 		}
 		LocalSharedPtr<Texture> RegisterTexture(TextureManager* manager, GLenum type, GLuint handle, const std::string& name, bool replace)
 		{
@@ -150,7 +955,7 @@ namespace GlProj
 				}
 			}
 
-			return manager->RegisterTexture(type, handle, name);
+			return manager->RegisterTexture(type, handle, QueryStorage(type, handle), name);
 		}
 
 		LocalSharedPtr<Texture> FindCachedTextureByPath(const TextureManager* manager, const std::string& path)
@@ -168,6 +973,24 @@ namespace GlProj
 		{
 			manager->CleanUpDangling();
 		}
+		void SetTextureBudget(TextureManager* manager, std::size_t bytes)
+		{
+			manager->SetBudget(bytes);
+			manager->EnforceBudget();
+		}
+		std::size_t GetTextureBudget(const TextureManager* manager)
+		{
+			return manager->GetBudget();
+		}
+		std::size_t GetTextureMemoryUsage(const TextureManager* manager)
+		{
+			return manager->MemoryUsage();
+		}
+		std::size_t EnforceTextureBudget(TextureManager* manager)
+		{
+			return manager->EnforceBudget();
+		}
+
 		LocalSharedPtr<Sampler> GenerateSampler()
 		{
 			return make_localshared<Sampler>();
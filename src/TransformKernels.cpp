@@ -0,0 +1,340 @@
+#include "TransformKernels.hpp"
+#include "Model.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+#if defined(__AVX__)
+	#define GLPROJ_TRANSFORM_AVX
+#endif
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#define GLPROJ_TRANSFORM_SSE
+#endif
+
+#if defined(GLPROJ_TRANSFORM_AVX)
+	#include <immintrin.h>
+#elif defined(GLPROJ_TRANSFORM_SSE)
+	#include <xmmintrin.h>
+#endif
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		void MultiplyTransform(const glm::mat4& lhs, const glm::mat4& rhs, glm::mat4& out) noexcept
+		{
+#if defined(GLPROJ_TRANSFORM_SSE)
+			const float* a = &lhs[0][0];
+			const float* b = &rhs[0][0];
+			float* o = &out[0][0];
+
+			//Each output column is a combination of the columns of 'lhs'.
+			//All of 'lhs' is loaded up front and 'rhs' is read a column ahead
+			//of the writes, so 'out' may alias either input.
+			const __m128 c0 = _mm_loadu_ps(a);
+			const __m128 c1 = _mm_loadu_ps(a + 4);
+			const __m128 c2 = _mm_loadu_ps(a + 8);
+			const __m128 c3 = _mm_loadu_ps(a + 12);
+			for (int j = 0; j < 4; ++j)
+			{
+				const float* bj = b + j * 4;
+				__m128 r = _mm_mul_ps(c0, _mm_set1_ps(bj[0]));
+				r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(bj[1])));
+				r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(bj[2])));
+				r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(bj[3])));
+				_mm_storeu_ps(o + j * 4, r);
+			}
+#else
+			out = lhs * rhs;
+#endif
+		}
+		void MultiplyTransforms(const glm::mat4* lhs, const glm::mat4* rhs, glm::mat4* out, std::size_t count) noexcept
+		{
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				MultiplyTransform(lhs[i], rhs[i], out[i]);
+			}
+		}
+
+		TransformsSoA::TransformsSoA(std::size_t n)
+		{
+			resize(n);
+		}
+		std::size_t TransformsSoA::size() const noexcept
+		{
+			return count;
+		}
+		void TransformsSoA::resize(std::size_t n)
+		{
+			for (auto& e : elements)
+			{
+				e.resize(n);
+			}
+			count = n;
+		}
+		float* TransformsSoA::Element(int k) noexcept
+		{
+			return elements[k].data();
+		}
+		const float* TransformsSoA::Element(int k) const noexcept
+		{
+			return elements[k].data();
+		}
+		void TransformsSoA::Set(std::size_t i, const glm::mat4& m) noexcept
+		{
+			const float* src = &m[0][0];
+			for (int k = 0; k < 16; ++k)
+			{
+				elements[k][i] = src[k];
+			}
+		}
+		glm::mat4 TransformsSoA::Get(std::size_t i) const noexcept
+		{
+			glm::mat4 m;
+			float* dest = &m[0][0];
+			for (int k = 0; k < 16; ++k)
+			{
+				dest[k] = elements[k][i];
+			}
+			return m;
+		}
+
+		void MultiplyTransforms(const TransformsSoA& lhs, const TransformsSoA& rhs, TransformsSoA& out)
+		{
+			auto n = std::min(lhs.size(), rhs.size());
+			out.resize(n);
+
+			const float* a[16];
+			const float* b[16];
+			float* o[16];
+			for (int k = 0; k < 16; ++k)
+			{
+				a[k] = lhs.Element(k);
+				b[k] = rhs.Element(k);
+				o[k] = out.Element(k);
+			}
+
+			//out[c][r] = sum over k of lhs[k][r] * rhs[c][k]
+			std::size_t i = 0;
+#if defined(GLPROJ_TRANSFORM_AVX)
+			for (; i + 8 <= n; i += 8)
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					const __m256 b0 = _mm256_loadu_ps(b[c * 4] + i);
+					const __m256 b1 = _mm256_loadu_ps(b[c * 4 + 1] + i);
+					const __m256 b2 = _mm256_loadu_ps(b[c * 4 + 2] + i);
+					const __m256 b3 = _mm256_loadu_ps(b[c * 4 + 3] + i);
+					for (int r = 0; r < 4; ++r)
+					{
+						__m256 acc = _mm256_mul_ps(_mm256_loadu_ps(a[r] + i), b0);
+						acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a[4 + r] + i), b1));
+						acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a[8 + r] + i), b2));
+						acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a[12 + r] + i), b3));
+						_mm256_storeu_ps(o[c * 4 + r] + i, acc);
+					}
+				}
+			}
+#endif
+#if defined(GLPROJ_TRANSFORM_SSE)
+			for (; i + 4 <= n; i += 4)
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					const __m128 b0 = _mm_loadu_ps(b[c * 4] + i);
+					const __m128 b1 = _mm_loadu_ps(b[c * 4 + 1] + i);
+					const __m128 b2 = _mm_loadu_ps(b[c * 4 + 2] + i);
+					const __m128 b3 = _mm_loadu_ps(b[c * 4 + 3] + i);
+					for (int r = 0; r < 4; ++r)
+					{
+						__m128 acc = _mm_mul_ps(_mm_loadu_ps(a[r] + i), b0);
+						acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a[4 + r] + i), b1));
+						acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a[8 + r] + i), b2));
+						acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a[12 + r] + i), b3));
+						_mm_storeu_ps(o[c * 4 + r] + i, acc);
+					}
+				}
+			}
+#endif
+			for (; i < n; ++i)
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					for (int r = 0; r < 4; ++r)
+					{
+						o[c * 4 + r][i] = a[r][i] * b[c * 4][i]
+							+ a[4 + r][i] * b[c * 4 + 1][i]
+							+ a[8 + r][i] * b[c * 4 + 2][i]
+							+ a[12 + r][i] * b[c * 4 + 3][i];
+					}
+				}
+			}
+		}
+
+#if defined(GLPROJ_RUN_BENCHMARKS)
+		using Utilities::SceneNode;
+
+		static void AddSyntheticChildren(SceneGraph<ModelData>& graph, SceneNode<ModelData>* parent,
+			std::mt19937& rng, int& budget, int depth)
+		{
+			if (budget <= 0 || depth == 0) return;
+
+			std::uniform_int_distribution<int> branching(1, 4);
+			std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+			auto childCount = std::min(branching(rng), budget);
+			auto firstChild = parent->children->size();
+			budget -= childCount;
+			for (int i = 0; i < childCount; ++i)
+			{
+				auto local = glm::translate(glm::mat4(1), glm::vec3{ offset(rng), offset(rng), offset(rng) });
+				local = glm::rotate(local, offset(rng), glm::vec3{ 0.0f, 1.0f, 0.0f });
+				graph.emplace(parent, local, std::vector<unsigned int>{}, std::string{});
+			}
+			//Children are only recursed into once all siblings exist, so the
+			//pointers into the child list stay valid.
+			for (int i = 0; i < childCount; ++i)
+			{
+				AddSyntheticChildren(graph, parent->children->data() + firstChild + i, rng, budget, depth - 1);
+			}
+		}
+
+		static SceneGraph<ModelData> MakeSyntheticHierarchy(int nodeCount)
+		{
+			SceneGraph<ModelData> graph;
+			std::mt19937 rng(1729);
+			int budget = nodeCount - 1;
+			auto root = graph.emplace(nullptr, glm::mat4(1), std::vector<unsigned int>{}, std::string{});
+			while (budget > 0)
+			{
+				AddSyntheticChildren(graph, root, rng, budget, 12);
+			}
+			return graph;
+		}
+
+		//The per-node walk to the root that main.cpp used before Model
+		//cached world transforms.
+		static glm::mat4 ApplyHierarchy(const SceneNode<ModelData>& n)
+		{
+			auto node = &n;
+			auto t = glm::mat4(1);
+			while (node != nullptr)
+			{
+				t *= node->data.transform;
+				node = node->parent;
+			}
+			return t;
+		}
+
+		template<typename F>
+		static double TimePerPass(int passes, F f)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < passes; ++i)
+			{
+				f();
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+			return std::chrono::duration<double, std::milli>(end - start).count() / passes;
+		}
+
+		void BenchmarkWorldTransforms()
+		{
+			for (int nodeCount : { 10000, 100000 })
+			{
+				const int passes = nodeCount >= 100000 ? 20 : 100;
+				auto graph = MakeSyntheticHierarchy(nodeCount);
+				Model model{ {}, graph };
+				const auto& hierarchy = model.GetHierarchy();
+				auto n = hierarchy.size();
+
+				float sink = 0.0f;
+				std::vector<glm::mat4> worlds(n);
+
+				auto walk = TimePerPass(passes, [&]()
+				{
+					std::size_t i = 0;
+					for (auto pos = graph.begin(); pos != graph.end(); ++pos, ++i)
+					{
+						worlds[i] = ApplyHierarchy(*pos.current);
+					}
+					sink += worlds[n - 1][3][0];
+				});
+
+				auto scalar = TimePerPass(passes, [&]()
+				{
+					for (std::size_t i = 0; i < n; ++i)
+					{
+						auto p = hierarchy.parent(i);
+						worlds[i] = (p == hierarchy.npos ? glm::mat4(1) : worlds[p]) * hierarchy[i].transform;
+					}
+					sink += worlds[n - 1][3][0];
+				});
+
+				auto cached = TimePerPass(passes, [&]()
+				{
+					model.SetRootTransform(glm::mat4(1));
+					model.UpdateWorldTransforms();
+					sink += model.GetWorldTransform(n - 1)[3][0];
+				});
+
+				//Nodes at the same depth are independent, so each level is
+				//one batched multiply of gathered parent worlds by locals.
+				std::vector<std::vector<std::size_t>> levels;
+				std::vector<std::size_t> depths(n, 0);
+				for (std::size_t i = 0; i < n; ++i)
+				{
+					auto p = hierarchy.parent(i);
+					depths[i] = p == hierarchy.npos ? 0 : depths[p] + 1;
+					if (levels.size() <= depths[i]) levels.resize(depths[i] + 1);
+					levels[depths[i]].push_back(i);
+				}
+				std::vector<TransformsSoA> levelLocals;
+				for (const auto& level : levels)
+				{
+					levelLocals.emplace_back(level.size());
+					for (std::size_t j = 0; j < level.size(); ++j)
+					{
+						levelLocals.back().Set(j, hierarchy[level[j]].transform);
+					}
+				}
+				TransformsSoA parentWorlds;
+				TransformsSoA levelWorlds;
+
+				auto soa = TimePerPass(passes, [&]()
+				{
+					for (std::size_t l = 0; l < levels.size(); ++l)
+					{
+						const auto& level = levels[l];
+						parentWorlds.resize(level.size());
+						for (std::size_t j = 0; j < level.size(); ++j)
+						{
+							auto p = hierarchy.parent(level[j]);
+							parentWorlds.Set(j, p == hierarchy.npos ? glm::mat4(1) : worlds[p]);
+						}
+						MultiplyTransforms(parentWorlds, levelLocals[l], levelWorlds);
+						for (std::size_t j = 0; j < level.size(); ++j)
+						{
+							worlds[level[j]] = levelWorlds.Get(j);
+						}
+					}
+					sink += worlds[n - 1][3][0];
+				});
+
+				std::cout << "World transforms, " << n << " nodes (ms/pass):"
+					<< "\n\troot walk:        " << walk
+					<< "\n\tlinear glm:       " << scalar
+					<< "\n\tModel (SIMD):     " << cached
+					<< "\n\tSoA by level:     " << soa
+					<< "\n\t(checksum " << sink << ")\n";
+			}
+		}
+#else
+		void BenchmarkWorldTransforms()
+		{
+		}
+#endif
+	}
+}
@@ -0,0 +1,443 @@
+#include "VertexLayout.hpp"
+#include "MeshDataBuffer.hpp"
+#include "assimp/mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		//Size in bytes of one attribute of one vertex.
+		static GLuint SizeOfAttribute(GLenum type, GLint components)
+		{
+			switch (type)
+			{
+			default:
+				throw std::logic_error("Unsupported vertex attribute type: " + std::to_string(type));
+			case GL_FLOAT:
+				return components * sizeof(GLfloat);
+			case GL_HALF_FLOAT:
+				return components * sizeof(GLhalf);
+			case GL_SHORT:
+				return components * sizeof(GLshort);
+			case GL_UNSIGNED_BYTE:
+				return components * sizeof(GLubyte);
+			case GL_INT_2_10_10_10_REV:
+				return sizeof(GLuint);
+			}
+		}
+
+		static std::uint16_t FloatToHalf(float value)
+		{
+			std::uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+
+			std::uint32_t sign = (bits >> 16) & 0x8000u;
+			std::uint32_t mantissa = bits & 0x7fffffu;
+			std::int32_t exponent = std::int32_t((bits >> 23) & 0xffu) - 127 + 15;
+
+			if (((bits >> 23) & 0xffu) == 0xffu)
+			{
+				//Infinity or NaN.
+				return std::uint16_t(sign | 0x7c00u | (mantissa != 0 ? 0x200u : 0u));
+			}
+			if (exponent >= 0x1f)
+			{
+				return std::uint16_t(sign | 0x7c00u);
+			}
+			if (exponent <= 0)
+			{
+				//Too small for a normal half; produce a subnormal or zero.
+				if (exponent < -10)
+				{
+					return std::uint16_t(sign);
+				}
+				mantissa |= 0x800000u;
+				auto shift = std::uint32_t(14 - exponent);
+				auto half = mantissa >> shift;
+				if ((mantissa >> (shift - 1)) & 1u)
+				{
+					++half;
+				}
+				return std::uint16_t(sign | half);
+			}
+
+			//Rounding may carry into the exponent, which is still correct.
+			auto half = sign | (std::uint32_t(exponent) << 10) | (mantissa >> 13);
+			if (mantissa & 0x1000u)
+			{
+				++half;
+			}
+			return std::uint16_t(half);
+		}
+
+		static std::int32_t ToSnorm(float value, std::int32_t maxValue)
+		{
+			return std::int32_t(std::round(std::min(std::max(value, -1.0f), 1.0f) * maxValue));
+		}
+		static std::uint32_t ToUnorm(float value, std::uint32_t maxValue)
+		{
+			return std::uint32_t(std::round(std::min(std::max(value, 0.0f), 1.0f) * maxValue));
+		}
+
+		//Reads one attribute of one vertex from the source mesh as up to four floats.
+		static void FetchAttribute(const aiMesh* mesh, MeshSlots slot, unsigned int vertex, float* out)
+		{
+			auto copyVector = [out](const aiVector3D& v)
+			{
+				out[0] = v.x;
+				out[1] = v.y;
+				out[2] = v.z;
+				out[3] = 0.0f;
+			};
+
+			switch (slot)
+			{
+			default:
+				throw std::logic_error("Vertex attribute slot has no source in an imported mesh.");
+			case MeshSlots::Positions:
+				copyVector(mesh->mVertices[vertex]);
+				break;
+			case MeshSlots::Normals:
+				copyVector(mesh->mNormals[vertex]);
+				break;
+			case MeshSlots::Tangents:
+				copyVector(mesh->mTangents[vertex]);
+				break;
+			case MeshSlots::BiTangents:
+				copyVector(mesh->mBitangents[vertex]);
+				break;
+			case MeshSlots::TexCoord0:
+			case MeshSlots::TexCoord1:
+				copyVector(mesh->mTextureCoords[MeshSlotToGL(slot) - MeshSlotToGL(MeshSlots::TexCoord0)][vertex]);
+				break;
+			case MeshSlots::Colour0:
+			{
+				const auto& c = mesh->mColors[MeshSlotToGL(slot) - MeshSlotToGL(MeshSlots::Colour0)][vertex];
+				out[0] = c.r;
+				out[1] = c.g;
+				out[2] = c.b;
+				out[3] = c.a;
+				break;
+			}
+			}
+		}
+
+		static void EncodeAttribute(const aiMesh* mesh, const VertexAttributeLayout& attrib, unsigned int vertex, float* value)
+		{
+			switch (attrib.encoding)
+			{
+			case AttributeEncoding::Direct:
+				break;
+			case AttributeEncoding::Octahedral:
+			{
+				auto length = std::abs(value[0]) + std::abs(value[1]) + std::abs(value[2]);
+				if (length == 0.0f)
+				{
+					value[0] = value[1] = 0.0f;
+					break;
+				}
+				auto x = value[0] / length;
+				auto y = value[1] / length;
+				if (value[2] < 0.0f)
+				{
+					auto foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+					auto foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+					x = foldedX;
+					y = foldedY;
+				}
+				value[0] = x;
+				value[1] = y;
+				break;
+			}
+			case AttributeEncoding::SignedTangent:
+			{
+				const auto& n = mesh->mNormals[vertex];
+				const auto& b = mesh->mBitangents[vertex];
+				//Sign of dot(cross(n, t), b).
+				auto cx = n.y * value[2] - n.z * value[1];
+				auto cy = n.z * value[0] - n.x * value[2];
+				auto cz = n.x * value[1] - n.y * value[0];
+				value[3] = (cx * b.x + cy * b.y + cz * b.z) < 0.0f ? -1.0f : 1.0f;
+				break;
+			}
+			}
+		}
+
+		static void WriteAttribute(const VertexAttributeLayout& attrib, const float* value, unsigned char* dest)
+		{
+			switch (attrib.type)
+			{
+			default:
+				throw std::logic_error("Unsupported vertex attribute type: " + std::to_string(attrib.type));
+			case GL_FLOAT:
+				std::memcpy(dest, value, attrib.components * sizeof(GLfloat));
+				break;
+			case GL_HALF_FLOAT:
+				for (GLint i = 0; i < attrib.components; ++i)
+				{
+					auto half = FloatToHalf(value[i]);
+					std::memcpy(dest + i * sizeof(half), &half, sizeof(half));
+				}
+				break;
+			case GL_SHORT:
+				for (GLint i = 0; i < attrib.components; ++i)
+				{
+					auto packed = std::int16_t(ToSnorm(value[i], 32767));
+					std::memcpy(dest + i * sizeof(packed), &packed, sizeof(packed));
+				}
+				break;
+			case GL_UNSIGNED_BYTE:
+				for (GLint i = 0; i < attrib.components; ++i)
+				{
+					dest[i] = std::uint8_t(ToUnorm(value[i], 255));
+				}
+				break;
+			case GL_INT_2_10_10_10_REV:
+			{
+				auto packed = (std::uint32_t(ToSnorm(value[0], 511)) & 0x3ffu)
+					| ((std::uint32_t(ToSnorm(value[1], 511)) & 0x3ffu) << 10)
+					| ((std::uint32_t(ToSnorm(value[2], 511)) & 0x3ffu) << 20)
+					| ((std::uint32_t(ToSnorm(value[3], 1)) & 0x3u) << 30);
+				std::memcpy(dest, &packed, sizeof(packed));
+				break;
+			}
+			}
+		}
+
+		bool operator==(const VertexAttributeLayout& x, const VertexAttributeLayout& y) noexcept
+		{
+			return x.slot == y.slot
+				&& x.type == y.type
+				&& x.components == y.components
+				&& x.normalised == y.normalised
+				&& x.stream == y.stream
+				&& x.offset == y.offset
+				&& x.encoding == y.encoding;
+		}
+		bool operator!=(const VertexAttributeLayout& x, const VertexAttributeLayout& y) noexcept
+		{
+			return !(x == y);
+		}
+		bool operator==(const VertexLayout& x, const VertexLayout& y) noexcept
+		{
+			return x.attributes == y.attributes && x.streamStrides == y.streamStrides;
+		}
+		bool operator!=(const VertexLayout& x, const VertexLayout& y) noexcept
+		{
+			return !(x == y);
+		}
+
+		VertexLayout DeinterleavedLayout(const aiMesh* mesh)
+		{
+			VertexLayout layout;
+			auto addStream = [&layout](MeshSlots slot, GLint components)
+			{
+				layout.attributes.push_back({ slot, GL_FLOAT, components, GL_FALSE,
+					GLuint(layout.streamStrides.size()), 0 });
+				layout.streamStrides.push_back(GLsizei(components * sizeof(GLfloat)));
+			};
+
+			addStream(MeshSlots::Positions, 3);
+			if (mesh->HasNormals())
+			{
+				addStream(MeshSlots::Normals, 3);
+			}
+			if (mesh->HasTangentsAndBitangents())
+			{
+				addStream(MeshSlots::Tangents, 3);
+				addStream(MeshSlots::BiTangents, 3);
+			}
+			int uvChannelCount = std::min(static_cast<int>(mesh->GetNumUVChannels()), MaxTextureCoordinates);
+			for (int i = 0; i < uvChannelCount; ++i)
+			{
+				if (mesh->HasTextureCoords(i))
+				{
+					addStream(MeshSlots(MeshSlotToGL(MeshSlots::TexCoord0) + i), mesh->mNumUVComponents[i]);
+				}
+			}
+			int colourChannelCount = std::min(static_cast<int>(mesh->GetNumColorChannels()), MaxColourChannels);
+			for (int i = 0; i < colourChannelCount; ++i)
+			{
+				if (mesh->HasVertexColors(i))
+				{
+					addStream(MeshSlots(MeshSlotToGL(MeshSlots::Colour0) + i), 4);
+				}
+			}
+
+			return layout;
+		}
+
+		VertexLayout InterleavedLayout(const aiMesh* mesh, const VertexCompression& compression)
+		{
+			VertexLayout layout;
+			GLuint stride = 0;
+			auto addAttribute = [&layout, &stride](MeshSlots slot, GLenum type, GLint components, GLboolean normalised,
+				AttributeEncoding encoding = AttributeEncoding::Direct)
+			{
+				layout.attributes.push_back({ slot, type, components, normalised, 0, stride, encoding });
+				stride += (SizeOfAttribute(type, components) + 3) / 4 * 4;
+			};
+			auto addDirection = [&](MeshSlots slot, AttributeEncoding encoding)
+			{
+				switch (compression.normals)
+				{
+				case NormalEncoding::Float:
+					addAttribute(slot, GL_FLOAT, encoding == AttributeEncoding::SignedTangent ? 4 : 3, GL_FALSE, encoding);
+					break;
+				case NormalEncoding::Packed:
+					addAttribute(slot, GL_INT_2_10_10_10_REV, 4, GL_TRUE, encoding);
+					break;
+				case NormalEncoding::Octahedral:
+					//The tangent sign cannot ride along in two components.
+					if (encoding == AttributeEncoding::SignedTangent)
+					{
+						addAttribute(slot, GL_INT_2_10_10_10_REV, 4, GL_TRUE, encoding);
+					}
+					else
+					{
+						addAttribute(slot, GL_SHORT, 2, GL_TRUE, AttributeEncoding::Octahedral);
+					}
+					break;
+				}
+			};
+
+			addAttribute(MeshSlots::Positions, GL_FLOAT, 3, GL_FALSE);
+			if (mesh->HasNormals())
+			{
+				addDirection(MeshSlots::Normals, AttributeEncoding::Direct);
+			}
+			if (mesh->HasTangentsAndBitangents())
+			{
+				if (compression.bitangentSign && mesh->HasNormals())
+				{
+					addDirection(MeshSlots::Tangents, AttributeEncoding::SignedTangent);
+				}
+				else
+				{
+					addDirection(MeshSlots::Tangents, AttributeEncoding::Direct);
+					addDirection(MeshSlots::BiTangents, AttributeEncoding::Direct);
+				}
+			}
+			int uvChannelCount = std::min(static_cast<int>(mesh->GetNumUVChannels()), MaxTextureCoordinates);
+			for (int i = 0; i < uvChannelCount; ++i)
+			{
+				if (mesh->HasTextureCoords(i))
+				{
+					addAttribute(MeshSlots(MeshSlotToGL(MeshSlots::TexCoord0) + i),
+						compression.halfTexCoords ? GL_HALF_FLOAT : GL_FLOAT, mesh->mNumUVComponents[i], GL_FALSE);
+				}
+			}
+			int colourChannelCount = std::min(static_cast<int>(mesh->GetNumColorChannels()), MaxColourChannels);
+			for (int i = 0; i < colourChannelCount; ++i)
+			{
+				if (mesh->HasVertexColors(i))
+				{
+					auto slot = MeshSlots(MeshSlotToGL(MeshSlots::Colour0) + i);
+					if (compression.byteColours)
+					{
+						addAttribute(slot, GL_UNSIGNED_BYTE, 4, GL_TRUE);
+					}
+					else
+					{
+						addAttribute(slot, GL_FLOAT, 4, GL_FALSE);
+					}
+				}
+			}
+
+			layout.streamStrides.push_back(GLsizei(stride));
+			return layout;
+		}
+
+		PackedMeshView ViewOf(const PackedMesh& mesh)
+		{
+			PackedMeshView view;
+			view.layout = mesh.layout;
+			for (const auto& s : mesh.streams)
+			{
+				view.streams.push_back(s.data());
+			}
+			view.indices = mesh.indices.data();
+			view.indexDataType = IndexType::unsigned_int;
+			view.indexType = mesh.indexType;
+			view.vertexCount = mesh.vertexCount;
+			view.indexCount = static_cast<unsigned int>(mesh.indices.size());
+			view.vertsPerPrimitive = mesh.vertsPerPrimitive;
+			return view;
+		}
+		PackedMesh PackMesh(const aiMesh* mesh, const VertexLayout& layout)
+		{
+			if (!mesh->HasPositions() || !mesh->HasFaces())
+			{
+				throw std::runtime_error("Provided mesh has no positions or faces.");
+			}
+			if ((mesh->mPrimitiveTypes & aiPrimitiveType_POLYGON) != 0)
+			{
+				throw std::runtime_error("Provided mesh has unsupported primitive type.");
+			}
+
+			PackedMesh result;
+			result.layout = layout;
+			result.vertexCount = mesh->mNumVertices;
+			result.indexType = SmallestIndexType(mesh->mNumVertices);
+			result.vertsPerPrimitive = 3;
+			if ((mesh->mPrimitiveTypes & aiPrimitiveType_POINT) != 0)
+			{
+				result.vertsPerPrimitive = 1;
+			}
+			else if ((mesh->mPrimitiveTypes & aiPrimitiveType_LINE) != 0)
+			{
+				result.vertsPerPrimitive = 2;
+			}
+
+			result.streams.resize(layout.streamStrides.size());
+			for (std::size_t i = 0; i < result.streams.size(); ++i)
+			{
+				result.streams[i].resize(std::size_t(layout.streamStrides[i]) * mesh->mNumVertices);
+			}
+
+			for (const auto& attrib : layout.attributes)
+			{
+				if (attrib.offset + SizeOfAttribute(attrib.type, attrib.components) > GLuint(layout.streamStrides[attrib.stream]))
+				{
+					throw std::logic_error("Vertex attribute exceeds the stride of its stream.");
+				}
+
+				auto stride = layout.streamStrides[attrib.stream];
+				auto dest = result.streams[attrib.stream].data() + attrib.offset;
+				float value[4];
+				for (unsigned int v = 0; v < mesh->mNumVertices; ++v, dest += stride)
+				{
+					FetchAttribute(mesh, attrib.slot, v, value);
+					EncodeAttribute(mesh, attrib, v, value);
+					WriteAttribute(attrib, value, dest);
+				}
+			}
+
+			result.indices.reserve(std::size_t(mesh->mNumFaces) * result.vertsPerPrimitive);
+			for (unsigned int i = 0; i < mesh->mNumFaces; ++i)
+			{
+				const auto& face = mesh->mFaces[i];
+				result.indices.insert(result.indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
+			}
+
+			return result;
+		}
+
+		void BindVertexLayout(const VertexLayout& layout, const std::vector<MeshDataBuffer>& streams)
+		{
+			for (const auto& attrib : layout.attributes)
+			{
+				streams[attrib.stream].Bind();
+				Mesh::EnableAttribute(attrib.slot);
+				glVertexAttribPointer(MeshSlotToGL(attrib.slot), attrib.components, attrib.type, attrib.normalised,
+					layout.streamStrides[attrib.stream], reinterpret_cast<const void*>(std::size_t(attrib.offset)));
+			}
+		}
+	}
+}
@@ -1,11 +1,49 @@
 #version 430
+#extension GL_ARB_bindless_texture : enable
 
 in vec4 f_position;
 in vec4 f_normal;
+in vec2 f_uv;
+
+//The diffuse map is a region of one layer of an array texture, so
+//materials packed into the same array share its binding.
+#ifdef GL_ARB_bindless_texture
+//Entries are indexed by texture slot; the diffuse map is slot 0.
+struct material_texture
+{
+	uvec2 handle;
+	float layer;
+	vec4 region;
+};
+layout(std140) uniform material_block
+{
+	material_texture material_textures[12];
+};
+#else
+uniform sampler2DArray diffuse0_map;
+uniform vec4 diffuse0_map_region;
+uniform float diffuse0_map_layer;
+#endif
 
 out vec4 f_out;
 
+//Wraps 'uv' within the region. Gradients come from the unwrapped
+//coordinates, so the wrap does not pick the smallest mip level.
+vec4 SampleRegion(sampler2DArray map, vec4 region, float layer, vec2 uv)
+{
+	vec2 scaled = uv * region.zw;
+	vec3 coord = vec3(region.xy + fract(uv) * region.zw, layer);
+	return textureGrad(map, coord, dFdx(scaled), dFdy(scaled));
+}
+
 void main()
 {
-	f_out = vec4(f_normal.xyz, 1.0);
-}
\ No newline at end of file
+#ifdef GL_ARB_bindless_texture
+	material_texture map = material_textures[0];
+	vec4 diffuse = SampleRegion(sampler2DArray(map.handle), map.region, map.layer, f_uv);
+#else
+	vec4 diffuse = SampleRegion(diffuse0_map, diffuse0_map_region, diffuse0_map_layer, f_uv);
+#endif
+	float shade = 0.5 + 0.5 * abs(normalize(f_normal.xyz).z);
+	f_out = vec4(diffuse.rgb * shade, diffuse.a);
+}
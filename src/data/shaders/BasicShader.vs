@@ -2,15 +2,28 @@
 
 layout(location=0) in vec3 position;
 layout(location=1) in vec3 normal;
+layout(location=4) in vec2 uv0;
+layout(location=7) in mat4 instance_transform;
 
-layout(location=0) uniform mat4 mvp_transform;
+layout(std140) uniform camera_block
+{
+	mat4 v_transform;
+	mat4 p_transform;
+	mat4 vp_transform;
+	mat4 iv_transform;
+	mat4 ip_transform;
+	mat4 ivp_transform;
+};
 
 out vec4 f_position;
 out vec4 f_normal;
+out vec2 f_uv;
 
 void main()
 {
+	mat4 mvp_transform = vp_transform * instance_transform;
 	f_position = mvp_transform * vec4(position, 1);
 	f_normal = mvp_transform * vec4(normal, 0);
+	f_uv = uv0;
 	gl_Position = f_position;
 }
\ No newline at end of file
@@ -0,0 +1,36 @@
+#version 430
+#extension GL_ARB_shader_draw_parameters : require
+
+layout(location=0) in vec3 position;
+layout(location=1) in vec3 normal;
+layout(location=4) in vec2 uv0;
+
+layout(std140) uniform camera_block
+{
+	mat4 v_transform;
+	mat4 p_transform;
+	mat4 vp_transform;
+	mat4 iv_transform;
+	mat4 ip_transform;
+	mat4 ivp_transform;
+};
+
+//One model matrix per draw and instance, in the order the commands were
+//built; each command's base instance is the index of its first.
+layout(std430) readonly buffer transform_block
+{
+	mat4 m_transforms[];
+};
+
+out vec4 f_position;
+out vec4 f_normal;
+out vec2 f_uv;
+
+void main()
+{
+	mat4 mvp_transform = vp_transform * m_transforms[gl_BaseInstanceARB + gl_InstanceID];
+	f_position = mvp_transform * vec4(position, 1);
+	f_normal = mvp_transform * vec4(normal, 0);
+	f_uv = uv0;
+	gl_Position = f_position;
+}
\ No newline at end of file
@@ -1,12 +1,82 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <vector>
 
 namespace GlProj
 {
 	namespace Utilities
 	{
 		class AssetManager;
+		std::string NormalisePath(const std::string& path);
 
+		static const constexpr std::uint64_t FnvOffsetBasis = 0xcbf29ce484222325ull;
+
+		///64-bit FNV-1a. Pass a previous result as 'seed' to hash several
+		///pieces as one.
+		std::uint64_t HashBytes(const void* data, std::size_t size, std::uint64_t seed = FnvOffsetBasis) noexcept;
+		inline std::uint64_t HashString(const std::string& s, std::uint64_t seed = FnvOffsetBasis) noexcept
+		{
+			return HashBytes(s.data(), s.size(), seed);
+		}
+
+		///Opens, or creates, the asset database of the project directory
+		///'projectPath', making it the current project. Any project already
+		///open is closed first, saved if 'savePrevious' is set.
+		///Throws std::runtime_error if the database cannot be opened.
 		AssetManager* OpenProject(const char* projectPath, bool savePrevious = true);
+		///The current project, or null when none is open.
+		AssetManager* GetAssetManager() noexcept;
+		void CloseProject(bool save = true);
+		///Each call below that writes records commits them before it returns,
+		///so other connections see them at once. Saving checkpoints the
+		///write-ahead log into the database file.
+		void SaveProject(AssetManager*);
+
+		///The functions below may be called from any thread; calls are
+		///serialised. None of them may overlap OpenProject or CloseProject.
+
+		///Hash of the file's contents. The file is only read again when its
+		///size or modification time differ from those recorded with the
+		///last hash. False if the file cannot be read.
+		bool GetContentHash(AssetManager*, const std::string& path, std::uint64_t& hash);
+
+		///Identifies the output of importing contents with 'contentHash'
+		///using 'settings', an importer-defined description of its options.
+		std::uint64_t MakeArtifactKey(std::uint64_t contentHash, const std::string& settings) noexcept;
+		///Where a new artifact for 'key' should be written, inside the project.
+		std::string GetArtifactPath(const AssetManager*, std::uint64_t key, const char* extension);
+		///False if no artifact has been recorded for 'key'.
+		bool FindArtifact(AssetManager*, std::uint64_t key, std::string& path);
+		///Records that importing 'sourcePath' with 'settings' produced the
+		///artifact at 'artifactPath'.
+		void RecordImport(AssetManager*, const std::string& sourcePath, const std::string& settings,
+			std::uint64_t key, const std::string& artifactPath);
+
+		///Replaces the recorded dependencies of 'asset', e.g. the textures
+		///and shaders a material uses.
+		void SetDependencies(AssetManager*, const std::string& asset, const std::vector<std::string>& dependencies);
+		///Every asset recorded as depending on 'dependency'.
+		std::vector<std::string> GetDependents(AssetManager*, const std::string& dependency);
+
+		///Main thread only, as are the functions below.
+		///Makes 'asset' rebuildable: whenever one of its dependencies changes,
+		///'rebuild' is called, after those of any dependencies that are
+		///themselves rebuilt. Dependencies are source files, which are then
+		///watched, or the names of other assets, e.g.
+		///	shader files -> "program:Basic" -> "material:Default".
+		///Files are known by their NormalisePath spelling, so one named two
+		///ways is watched and depended on as one file.
+		///Replaces any earlier registration of 'asset'.
+		void RegisterRebuild(AssetManager*, const std::string& asset, const std::vector<std::string>& dependencies,
+			std::function<void()> rebuild);
+		void UnregisterRebuild(AssetManager*, const std::string& asset);
+		///Finds the watched sources whose contents changed and rebuilds what
+		///depends on them. An exception from a rebuild is reported, and
+		///skips the assets depending on it, rather than propagating.
+		///Returns the number of assets rebuilt.
+		std::size_t RebuildChanged(AssetManager*);
 	}
-}
\ No newline at end of file
+}
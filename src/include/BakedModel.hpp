@@ -0,0 +1,38 @@
+#pragma once
+#include "LinearSceneGraph.hpp"
+#include "MeshManager.hpp"
+#include "Model.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		struct ModelImportSettings;
+
+		//An imported model as it is written to disk: meshes already packed
+		//and optimised, and the node hierarchy in depth-first order.
+		struct BakedModel
+		{
+			std::vector<StagedMesh> meshes;
+			LinearSceneGraph<ModelData> hierarchy;
+		};
+
+		//Where the baked form of the model at 'sourcePath' is kept.
+		std::string BakedModelPath(const std::string& sourcePath);
+
+		//Records 'sourceKey', which identifies the version of the source
+		//baked, and the import settings, so a changed source or settings
+		//invalidate the bake. Throws on I/O failure.
+		void WriteBakedModel(const std::string& path, std::uint64_t sourceKey,
+			const ModelImportSettings&, const BakedModel&);
+		//Maps the file; the meshes read point straight into the mapping and
+		//keep it alive. False if the file is stale, from another format
+		//version or malformed; throws if it cannot be mapped, as when it
+		//is missing.
+		bool ReadBakedModel(const std::string& path, std::uint64_t sourceKey,
+			const ModelImportSettings&, BakedModel& out);
+	}
+}
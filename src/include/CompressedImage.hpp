@@ -0,0 +1,60 @@
+#pragma once
+#include "gl_core_4_5.h"
+#include "MappedFile.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		//S3TC formats (BC1-3). Universally supported on desktop, but an
+		//extension, so not in the generated loader.
+		static const constexpr GLenum GL_COMPRESSED_RGB_S3TC_DXT1 = 0x83F0;
+		static const constexpr GLenum GL_COMPRESSED_RGBA_S3TC_DXT1 = 0x83F1;
+		static const constexpr GLenum GL_COMPRESSED_RGBA_S3TC_DXT3 = 0x83F2;
+		static const constexpr GLenum GL_COMPRESSED_RGBA_S3TC_DXT5 = 0x83F3;
+		static const constexpr GLenum GL_COMPRESSED_SRGB_S3TC_DXT1 = 0x8C4C;
+		static const constexpr GLenum GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1 = 0x8C4D;
+		static const constexpr GLenum GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3 = 0x8C4E;
+		static const constexpr GLenum GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5 = 0x8C4F;
+
+		struct CompressedLevel
+		{
+			GLsizei width;
+			GLsizei height;
+			std::size_t offset;
+			std::size_t size;
+		};
+
+		//A 2D BCn image with its mip chain, as stored in a container file.
+		//The level data is read straight from a mapping of the file.
+		struct CompressedImage
+		{
+			std::shared_ptr<const Utilities::MappedFile> file;
+			GLenum internalFormat = GL_NONE;
+			GLsizei width = 0;
+			GLsizei height = 0;
+			//Largest first.
+			std::vector<CompressedLevel> levels;
+
+			const unsigned char* LevelData(std::size_t level) const noexcept
+			{
+				return file->Data() + levels[level].offset;
+			}
+		};
+
+		//Bytes per 4x4 block, or 0 if 'internalFormat' is not a BCn format.
+		std::size_t BlockSize(GLenum internalFormat) noexcept;
+		std::size_t CompressedLevelSize(GLenum internalFormat, GLsizei width, GLsizei height) noexcept;
+
+		//By extension: .dds, .ktx or .ktx2.
+		bool IsCompressedImageFile(const std::string& path);
+		//Reads DDS (including DX10 headers), KTX and KTX2 files holding a
+		//single 2D BC1-BC7 image. Throws std::runtime_error for anything
+		//else, including supercompressed KTX2.
+		CompressedImage ReadCompressedImage(const std::string& path);
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "MappedFile.hpp"
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace GlProj
+{
+	namespace Utilities
+	{
+		///Reports files that have been written since the last Poll. Uses
+		///inotify on Linux, where a Poll with nothing to report costs one
+		///read; elsewhere it compares each file's stamp, at most once per
+		///PollInterval.
+		class FileWatcher
+		{
+			//Watched files, as given to Watch.
+			std::unordered_set<std::string> files;
+#if defined(__linux__)
+			int inotify = -1;
+			std::unordered_map<std::string, int> directories;
+			std::unordered_map<int, std::string> watchedDirectories;
+#else
+			std::unordered_map<std::string, FileStamp> stamps;
+			std::chrono::steady_clock::time_point lastPoll;
+#endif
+		public:
+			static const constexpr std::chrono::milliseconds PollInterval{ 500 };
+
+			///Throws std::runtime_error if the platform watcher cannot start.
+			FileWatcher();
+			FileWatcher(const FileWatcher&) = delete;
+			FileWatcher& operator=(const FileWatcher&) = delete;
+			~FileWatcher();
+
+			///Files that are replaced, as many editors save, are still seen.
+			void Watch(const std::string& path);
+			bool IsWatched(const std::string& path) const;
+			///Watched files changed since the last call, each listed once.
+			///Never blocks.
+			std::vector<std::string> Poll();
+		};
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "gl_core_4_5.h"
+#include "SpscQueue.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct GLFWwindow;
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		class GpuUploader;
+
+		enum class UploadState
+		{
+			Pending,
+			Complete,
+			//The upload threw; see UploadFence::GetError.
+			Failed,
+		};
+
+		//Completion of one upload. Query from the render thread.
+		class UploadFence
+		{
+			friend class GpuUploader;
+			std::atomic<GLsync> sync{ nullptr };
+			std::atomic<bool> submitted{ false };
+			std::string error;
+			bool complete = false;
+		public:
+			UploadFence() = default;
+			UploadFence(const UploadFence&) = delete;
+			UploadFence& operator=(const UploadFence&) = delete;
+			~UploadFence();
+
+			//Does not block. True once the GPU has the data, or the upload failed.
+			bool IsComplete();
+			//Does not block. Distinguishes a failed upload from a finished one.
+			UploadState GetState();
+			//Blocks until IsComplete.
+			void Wait();
+			//Empty unless the upload failed. Valid once complete.
+			const std::string& GetError() const noexcept;
+		};
+
+		//Thread with a hidden context shared with the render context.
+		//Requests run there in order; each is followed by a fence, so the
+		//render thread can tell when the data may be used without stalling.
+		//Only objects shared between contexts may be touched: buffers and
+		//textures, but not vertex arrays or framebuffers.
+		class GpuUploader
+		{
+			struct Request
+			{
+				std::function<void()> upload;
+				std::shared_ptr<UploadFence> fence;
+			};
+
+			GLFWwindow* context = nullptr;
+			Utilities::SpscQueue<Request> requests;
+			std::mutex sleepMutex;
+			std::condition_variable wake;
+			std::atomic<bool> stopping{ false };
+			std::thread thread;
+
+			void ThreadLoop();
+		public:
+			static const constexpr std::size_t DefaultQueueCapacity = 1024;
+
+			//Must be constructed and destroyed on the main thread, as GLFW
+			//only creates windows there. 'shareWith' is the render context.
+			explicit GpuUploader(GLFWwindow* shareWith, std::size_t queueCapacity = DefaultQueueCapacity);
+			GpuUploader(const GpuUploader&) = delete;
+			GpuUploader& operator=(const GpuUploader&) = delete;
+			//Finishes every request already submitted.
+			~GpuUploader();
+
+			//Render thread only. 'upload' runs on the upload thread with its
+			//context current and may throw to report failure.
+			std::shared_ptr<UploadFence> Submit(std::function<void()> upload);
+		};
+	}
+}
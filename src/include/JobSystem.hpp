@@ -0,0 +1,139 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace GlProj
+{
+	namespace Utilities
+	{
+		class JobSystem;
+		struct Job;
+
+		///Counts the unfinished jobs started against it. Jobs that depend on
+		///others wait on their counter, which runs queued jobs meanwhile.
+		class JobCounter
+		{
+			friend class JobSystem;
+			std::atomic<int> pending{ 0 };
+		public:
+			JobCounter() = default;
+			JobCounter(const JobCounter&) = delete;
+			JobCounter& operator=(const JobCounter&) = delete;
+
+			bool IsDone() const noexcept
+			{
+				return pending.load(std::memory_order_acquire) == 0;
+			}
+		};
+
+		///Chase-Lev deque. The owning thread pushes and pops at the bottom,
+		///any other thread steals from the top. Fixed capacity; Push fails
+		///when full rather than growing.
+		class WorkStealingQueue
+		{
+			alignas(64) std::atomic<std::ptrdiff_t> top{ 0 };
+			alignas(64) std::atomic<std::ptrdiff_t> bottom{ 0 };
+			std::unique_ptr<std::atomic<Job*>[]> buffer;
+			std::ptrdiff_t mask;
+		public:
+			static const constexpr std::size_t DefaultCapacity = 4096;
+
+			///Capacity must be a power of two.
+			explicit WorkStealingQueue(std::size_t capacity = DefaultCapacity);
+			WorkStealingQueue(const WorkStealingQueue&) = delete;
+			WorkStealingQueue& operator=(const WorkStealingQueue&) = delete;
+
+			///Owner only.
+			bool Push(Job*) noexcept;
+			///Owner only. nullptr when empty.
+			Job* Pop() noexcept;
+			///Any thread. nullptr when empty or another thread won the race.
+			Job* Steal() noexcept;
+		};
+
+		///Work-stealing scheduler. Each worker, and the thread that created
+		///the system, owns a deque: jobs started from one of those threads
+		///go on its own deque and idle threads steal from the others.
+		///Jobs started from any other thread go through a shared queue.
+		///Jobs must not throw.
+		class JobSystem
+		{
+			std::vector<std::unique_ptr<WorkStealingQueue>> queues;
+			std::vector<std::thread> workers;
+
+			std::mutex injectedMutex;
+			std::deque<Job*> injected;
+			std::atomic<std::size_t> injectedCount{ 0 };
+
+			//Jobs that must run on the creating thread, e.g. GL calls.
+			std::thread::id mainThread;
+			std::mutex mainThreadMutex;
+			std::vector<Job*> mainThreadJobs;
+			std::atomic<std::size_t> mainThreadCount{ 0 };
+
+			std::mutex sleepMutex;
+			std::condition_variable wake;
+			std::atomic<unsigned int> sleepers{ 0 };
+			std::atomic<bool> stopping{ false };
+
+			void WorkerLoop(std::size_t);
+			std::size_t CurrentQueue() const noexcept;
+			bool RunOne(std::size_t);
+			void Enqueue(Job*);
+			void WaitUntil(const std::function<bool()>&);
+			static void Execute(Job*);
+		public:
+			static const constexpr std::size_t npos = std::size_t(-1);
+
+			///Defaults to one worker per hardware thread besides the caller's.
+			explicit JobSystem(unsigned int = DefaultWorkerCount());
+			JobSystem(const JobSystem&) = delete;
+			JobSystem& operator=(const JobSystem&) = delete;
+			///All started jobs should have been waited on beforehand.
+			~JobSystem();
+
+			static unsigned int DefaultWorkerCount() noexcept;
+			std::size_t WorkerCount() const noexcept;
+			bool IsMainThread() const noexcept;
+
+			///Queues 'f' to run on any thread. 'counter' may be null.
+			void Run(std::function<void()> f, JobCounter* counter = nullptr);
+			///Queues 'f' to run on the thread that created the system, during
+			///PumpMainThread or a Wait made on that thread.
+			void RunOnMainThread(std::function<void()> f, JobCounter* counter = nullptr);
+			///Main thread only. Runs every job queued by RunOnMainThread.
+			void PumpMainThread();
+
+			///Runs other jobs until every job started against 'counter' has
+			///finished. Safe to call from inside a job.
+			void Wait(const JobCounter& counter);
+			///As above, until 'f' is ready. Blocking on a future from the
+			///main thread would stall any main-thread jobs it depends on.
+			template<typename T>
+			void Wait(const std::future<T>& f)
+			{
+				WaitUntil([&f]()
+				{
+					return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+				});
+			}
+
+			///Calls f(i) for every i in [0, count) in chunks of 'grainSize'
+			///and returns once all calls have finished.
+			void ParallelFor(std::size_t count, const std::function<void(std::size_t)>& f, std::size_t grainSize = 1);
+		};
+
+		///Times the cost of scheduling an empty job and the scaling of a
+		///ParallelFor across worker counts.
+		void BenchmarkJobSystem();
+	}
+}
@@ -0,0 +1,306 @@
+#pragma once
+#include "SceneGraph.hpp"
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace GlProj
+{
+	namespace Utilities
+	{
+		///Scene graph stored as parallel arrays in depth-first order.
+		///A node's subtree is the contiguous range [n, n + subtree_size(n)),
+		///so traversal is a linear scan and skipping a subtree is O(1).
+		///Nodes are addressed by index; inserting or removing invalidates
+		///the indices of every node after the point of change.
+		///Requires T is Semi-regular
+		template<typename T>
+		class LinearSceneGraph
+		{
+		public:
+			using size_type = std::size_t;
+			using iterator = typename std::vector<T>::iterator;
+			using const_iterator = typename std::vector<T>::const_iterator;
+
+			static const constexpr size_type npos = size_type(-1);
+
+			LinearSceneGraph() noexcept = default;
+			///Flattens a pointer-based graph, preserving its depth-first order.
+			explicit LinearSceneGraph(const SceneGraph<T>& graph)
+			{
+				std::unordered_map<const SceneNode<T>*, size_type> indices;
+				for (auto it = graph.begin(); it != graph.end(); ++it)
+				{
+					auto parent = it.current->parent;
+					indices.emplace(it.current, values.size());
+					values.push_back(it.current->data);
+					parents.push_back(parent == nullptr ? npos : indices.at(parent));
+					subtreeSizes.push_back(1);
+				}
+				for (auto i = size(); i-- > 0;)
+				{
+					if (parents[i] != npos)
+					{
+						subtreeSizes[parents[i]] += subtreeSizes[i];
+					}
+				}
+			}
+
+			size_type size() const noexcept
+			{
+				return values.size();
+			}
+			bool empty() const noexcept
+			{
+				return values.empty();
+			}
+			void reserve(size_type count)
+			{
+				values.reserve(count);
+				parents.reserve(count);
+				subtreeSizes.reserve(count);
+			}
+			void clear() noexcept
+			{
+				values.clear();
+				parents.clear();
+				subtreeSizes.clear();
+			}
+
+			///Depth-first iteration over the node data.
+			iterator begin() noexcept
+			{
+				return values.begin();
+			}
+			const_iterator begin() const noexcept
+			{
+				return values.begin();
+			}
+			const_iterator cbegin() const noexcept
+			{
+				return begin();
+			}
+			iterator end() noexcept
+			{
+				return values.end();
+			}
+			const_iterator end() const noexcept
+			{
+				return values.end();
+			}
+			const_iterator cend() const noexcept
+			{
+				return end();
+			}
+
+			T& operator[](size_type n) noexcept
+			{
+				return values[n];
+			}
+			const T& operator[](size_type n) const noexcept
+			{
+				return values[n];
+			}
+
+			///npos for root nodes.
+			size_type parent(size_type n) const noexcept
+			{
+				return parents[n];
+			}
+			///Number of nodes in the subtree rooted at 'n', including 'n'.
+			size_type subtree_size(size_type n) const noexcept
+			{
+				return subtreeSizes[n];
+			}
+			///One past the last node of the subtree rooted at 'n'.
+			size_type subtree_end(size_type n) const noexcept
+			{
+				return n + subtreeSizes[n];
+			}
+			///npos if 'n' has no children.
+			size_type first_child(size_type n) const noexcept
+			{
+				return subtreeSizes[n] > 1 ? n + 1 : npos;
+			}
+			///npos if 'n' is the last child of its parent.
+			size_type next_sibling(size_type n) const noexcept
+			{
+				auto next = subtree_end(n);
+				auto limit = parents[n] == npos ? size() : subtree_end(parents[n]);
+				return next < limit ? next : npos;
+			}
+
+			template<typename U>
+			size_type find(const U& x) const
+			{
+				return find(x, std::equal_to<>());
+			}
+			template<typename U, typename C>
+			size_type find(const U& x, C c) const
+			{
+				return FindInRange(0, size(), x, c);
+			}
+
+			///Searches the descendants of 'p'. A 'p' of npos searches everything.
+			template<typename U>
+			size_type find_child(size_type p, const U& x) const
+			{
+				return find_child(p, x, std::equal_to<>());
+			}
+			template<typename U, typename C>
+			size_type find_child(size_type p, const U& x, C c) const
+			{
+				if (p == npos)
+				{
+					return find(x, c);
+				}
+				return FindInRange(p + 1, subtree_end(p), x, c);
+			}
+
+			template<typename U>
+			std::vector<size_type> find_all(const U& x) const
+			{
+				return find_all(x, std::equal_to<>());
+			}
+			template<typename U, typename C>
+			std::vector<size_type> find_all(const U& x, C c) const
+			{
+				std::vector<size_type> o;
+				find_all_cached(x, c, o);
+				return o;
+			}
+			template<typename U, typename C>
+			void find_all_cached(const U& x, C c, std::vector<size_type>& out) const
+			{
+				FindAllInRange(0, size(), x, c, out);
+			}
+
+			template<typename U, typename C>
+			std::vector<size_type> find_all_children(size_type p, const U& x, C c) const
+			{
+				std::vector<size_type> o;
+				find_all_children_cached(p, x, c, o);
+				return o;
+			}
+			template<typename U, typename C>
+			void find_all_children_cached(size_type p, const U& x, C c, std::vector<size_type>& out) const
+			{
+				if (p == npos)
+				{
+					find_all_cached(x, c, out);
+					return;
+				}
+				FindAllInRange(p + 1, subtree_end(p), x, c, out);
+			}
+
+			///Appends a node as the last child of 'parent', or as the last
+			///root when 'parent' is npos. Appending in depth-first order
+			///moves no existing nodes.
+			size_type insert(size_type parent, const T& data)
+			{
+				return emplace(parent, data);
+			}
+			size_type insert(size_type parent, T&& data)
+			{
+				return emplace(parent, std::move(data));
+			}
+			template<typename... Us>
+			size_type emplace(size_type parent, Us&&... args)
+			{
+				auto pos = parent == npos ? size() : subtree_end(parent);
+
+				values.emplace(values.begin() + pos, std::forward<Us>(args)...);
+				parents.insert(parents.begin() + pos, parent);
+				subtreeSizes.insert(subtreeSizes.begin() + pos, 1);
+
+				ShiftParents(pos + 1, pos, 1);
+				for (auto a = parent; a != npos; a = parents[a])
+				{
+					++subtreeSizes[a];
+				}
+
+				return pos;
+			}
+
+			///Removes 'n' and its entire subtree.
+			///Returns the parent of 'n', whose index is unaffected.
+			size_type remove(size_type n)
+			{
+				auto parent = parents[n];
+				auto count = subtreeSizes[n];
+
+				values.erase(values.begin() + n, values.begin() + n + count);
+				parents.erase(parents.begin() + n, parents.begin() + n + count);
+				subtreeSizes.erase(subtreeSizes.begin() + n, subtreeSizes.begin() + n + count);
+
+				for (auto a = parent; a != npos; a = parents[a])
+				{
+					subtreeSizes[a] -= count;
+				}
+				for (auto i = n; i < size(); ++i)
+				{
+					if (parents[i] != npos && parents[i] > n)
+					{
+						parents[i] -= count;
+					}
+				}
+
+				return parent;
+			}
+
+			bool verify_integrity() const;
+		private:
+			std::vector<T> values;
+			std::vector<size_type> parents;
+			std::vector<size_type> subtreeSizes;
+
+			template<typename U, typename C>
+			size_type FindInRange(size_type first, size_type last, const U& x, C& c) const
+			{
+				for (; first != last; ++first)
+				{
+					if (c(values[first], x)) return first;
+				}
+				return npos;
+			}
+			template<typename U, typename C>
+			void FindAllInRange(size_type first, size_type last, const U& x, C& c, std::vector<size_type>& out) const
+			{
+				for (; first != last; ++first)
+				{
+					if (c(values[first], x)) out.push_back(first);
+				}
+			}
+
+			///Offsets the parent index of nodes from 'first' onwards that
+			///refer to a node at or beyond 'threshold'.
+			void ShiftParents(size_type first, size_type threshold, size_type count) noexcept
+			{
+				for (auto i = first; i < size(); ++i)
+				{
+					if (parents[i] != npos && parents[i] >= threshold)
+					{
+						parents[i] += count;
+					}
+				}
+			}
+		};
+
+		void TestLinearSceneGraph();
+
+		template<typename T>
+		inline bool LinearSceneGraph<T>::verify_integrity() const
+		{
+			for (size_type i = 0; i < size(); ++i)
+			{
+				auto p = parents[i];
+				assert(p == npos || (p < i && i < subtree_end(p)));
+				assert(subtree_end(i) <= size());
+			}
+			return true;
+		}
+	}
+}
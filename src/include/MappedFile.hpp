@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace GlProj
+{
+	namespace Utilities
+	{
+		///Read-only view of a whole file, mapped into memory.
+		class MappedFile
+		{
+			const unsigned char* data = nullptr;
+			std::size_t size = 0;
+#if defined(_WIN32)
+			void* file = nullptr;
+			void* mapping = nullptr;
+#endif
+			void Close() noexcept;
+		public:
+			MappedFile() noexcept = default;
+			///Throws std::runtime_error if the file cannot be opened or mapped.
+			explicit MappedFile(const std::string& path);
+			MappedFile(const MappedFile&) = delete;
+			MappedFile(MappedFile&&) noexcept;
+			MappedFile& operator=(MappedFile&&) noexcept;
+			~MappedFile();
+
+			const unsigned char* Data() const noexcept;
+			std::size_t Size() const noexcept;
+		};
+
+		///Enough to tell whether a file has changed since it was last seen.
+		struct FileStamp
+		{
+			std::uint64_t size = 0;
+			///Last write time in the platform's finest units.
+			std::int64_t modified = 0;
+		};
+		inline bool operator==(const FileStamp& x, const FileStamp& y) noexcept
+		{
+			return x.size == y.size && x.modified == y.modified;
+		}
+		inline bool operator!=(const FileStamp& x, const FileStamp& y) noexcept
+		{
+			return !(x == y);
+		}
+
+		///False if the file does not exist.
+		bool GetFileStamp(const std::string& path, FileStamp& out);
+	}
+}
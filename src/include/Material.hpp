@@ -2,6 +2,12 @@
 #include "gl_core_4_5.h"
 #include "glm/fwd.hpp"
 #include "LocalSharedPtr.hpp"
+#include "MeshDataBuffer.hpp"
+#include "Texture.hpp"
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
 
 namespace GlProj
 {
@@ -9,7 +15,6 @@ namespace GlProj
 	{
 		struct Camera;
 		class ShadingProgram;
-		class Texture;
 		class Sampler;
 		struct UniformInformation;
 
@@ -26,22 +31,85 @@ namespace GlProj
 			User,
 		};
 
+		//The texture unit a slot binds to. Unit 0 is left to uploads and
+		//other binds through the active unit, which would otherwise undo
+		//the bindings Material tracks.
 		GLint TextureSlotToGL(TextureSlot s);
+		//The sampler uniform a slot is read through; its region and layer
+		//go in the uniforms of the same name suffixed "_region" and "_layer".
+		//Slots past User are named "user<n>_map".
+		std::string TextureSlotName(TextureSlot s);
+
+		//Slots held in the reserved material_block: the named slots and the
+		//first four past User. Later slots are bound to units and read
+		//through their sampler uniforms, even when the block is in use.
+		static const constexpr std::size_t MaterialBlockSlotCount = std::size_t(TextureSlot::User) + 4;
+
+		//One entry of the material_block, in its std140 layout:
+		//	struct material_texture { uvec2 handle; float layer; vec4 region; };
+		//	uniform material_block { material_texture material_textures[12]; };
+		//Entries are indexed by TextureSlot; unset slots hold a null handle,
+		//so shaders must sample only the slots their materials set.
+		struct MaterialBlockEntry
+		{
+			GLuint64 handle;
+			GLfloat layer;
+			GLfloat padding;
+			GLfloat region[4];
+		};
 
 		using GlProj::Utilities::LocalSharedPtr;
 
 		class Material
 		{
+			struct SlotBinding
+			{
+				TextureSlot slot;
+				LocalSharedPtr<Texture> texture;
+				LocalSharedPtr<Sampler> sampler;
+				TextureRegion region;
+				mutable GLint regionLocation = -1;
+				mutable GLint layerLocation = -1;
+			};
+
 			LocalSharedPtr<ShadingProgram> program;
-			
+			//Ordered by slot.
+			std::vector<SlotBinding> textures;
+			//The program the uniform locations above were looked up in.
+			mutable GLuint resolvedProgram = GLuint(-1);
+			//Created on the first bindless Bind; rewritten only on change.
+			mutable MeshDataBuffer textureBlock;
+			mutable std::array<MaterialBlockEntry, MaterialBlockSlotCount> uploadedBlock{};
+
+			void ResolveTextureUniforms() const;
+			void BindSlotToUnit(const SlotBinding&) const;
+			void BindTextureUnits() const;
+			void BindTextureBlock() const;
 		public:
 			Material() noexcept = default;
 			explicit Material(const LocalSharedPtr<ShadingProgram>&);
 
 			Material& operator=(const LocalSharedPtr<ShadingProgram>&);
 
+			//Programs declaring the material_block get resident bindless
+			//handles through it when GL_ARB_bindless_texture is present, so
+			//no texture binds are made however many textures are used. Shaders
+			//should declare the block only under #ifdef GL_ARB_bindless_texture
+			//and otherwise use the slots' sampler uniforms, which are bound to
+			//units. Binds of textures and samplers already on their units are
+			//skipped, so materials sharing an array texture switch without
+			//rebinding it. Textures still uploading are drawn as the texture
+			//manager's placeholder of the same type (see
+			//GetPlaceholderTexture), so a draw never samples a null handle.
 			void Bind() const;
 			const ShadingProgram* GetProgram() const noexcept;
+
+			//'region' locates the image within 'texture' when it was packed;
+			//see PackTextureArray.
+			void SetTexture(TextureSlot, const LocalSharedPtr<Texture>&, const TextureRegion& = TextureRegion{},
+				const LocalSharedPtr<Sampler>& = nullptr);
+			void ClearTexture(TextureSlot);
+			const Texture* GetTexture(TextureSlot) const noexcept;
 			
 			void SetUniform(const UniformInformation&, GLint);
 			void SetUniform(const UniformInformation&, GLuint);
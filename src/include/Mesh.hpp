@@ -3,6 +3,9 @@
 #include "MeshDataBuffer.hpp"
 #include "MeshIndexBuffer.hpp"
 #include "MeshArrayBuffer.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
 #include <vector>
 
 struct aiMesh;
@@ -29,6 +32,14 @@ namespace GlProj
 		static const constexpr int MaxTextureCoordinates = 2;
 		static const constexpr int MaxColourChannels = 1;
 		static const constexpr int MaxColorChannels = MaxColourChannels;
+		//First of the four consecutive slots holding a per-instance model matrix.
+		static const constexpr MeshSlots InstanceTransformSlot = MeshSlots::User;
+
+		class GpuUploader;
+		class MeshArena;
+		class UploadFence;
+		enum class UploadState;
+		struct PackedMeshView;
 
 		class Mesh
 		{
@@ -37,6 +48,17 @@ namespace GlProj
 			MeshArrayBuffer arrayBuffer;
 			unsigned int primitiveCount;
 			unsigned int vertsPerPrimitive;
+			IndexType indexType = IndexType::unsigned_int;
+			//When set, the vertex and index data live in a shared arena
+			//and the members above are left empty.
+			MeshArena* arena = nullptr;
+			GLint baseVertex = 0;
+			GLuint firstIndex = 0;
+			GLuint vertexCount = 0;
+			//Set while the arena range may still be being written.
+			std::shared_ptr<UploadFence> upload;
+
+			void ReleaseArenaRange() noexcept;
 
 			static const constexpr int ReservedVertexSlots = 16;
 
@@ -44,13 +66,19 @@ namespace GlProj
 		public:
 			Mesh() = default;
 			explicit Mesh(const aiMesh*);
+			Mesh(MeshArena&, const PackedMeshView&);
+			//Copies the data into the arena on the upload thread, keeping
+			//'owner' alive until then. The mesh must not be drawn until IsReady.
+			Mesh(MeshArena&, const PackedMeshView&, std::shared_ptr<const void> owner, GpuUploader&);
 			Mesh(const Mesh&) = delete;
-			Mesh(Mesh&&) = default;
-			Mesh& operator=(Mesh&&) = default;
+			Mesh(Mesh&&) noexcept;
+			Mesh& operator=(Mesh&&) noexcept;
+			~Mesh();
 
 			static void EnableAttribute(MeshSlots);
 			static void DisableAttribute(MeshSlots);
 			static void SetAttributePointer(MeshSlots, const MeshDataBuffer&, GLsizei = 0, const void* = nullptr);
+			static void SetAttributePointer(MeshSlots, GLint, GLenum, GLsizei = 0, const void* = nullptr);
 			static void SetAttributeDivisor(MeshSlots, GLuint);
 
 			//Searches through the internal vertex data for a range of empty slots
@@ -59,7 +87,14 @@ namespace GlProj
 			int FindAttributeRange(int, int = 0);
 
 			const MeshDataBuffer& GetMeshData(MeshSlots) const;
+			const MeshArrayBuffer& GetArrayBuffer() const noexcept;
 			void Bind() const noexcept;
+			//True once the data may be drawn; false while uploading or if
+			//the upload failed.
+			bool IsReady() const;
+			UploadState GetUploadState() const;
+			//Empty unless the upload failed.
+			std::string GetUploadError() const;
 			unsigned int PrimitiveCount()const noexcept
 			{
 				return primitiveCount;
@@ -68,6 +103,25 @@ namespace GlProj
 			{
 				return vertsPerPrimitive;
 			}
+			//Offset added to each index when drawing from a shared arena.
+			GLint BaseVertex() const noexcept
+			{
+				return baseVertex;
+			}
+			//First element of this mesh in the bound index buffer.
+			GLuint FirstIndex() const noexcept
+			{
+				return firstIndex;
+			}
+			IndexType GetIndexType() const noexcept
+			{
+				return indexType;
+			}
+			//FirstIndex as a byte offset, for the glDrawElements family.
+			const void* IndexOffset() const noexcept
+			{
+				return reinterpret_cast<const void*>(std::size_t(firstIndex) * SizeOfIndex(indexType));
+			}
 
 			friend bool operator==(const Mesh&, const Mesh&) noexcept;
 			friend bool operator!=(const Mesh&, const Mesh&) noexcept;
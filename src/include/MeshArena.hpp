@@ -0,0 +1,79 @@
+#pragma once
+#include "gl_core_4_5.h"
+#include "MeshArrayBuffer.hpp"
+#include "MeshDataBuffer.hpp"
+#include "MeshIndexBuffer.hpp"
+#include "VertexLayout.hpp"
+#include <utility>
+#include <vector>
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		//First-fit free-list allocator over a range of elements.
+		//Freed ranges are coalesced with their neighbours.
+		class RangeAllocator
+		{
+			//Sorted by offset; pairs of (offset, count).
+			std::vector<std::pair<GLsizeiptr, GLsizeiptr>> freeRanges;
+			GLsizeiptr capacity = 0;
+		public:
+			static const constexpr GLsizeiptr invalidOffset = GLsizeiptr(-1);
+
+			RangeAllocator() noexcept = default;
+			explicit RangeAllocator(GLsizeiptr);
+
+			GLsizeiptr Capacity() const noexcept;
+			bool CanAllocate(GLsizeiptr) const noexcept;
+			//Returns invalidOffset if no free range is large enough.
+			GLsizeiptr Allocate(GLsizeiptr);
+			void Free(GLsizeiptr, GLsizeiptr);
+		};
+
+		struct MeshArenaRange
+		{
+			GLint baseVertex = 0;
+			GLuint firstIndex = 0;
+			GLuint vertexCount = 0;
+			GLuint indexCount = 0;
+		};
+
+		//Packs the vertex streams and indices of many meshes sharing one
+		//VertexLayout into a few large buffers behind a single vertex array.
+		class MeshArena
+		{
+			VertexLayout layout;
+			std::vector<MeshDataBuffer> streams;
+			MeshIndexBuffer indices;
+			MeshArrayBuffer arrayBuffer;
+			IndexType indexType;
+			RangeAllocator vertexRanges;
+			RangeAllocator indexRanges;
+		public:
+			static const constexpr GLsizeiptr DefaultVertexCapacity = GLsizeiptr(1) << 20;
+			static const constexpr GLsizeiptr DefaultIndexCapacity = GLsizeiptr(1) << 22;
+
+			MeshArena(const VertexLayout&, IndexType, GLsizeiptr = DefaultVertexCapacity, GLsizeiptr = DefaultIndexCapacity);
+			MeshArena(const MeshArena&) = delete;
+			MeshArena(MeshArena&&) = default;
+			MeshArena& operator=(MeshArena&&) = default;
+
+			const VertexLayout& GetLayout() const noexcept;
+			IndexType GetIndexType() const noexcept;
+			const MeshArrayBuffer& GetArrayBuffer() const noexcept;
+			bool CanFit(const PackedMeshView&) const noexcept;
+
+			//Copies the mesh into free space. Throws if it does not fit.
+			MeshArenaRange Allocate(const PackedMeshView&);
+			//Claims space for the mesh without copying it in.
+			MeshArenaRange Reserve(const PackedMeshView&);
+			//Copies the mesh into space from Reserve. Binds nothing, so it
+			//may run on any context sharing the arena's buffers.
+			void Upload(const MeshArenaRange&, const PackedMeshView&) const;
+			void Free(const MeshArenaRange&);
+
+			void Bind() const noexcept;
+		};
+	}
+}
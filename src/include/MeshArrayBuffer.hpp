@@ -1,5 +1,6 @@
 #pragma once
 #include "gl_core_4_5.h"
+#include <cstddef>
 
 namespace GlProj
 {
@@ -15,6 +16,8 @@ namespace GlProj
 			friend bool operator!=(const MeshArrayBuffer&, const MeshArrayBuffer&) noexcept;
 
 			MeshArrayBuffer() noexcept;
+			//Holds no vertex array, for meshes drawing through a shared one.
+			explicit MeshArrayBuffer(std::nullptr_t) noexcept;
 			MeshArrayBuffer(const MeshArrayBuffer&) = delete;
 			MeshArrayBuffer(MeshArrayBuffer&&) noexcept;
 			MeshArrayBuffer& operator=(MeshArrayBuffer&&) noexcept;
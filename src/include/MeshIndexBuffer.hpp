@@ -7,9 +7,20 @@ namespace GlProj
 {
 	namespace Graphics
 	{
+		enum class IndexType : GLenum
+		{
+			unsigned_short = GL_UNSIGNED_SHORT,
+			unsigned_int = GL_UNSIGNED_INT,
+		};
+
+		//The narrowest index type able to address 'vertexCount' vertices.
+		IndexType SmallestIndexType(GLsizeiptr vertexCount) noexcept;
+		GLsizeiptr SizeOfIndex(IndexType) noexcept;
+
 		class MeshIndexBuffer
 		{
 			GLuint indexDataHandle = invalidHandle;
+			IndexType indexType = IndexType::unsigned_int;
 		public:
 			static const constexpr GLuint invalidHandle = GLuint(-1);
 
@@ -19,6 +30,8 @@ namespace GlProj
 			MeshIndexBuffer() noexcept = default;
 			MeshIndexBuffer(const MeshIndexBuffer&) = delete;
 			MeshIndexBuffer(GLsizeiptr, const GLvoid*, GLenum = GL_STATIC_DRAW);
+			MeshIndexBuffer(GLsizeiptr, const GLvoid*, IndexType, GLenum = GL_STATIC_DRAW);
+			//Uses 16-bit indices when every face index fits.
 			MeshIndexBuffer(GLsizeiptr, const aiFace*, GLenum = GL_STATIC_DRAW);
 			MeshIndexBuffer(MeshIndexBuffer&&) noexcept;
 			MeshIndexBuffer& operator=(MeshIndexBuffer&&) noexcept;
@@ -26,6 +39,7 @@ namespace GlProj
 
 			GLuint GetHandle() const noexcept;
 			GLenum GetType() const noexcept;
+			IndexType GetIndexType() const noexcept;
 
 			void UpdateData(GLintptr, GLsizeiptr, const GLvoid*) const noexcept;
 			void* MapBuffer(GLintptr, GLsizeiptr, GLbitfield) const noexcept;
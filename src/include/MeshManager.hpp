@@ -1,5 +1,8 @@
 #pragma once
 #include "LocalSharedPtr.hpp"
+#include "MeshOptimisation.hpp"
+#include "VertexLayout.hpp"
+#include <memory>
 #include <string>
 
 struct aiMesh;
@@ -8,6 +11,7 @@ namespace GlProj
 {
 	namespace Graphics
 	{
+		class GpuUploader;
 		class MeshManager;
 		class Mesh;
 
@@ -15,10 +19,33 @@ namespace GlProj
 		
 		MeshManager* GetMeshManager();
 
+		//A mesh packed and optimised ahead of upload.
+		struct StagedMesh
+		{
+			std::string name;
+			//Keeps alive whatever 'view' points into: a PackedMesh, or a
+			//mapped baked model file.
+			std::shared_ptr<const void> owner;
+			PackedMeshView view;
+			MeshOptimisationReport report;
+		};
+
+		//Touches no GL or manager state, so may be called from any thread.
+		StagedMesh StageMesh(const aiMesh*, const std::string&);
+
 		LocalSharedPtr<Mesh> RegisterMesh(MeshManager*, aiMesh*, const std::string&, bool = false);
+		//Uploads a mesh staged earlier. Must be called from the context thread.
+		LocalSharedPtr<Mesh> RegisterMesh(MeshManager*, StagedMesh&&, bool = false);
+		//As above, but the copy into GPU memory happens on the upload
+		//thread. Check Mesh::IsReady before drawing the result.
+		LocalSharedPtr<Mesh> RegisterMesh(MeshManager*, GpuUploader&, StagedMesh&&, bool = false);
 
 		LocalSharedPtr<Mesh> FindCachedMeshByName(const MeshManager*, const std::string&);
 
 		void ReleaseUnused(MeshManager*);
+
+		//Vertex cache efficiency of every mesh registered so far, weighted
+		//by triangle count.
+		MeshOptimisationReport GetOptimisationReport(const MeshManager*);
 	}
 }
\ No newline at end of file
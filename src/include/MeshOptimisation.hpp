@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		struct PackedMesh;
+
+		static const constexpr unsigned int DefaultVertexCacheSize = 16;
+
+		//Average cache miss ratio: post-transform cache misses per triangle
+		//for a FIFO cache of 'cacheSize' entries. 0.5 is the ideal for a
+		//regular grid, 3 means no reuse at all.
+		float AverageCacheMissRatio(const std::vector<unsigned int>& indices, unsigned int vertexCount,
+			unsigned int cacheSize = DefaultVertexCacheSize);
+
+		//Reorders triangles to improve post-transform cache reuse, using
+		//Tom Forsyth's linear-speed vertex cache optimisation.
+		//Degenerate triangles are removed.
+		void OptimiseVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount);
+
+		//Reorders vertices into the order they are first referenced by the
+		//indices, so fetches walk memory sequentially. Unreferenced vertices
+		//are dropped.
+		void OptimiseVertexFetch(PackedMesh&);
+
+		struct MeshOptimisationReport
+		{
+			unsigned int triangleCount = 0;
+			float acmrBefore = 0.0f;
+			float acmrAfter = 0.0f;
+		};
+
+		//Applies both optimisations to a triangle mesh. Other primitive
+		//types are left untouched.
+		MeshOptimisationReport OptimiseMesh(PackedMesh&);
+	}
+}
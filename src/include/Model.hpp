@@ -1,19 +1,27 @@
 #pragma once
 #include "glm/mat4x4.hpp"
+#include "LinearSceneGraph.hpp"
 #include "LocalSharedPtr.hpp"
 #include "SceneGraph.hpp"
+#include "TransformKernels.hpp"
 #include <string>
 #include <utility>
 #include <vector>
 
 namespace GlProj
 {
+	namespace Utilities
+	{
+		class JobSystem;
+	}
 	namespace Graphics
 	{
 		struct Camera;
 		class Mesh;
 		class Material;
+		enum class UploadState;
 		using GlProj::Utilities::LocalSharedPtr;
+		using GlProj::Utilities::LinearSceneGraph;
 		using GlProj::Utilities::SceneGraph;
 
 		struct ModelData
@@ -21,6 +29,7 @@ namespace GlProj
 			ModelData() = default;
 			ModelData(const glm::mat4&, std::vector<unsigned int>&&, std::string&&);
 
+			//Relative to the parent node.
 			glm::mat4 transform;
 			std::vector<unsigned int> meshes;
 			std::string name;
@@ -44,19 +53,73 @@ namespace GlProj
 
 		class Model
 		{
+		public:
+			using node_index = LinearSceneGraph<ModelData>::size_type;
+		private:
 			std::vector<Renderable> submeshes;
-			SceneGraph<ModelData> hierarchy;
-			using hierarchy_node = SceneGraph<ModelData>::node_type;
+			//Depth-first, so each parent precedes its children.
+			LinearSceneGraph<ModelData> hierarchy;
+			std::vector<glm::mat4> worldTransforms;
+			//char rather than bool, so workers may clear flags of
+			//different nodes at the same time.
+			std::vector<char> dirtyNodes;
+			//Distance of each node from its root.
+			std::vector<node_index> nodeDepths;
+			std::vector<node_index> updatedNodes;
+			//Per-depth gather space for the batched multiply.
+			struct TransformScratch
+			{
+				std::vector<std::vector<node_index>> levels;
+				TransformsSoA parents;
+				TransformsSoA locals;
+				TransformsSoA worlds;
+			};
+			TransformScratch scratch;
+			//Scratch for the parallel update, kept to avoid reallocating.
+			std::vector<node_index> taskRoots;
+			std::vector<std::vector<node_index>> taskUpdates;
+			std::vector<TransformScratch> taskScratch;
+			glm::mat4 rootTransform = glm::mat4(1);
+			bool anyDirty = false;
 
 		public:
 			Model() = default;
-			Model(const std::vector<Renderable>&, SceneGraph<ModelData>&&);
+			Model(const std::vector<Renderable>&, const SceneGraph<ModelData>&);
+			Model(const std::vector<Renderable>&, LinearSceneGraph<ModelData>&&);
 
-			const SceneGraph<ModelData>& GetHierarchy() const
+			const LinearSceneGraph<ModelData>& GetHierarchy() const
 			{
 				return hierarchy;
 			}
+			const std::vector<Renderable>& GetRenderables() const
+			{
+				return submeshes;
+			}
+			//False while any mesh is still being uploaded, or if one failed.
+			bool IsReady() const;
+			//Failed if any mesh failed, else Pending while any is uploading.
+			UploadState GetUploadState() const;
+			//The first failed mesh's error; empty if none failed.
+			std::string GetUploadError() const;
+
+			//Transform applied above every root node.
+			void SetRootTransform(const glm::mat4&);
+			const glm::mat4& GetRootTransform() const noexcept;
+			void SetLocalTransform(node_index, const glm::mat4&);
+			const glm::mat4& GetLocalTransform(node_index) const noexcept;
+			//Valid as of the last call to UpdateWorldTransforms.
+			const glm::mat4& GetWorldTransform(node_index) const noexcept;
 
+			//Recomputes world transforms of every dirty subtree, a depth
+			//level at a time through the SoA kernel. Returns the nodes
+			//whose world transform changed, parents before children.
+			const std::vector<node_index>& UpdateWorldTransforms();
+			//As above, but the subtrees below each root node are updated
+			//as parallel jobs. The result is in the same order.
+			const std::vector<node_index>& UpdateWorldTransforms(Utilities::JobSystem&);
+		private:
+			void ComputeDepths();
+			void UpdateRange(node_index, node_index, std::vector<node_index>&, TransformScratch&);
 		};
 	}
 }
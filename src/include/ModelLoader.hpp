@@ -0,0 +1,41 @@
+#pragma once
+#include "Model.hpp"
+#include <future>
+#include <string>
+
+namespace GlProj
+{
+	namespace Utilities
+	{
+		class JobSystem;
+	}
+	namespace Graphics
+	{
+		class GpuUploader;
+
+		struct ModelImportSettings
+		{
+			//Larger meshes are split, so most fit 16-bit indices.
+			int splitTriangleLimit = 0xfffff;
+			int splitVertexLimit = 0xffff;
+			//Reuse the packed meshes and hierarchy saved by an earlier import,
+			//and save them after a fresh one. Saved in the current project
+			//when one is open, or beside the source otherwise.
+			bool useBakedCache = true;
+			//Register the meshes under their names even if meshes of those
+			//names are cached, as a re-import of a changed source must.
+			bool replaceMeshes = false;
+		};
+
+		//Imports a model as jobs. Parsing, post-processing and packing of
+		//each mesh run on workers; only the upload runs on the main thread,
+		//during JobSystem::PumpMainThread or a JobSystem::Wait made there.
+		//Wait on the result with JobSystem::Wait rather than future::get.
+		//Given an uploader, the mesh data is copied to the GPU there, and
+		//the model may be ready before its meshes are; see Model::IsReady.
+		//A current bake skips the import entirely: the mesh data is read
+		//from a mapping of the file, with no parsing or copying beforehand.
+		std::future<Model> LoadModelAsync(Utilities::JobSystem&, const std::string& path,
+			const ModelImportSettings& = ModelImportSettings(), GpuUploader* = nullptr);
+	}
+}
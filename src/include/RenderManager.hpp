@@ -32,11 +32,25 @@ namespace GlProj
 			PostProcess,
 		};
 
+		enum class BatchSubmission : int
+		{
+			//One draw call per handle, or per mesh for instancing programs.
+			Direct,
+			//One glMultiDrawElementsIndirect per material and vertex array.
+			//Drawn as Direct where MultiDrawIndirectSupported is false.
+			MultiDrawIndirect,
+		};
+
+		//Programs index the reserved transform_block by gl_BaseInstanceARB,
+		//which needs GL_ARB_shader_draw_parameters; see IndirectShader.vs.
+		bool MultiDrawIndirectSupported();
+
 		RenderManager* GetRenderManager();
 		local_shared_ptr<RenderBatch> GenerateRenderBatch(RenderManager*, BatchType = BatchType::Opaque,
 										 int priority = 0,
 										 bool groupMaterials = true,
-										 bool groupMeshes = true);
+										 bool groupMeshes = true,
+										 BatchSubmission = BatchSubmission::Direct);
 		Material* SetOverrideMaterial(RenderBatch*,  Material*);
 
 		void UpdateBatchCamera(RenderBatch*, const Camera&);
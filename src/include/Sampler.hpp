@@ -1,5 +1,6 @@
 #pragma once
 #include "gl_core_4_5.h"
+#include <cstdint>
 
 namespace GlProj
 {
@@ -8,6 +9,7 @@ namespace GlProj
 		class Sampler
 		{
 			GLuint samplerHandle = invalidHandle;
+			std::uint64_t samplerId = 0;
 		public:
 			static const constexpr GLuint invalidHandle = GLuint(-1);
 
@@ -21,8 +23,14 @@ namespace GlProj
 			~Sampler();
 
 			GLuint GetHandle() const noexcept;
+			//Unlike the GL name, which is reused once deleted, never repeats
+			//while the program runs. 0 for a moved-from sampler.
+			std::uint64_t GetId() const noexcept;
 
 			void Bind(GLuint) const noexcept;
+			//As Bind, but skipped if the unit already holds this sampler from
+			//an earlier BindToUnit.
+			void BindToUnit(GLuint) const noexcept;
 
 			template<typename T>
 			void GetParameter(GLenum, T&);
@@ -31,5 +39,8 @@ namespace GlProj
 			template<typename T>
 			void SetParameter(GLenum, T);
 		};
+
+		//Clears a unit bound with Sampler::BindToUnit.
+		void UnbindSamplerUnit(GLuint) noexcept;
 	}
 }
\ No newline at end of file
@@ -1,13 +1,18 @@
 #pragma once
 #include "gl_core_4_5.h"
 #include "LocalSharedPtr.hpp"
+#include <cstddef>
+#include <cstdint>
 #include <initializer_list>
 #include <string>
+#include <vector>
 
 namespace GlProj
 {
 	namespace Utilities
 	{
+		class AssetManager;
+
 		std::string NormalisePath(const std::string& path);
 	}
 	namespace Graphics
@@ -28,6 +33,80 @@ namespace GlProj
 
 		void ReleaseUnused(ShaderManager*);
 
+		struct ShaderStage
+		{
+			GLenum type;
+			std::string path;
+		};
+
+		//Compiles and links the stages into a new program, with each of
+		//'defines' ("NAME" or "NAME value") inserted after #version. With
+		//a project open, the linked binary is cached there, keyed by the
+		//sources, defines and driver, and later loads restore it instead.
+		LocalSharedPtr<ShadingProgram> LoadProgram(ShaderManager*, std::initializer_list<ShaderStage>,
+			const std::vector<std::string>& defines = {});
+
+		//Builds many programs, as LoadProgram does, without waiting on each
+		//in turn. Submit issues every compile and cache restore before any
+		//result is asked for. With GL_KHR_parallel_shader_compile the
+		//driver works on them on its own threads and Poll never blocks.
+		//Without it, Poll still only queries work issued by an earlier
+		//call, so the driver can pipeline each stage. Main thread only.
+		class ProgramBatch
+		{
+			enum class State
+			{
+				Pending,
+				Restoring,
+				Compiling,
+				Linking,
+				Done,
+				Failed,
+			};
+			struct Entry
+			{
+				std::vector<ShaderStage> stages;
+				std::vector<std::string> sources;
+				std::vector<GLuint> shaders;
+				std::uint64_t key = 0;
+				LocalSharedPtr<ShadingProgram> program;
+				std::string error;
+				State state = State::Pending;
+				unsigned int issuedAt = 0;
+			};
+
+			std::vector<Entry> entries;
+			Utilities::AssetManager* assets = nullptr;
+			std::size_t remaining = 0;
+			unsigned int polls = 0;
+			bool submitted = false;
+			bool parallel = false;
+
+			void StartCompile(Entry&);
+			void Fail(Entry&, std::string);
+			static void DeleteShaders(Entry&);
+		public:
+			ProgramBatch() = default;
+			ProgramBatch(const ProgramBatch&) = delete;
+			ProgramBatch& operator=(const ProgramBatch&) = delete;
+			~ProgramBatch();
+
+			//Reads the sources now; throws if one cannot be read. Returns
+			//the index to Get the program by.
+			std::size_t Add(std::initializer_list<ShaderStage>, const std::vector<std::string>& defines = {});
+			void Submit();
+			//Advances every program as far as it can. True once all are
+			//built or have failed.
+			bool Poll();
+			//Submits if needed and polls until everything is finished.
+			void Wait();
+
+			bool IsDone(std::size_t) const;
+			//Throws std::runtime_error with the compile or link log if the
+			//program failed to build.
+			LocalSharedPtr<ShadingProgram> Get(std::size_t) const;
+		};
+
 		LocalSharedPtr<ShadingProgram> GenerateProgram();
 		void AttachShader(ShadingProgram*, Shader*);
 		void DetachShader(ShadingProgram*, Shader*);
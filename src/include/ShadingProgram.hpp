@@ -1,5 +1,7 @@
 #pragma once
 #include "gl_core_4_5.h"
+#include <array>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <utility>
@@ -28,6 +30,45 @@ namespace GlProj
 			GLint size;
 		};
 
+		//Transform uniforms from "Reserved Shader Identifiers.txt", resolved
+		//once per program so per-draw updates need no name lookups.
+		enum class ReservedUniform : int
+		{
+			Model,
+			View,
+			Projection,
+			ModelView,
+			ViewProjection,
+			ModelViewProjection,
+			InverseModel,
+			InverseView,
+			InverseProjection,
+			InverseModelView,
+			InverseViewProjection,
+			InverseModelViewProjection,
+			Count,
+		};
+
+		using ReservedUniformMask = std::uint32_t;
+
+		inline constexpr ReservedUniformMask ReservedUniformBit(ReservedUniform u) noexcept
+		{
+			return ReservedUniformMask(1) << int(u);
+		}
+
+		const std::string& ReservedUniformName(ReservedUniform);
+
+		//Interface blocks shared by all programs. The value of each entry is
+		//the binding point the block is assigned to when a program is linked.
+		enum class ReservedBlock : GLuint
+		{
+			Camera,
+			Transforms,
+			Material,
+		};
+
+		const std::string& ReservedBlockName(ReservedBlock);
+
 		class ShadingProgram
 		{
 			using VertexAttribStorage = std::vector<VertexAttribute>;
@@ -37,8 +78,13 @@ namespace GlProj
 			VertexAttribStorage attributes;
 			UniformInfoStorage uniforms;
 			UniformNameBufStorage uniformNameRef;
+			std::array<int, std::size_t(ReservedUniform::Count)> reservedUniforms{};
+			ReservedUniformMask reservedUniformMask = 0;
 			GLuint programHandle = invalidHandle;
 			bool transformsAreBatchable = false;
+			bool usesCameraBlock = false;
+			bool usesTransformBlock = false;
+			bool usesMaterialBlock = false;
 
 		public:
 			using VertexAttribConstIterator = VertexAttribStorage::const_iterator;
@@ -57,12 +103,19 @@ namespace GlProj
 			explicit ShadingProgram(GLuint) noexcept;
 
 			GLuint GetHandle() const noexcept;
+			bool TransformsAreBatchable() const noexcept;
+			bool UsesCameraBlock() const noexcept;
+			bool UsesTransformBlock() const noexcept;
+			bool UsesMaterialBlock() const noexcept;
 
 			VertexAttribConstIterator FindAttribute(const std::string&) const;
 			VertexAttribConstIterator FindAttribute(GLint) const;
 			VertexAttribConstIterator FindAttribute(MeshSlots) const;
 			UniformInfoConstIterator FindUniform(const std::string&) const;
 			UniformInfoConstIterator FindUniform(GLint) const;
+			ReservedUniformMask GetReservedUniformMask() const noexcept;
+			//Requires the uniform's bit to be set in GetReservedUniformMask().
+			const UniformInformation& GetReservedUniform(ReservedUniform) const noexcept;
 
 			VertexAttribConstIterator AttributesEnd() const;
 			UniformInfoConstIterator UniformsEnd() const;
@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace GlProj
+{
+	namespace Utilities
+	{
+		///Bounded, lock-free queue for exactly one producing thread and one
+		///consuming thread.
+		///Requires T is Movable and Default-constructible
+		template<typename T>
+		class SpscQueue
+		{
+			std::vector<T> slots;
+			std::size_t mask;
+			//Written only by the consumer and producer respectively.
+			alignas(64) std::atomic<std::size_t> head{ 0 };
+			alignas(64) std::atomic<std::size_t> tail{ 0 };
+		public:
+			///Capacity must be a power of two.
+			explicit SpscQueue(std::size_t capacity)
+				: slots(capacity)
+				, mask(capacity - 1)
+			{
+				if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+				{
+					throw std::logic_error("SpscQueue capacity must be a power of two.");
+				}
+			}
+			SpscQueue(const SpscQueue&) = delete;
+			SpscQueue& operator=(const SpscQueue&) = delete;
+
+			///Producer only. Returns false, leaving 'x' untouched, when full.
+			bool TryPush(T& x)
+			{
+				auto t = tail.load(std::memory_order_relaxed);
+				if (t - head.load(std::memory_order_acquire) == slots.size()) return false;
+
+				slots[t & mask] = std::move(x);
+				tail.store(t + 1, std::memory_order_release);
+				return true;
+			}
+			///Consumer only. Returns false when empty.
+			bool TryPop(T& out)
+			{
+				auto h = head.load(std::memory_order_relaxed);
+				if (h == tail.load(std::memory_order_acquire)) return false;
+
+				out = std::move(slots[h & mask]);
+				slots[h & mask] = T();
+				head.store(h + 1, std::memory_order_release);
+				return true;
+			}
+			bool empty() const noexcept
+			{
+				return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+			}
+		};
+	}
+}
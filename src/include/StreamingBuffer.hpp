@@ -0,0 +1,65 @@
+#pragma once
+#include "gl_core_4_5.h"
+#include "MeshDataBuffer.hpp"
+#include <vector>
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		struct StreamingAllocation
+		{
+			void* data = nullptr;
+			GLintptr offset = 0;
+			GLsizeiptr size = 0;
+		};
+
+		//Persistently mapped buffer divided into one region per frame in flight.
+		//Allocations bump through the current region and are written directly
+		//by the CPU. A region is only reused once the fence placed when it was
+		//retired has been signalled.
+		class StreamingBuffer
+		{
+			std::vector<GLsync> regionFences;
+			unsigned char* mappedData = nullptr;
+			GLuint bufferHandle = invalidHandle;
+			GLenum bufferType;
+			GLsizeiptr regionSize = 0;
+			GLsizeiptr regionHead = 0;
+			int currentRegion = 0;
+
+			void WaitForRegion(int);
+		public:
+			static const constexpr GLuint invalidHandle = GLuint(-1);
+			static const constexpr int DefaultRegionCount = 3;
+
+			friend bool operator==(const StreamingBuffer&, const StreamingBuffer&) noexcept;
+			friend bool operator!=(const StreamingBuffer&, const StreamingBuffer&) noexcept;
+
+			StreamingBuffer() noexcept = default;
+			StreamingBuffer(const StreamingBuffer&) = delete;
+			StreamingBuffer(BufferType, GLsizeiptr, int = DefaultRegionCount);
+			StreamingBuffer(StreamingBuffer&&) noexcept;
+			StreamingBuffer& operator=(StreamingBuffer&&) noexcept;
+			~StreamingBuffer();
+
+			GLuint GetHandle() const noexcept;
+			BufferType GetBufferType() const noexcept;
+			GLsizeiptr GetRegionSize() const noexcept;
+			int GetRegionCount() const noexcept;
+
+			//Blocks until the GPU has finished reading the current region.
+			void BeginFrame();
+			//Fences the current region and moves on to the next one.
+			void EndFrame();
+
+			//Sub-allocates from the current region. If the region is exhausted,
+			//it is retired early and the next region is waited upon.
+			StreamingAllocation Allocate(GLsizeiptr, GLsizeiptr = 1);
+
+			void Bind() const noexcept;
+			void BindRange(GLuint, const StreamingAllocation&) const noexcept;
+			void BindRange(GLuint, GLintptr, GLsizeiptr) const noexcept;
+		};
+	}
+}
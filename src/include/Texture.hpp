@@ -1,16 +1,74 @@
 #pragma once
 #include "gl_core_4_5.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace GlProj
 {
 	namespace Graphics
 	{
 		class TextureManager;
+		class Sampler;
+		class UploadFence;
+		enum class UploadState;
+
+		//The immutable storage allocated for a texture.
+		struct TextureStorage
+		{
+			GLenum internalFormat = GL_NONE;
+			GLsizei width = 0;
+			GLsizei height = 0;
+			GLsizei levels = 0;
+			GLsizei layers = 1;
+		};
+
+		//The part of a texture an image occupies, for images packed into a
+		//shared array texture: its layer, and the offset and scale that map
+		//the image's own coordinates into it.
+		struct TextureRegion
+		{
+			GLfloat u = 0.0f;
+			GLfloat v = 0.0f;
+			GLfloat width = 1.0f;
+			GLfloat height = 1.0f;
+			GLint layer = 0;
+		};
+
+		bool operator==(const TextureRegion&, const TextureRegion&) noexcept;
+		bool operator!=(const TextureRegion&, const TextureRegion&) noexcept;
+		bool operator<(const TextureRegion&, const TextureRegion&) noexcept;
+
+		//Levels in a full mip chain for an image of the given size.
+		GLsizei FullMipCount(GLsizei width, GLsizei height) noexcept;
+		//Bytes of GPU memory one level takes. Three-component formats are
+		//counted as four, as drivers pad them.
+		std::size_t TextureLevelSize(GLenum internalFormat, GLsizei width, GLsizei height) noexcept;
+		//Whether the context has GL_ARB_bindless_texture. Checked once.
+		bool BindlessTexturesSupported();
 
 		class Texture
 		{
+			friend class TextureManager;
+
 			GLuint textureHandle = invalidHandle;
 			GLenum textureType;
+			//Set while the upload thread may still be filling the texture.
+			std::shared_ptr<UploadFence> upload;
+			//Empty for textures registered from outside the manager.
+			TextureStorage storage;
+			mutable std::uint64_t lastBound = 0;
+			//Bindless handles made resident so far, by Sampler::GetId; 0 for
+			//the texture's own sampling state. Ids are never reused, so a
+			//deleted sampler's name given to a new one cannot match.
+			mutable std::vector<std::pair<std::uint64_t, GLuint64>> residentHandles;
+
+			void Release() noexcept;
+			//Takes ownership of 'handle', whose contents replace this texture's.
+			void ReplaceStorage(GLuint handle, const TextureStorage&) noexcept;
 		public:
 			static const constexpr GLuint invalidHandle = GLuint(-1);
 
@@ -23,11 +81,39 @@ namespace GlProj
 			Texture& operator=(Texture&&) noexcept;
 			~Texture();
 			Texture(GLenum, GLuint) noexcept;
+			Texture(GLenum, GLuint, const TextureStorage&, std::shared_ptr<UploadFence> = nullptr) noexcept;
 
 			GLuint GetHandle() const noexcept;
 			GLenum GetType() const noexcept;
+			//False until an asynchronous upload has completed, and for good
+			//if it failed.
+			bool IsReady() const;
+			UploadState GetUploadState() const;
+			//Empty unless the upload failed.
+			std::string GetUploadError() const;
+			const TextureStorage& GetStorage() const noexcept;
+			std::size_t SizeInBytes() const noexcept;
+			//Order of the most recent Bind among all textures; 0 if never bound.
+			std::uint64_t LastBound() const noexcept;
 
+			//Binds to the active unit, which is always unit 0: nothing changes
+			//the active unit, and Material keeps its textures off unit 0, so
+			//binds like this one and those made while uploading never
+			//disturb the units BindToUnit tracks.
 			void Bind() const noexcept;
+			//Binds with glBindTextureUnit, leaving the active unit alone. The
+			//call is skipped if the unit already holds this texture from an
+			//earlier BindToUnit.
+			void BindToUnit(GLuint) const noexcept;
+			//Requires BindlessTexturesSupported and a finished upload. The
+			//handle is made resident on first request and stays so until the
+			//texture's storage is released; with no sampler, the texture's
+			//own sampling state is used. Once a handle exists the texture's
+			//parameters can no longer change.
+			GLuint64 GetBindlessHandle(const Sampler* = nullptr) const;
 		};
+
+		//Clears a unit bound with Texture::BindToUnit.
+		void UnbindTextureUnit(GLuint) noexcept;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+#include <string>
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		//Offline conversion of images stb_image can decode (PNG, JPG, TGA,
+		//...) into a DDS file ReadCompressedImage and LoadTexture accept.
+		//Builds the full mip chain with a box filter, then compresses each
+		//level to BC1, or to BC3 when any pixel is not fully opaque.
+		//Throws std::runtime_error if the source cannot be decoded or the
+		//destination written. The BakeTexture tool wraps this for build scripts.
+		void BakeCompressedTexture(const std::string& source, const std::string& destination, bool highQuality = true);
+	}
+}
@@ -1,31 +1,92 @@
 #pragma once
 #include "gl_core_4_5.h"
 #include "LocalSharedPtr.hpp"
+#include "Texture.hpp"
+#include <cstddef>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace GlProj
 {
 	namespace Utilities
 	{
 		std::string NormalisePath(const std::string& path);
+		class JobSystem;
 	}
 	namespace Graphics
 	{
+		class GpuUploader;
 		class TextureManager;
-		class Texture;
 		class Sampler;
+		class StreamingBuffer;
 
 		using GlProj::Utilities::LocalSharedPtr;
 
+		static const constexpr GLsizei DefaultArrayLayerSize = 2048;
+
+		//A texture as a material samples it; see TextureRegion.
+		struct PackedTexture
+		{
+			LocalSharedPtr<Texture> texture;
+			TextureRegion region;
+		};
+
 		TextureManager* GetTextureManager();
 
-		LocalSharedPtr<Texture> LoadTexture(TextureManager*, const std::string&, bool = false);
+		//DDS, KTX and KTX2 files holding BC1-BC7 data are uploaded as they
+		//are, with their mip chains; see TextureBaker.hpp to produce them.
+		//Other images are decoded into immutable storage and, if asked,
+		//given a full generated mip chain.
+		LocalSharedPtr<Texture> LoadTexture(TextureManager*, const std::string&, bool replace = false, bool generateMipmaps = true);
+		//Only the image header is read here; decoding and upload happen on
+		//the upload thread. Check Texture::IsReady before sampling it.
+		LocalSharedPtr<Texture> LoadTexture(TextureManager*, GpuUploader&, const std::string&, bool replace = false, bool generateMipmaps = true);
+		//Decodes the images on the job system's threads and uploads each, in
+		//order, as soon as it and those before it are ready. Decoded pixels
+		//go straight into 'staging', a pixel_unpack streaming buffer used
+		//only for this; images are taken in batches that fit one of its
+		//regions. Images larger than a region are uploaded from client
+		//memory instead. Main thread only.
+		std::vector<LocalSharedPtr<Texture>> LoadTextures(TextureManager*, Utilities::JobSystem&, StreamingBuffer& staging,
+			const std::vector<std::string>& paths, bool replace = false, bool generateMipmaps = true);
+		//Build step for small material textures: packs the images into as
+		//few layers of one RGBA8 GL_TEXTURE_2D_ARRAY as fit, registered as
+		//'name', so materials using any of them share one binding. Images
+		//are padded by repeating their edges, which keeps the first few mip
+		//levels from bleeding between neighbours. Compressed images and
+		//those too large for a layer are left out. Null if none were packed.
+		LocalSharedPtr<Texture> PackTextureArray(TextureManager*, const std::string& name,
+			const std::vector<std::string>& paths, GLsizei layerSize = DefaultArrayLayerSize);
+		//The image's region of the array it was packed into, while that
+		//array is alive. Otherwise the image is loaded on its own and the
+		//region covers all of it.
+		PackedTexture LoadPackedTexture(TextureManager*, const std::string& path);
+		//LoadPackedTexture for many images, with those not packed loaded as
+		//one LoadTextures batch through 'staging'.
+		std::vector<PackedTexture> LoadPackedTextures(TextureManager*, Utilities::JobSystem&, StreamingBuffer& staging,
+			const std::vector<std::string>& paths, bool replace = false);
+		//A 1x1 opaque white texture of 'target', for material slots whose
+		//own texture cannot be sampled. Null for multisample and buffer
+		//targets.
+		LocalSharedPtr<Texture> GetPlaceholderTexture(TextureManager*, GLenum target);
 		LocalSharedPtr<Texture> RegisterTexture(TextureManager*, GLenum, GLuint, const std::string&, bool = false);
 		LocalSharedPtr<Texture> FindCachedTextureByPath(const TextureManager*, const std::string&);
 		LocalSharedPtr<Texture> FindCachedTextureByName(const TextureManager*, const std::string&);
 		void ReleaseUnused(TextureManager*);
 
+		//Bytes of GPU memory the manager's textures may take; 0 for no limit.
+		//Once over it, the least recently bound 2D textures have their top
+		//mip levels dropped until back under, down to a minimum size.
+		void SetTextureBudget(TextureManager*, std::size_t);
+		std::size_t GetTextureBudget(const TextureManager*);
+		//Bytes taken by live textures the manager holds. Those registered
+		//from a raw handle are counted from the storage GL reports.
+		std::size_t GetTextureMemoryUsage(const TextureManager*);
+		//Run after every load; call it after the budget or usage changes
+		//otherwise. Returns the bytes released.
+		std::size_t EnforceTextureBudget(TextureManager*);
+
 		LocalSharedPtr<Sampler> GenerateSampler();
 	}
 }
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include "glm/mat4x4.hpp"
+#include <cstddef>
+#include <vector>
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		//out = lhs * rhs. 'out' may alias either input.
+		void MultiplyTransform(const glm::mat4& lhs, const glm::mat4& rhs, glm::mat4& out) noexcept;
+		//out[i] = lhs[i] * rhs[i]. 'out' may alias either input.
+		void MultiplyTransforms(const glm::mat4* lhs, const glm::mat4* rhs, glm::mat4* out, std::size_t count) noexcept;
+
+		//Matrices stored element-wise: Element(k)[i] is element k of
+		//matrix i, using glm's column-major element order. Lets one SIMD
+		//lane work on each matrix rather than on each row.
+		class TransformsSoA
+		{
+			std::vector<float> elements[16];
+			std::size_t count = 0;
+		public:
+			TransformsSoA() = default;
+			explicit TransformsSoA(std::size_t);
+
+			std::size_t size() const noexcept;
+			void resize(std::size_t);
+
+			float* Element(int) noexcept;
+			const float* Element(int) const noexcept;
+
+			void Set(std::size_t, const glm::mat4&) noexcept;
+			glm::mat4 Get(std::size_t) const noexcept;
+		};
+
+		//out[i] = lhs[i] * rhs[i], several matrices per instruction.
+		//'out' must not alias either input, and is resized to match them.
+		void MultiplyTransforms(const TransformsSoA& lhs, const TransformsSoA& rhs, TransformsSoA& out);
+
+		//Times the per-node root walk formerly used by main.cpp against
+		//the cached, SIMD and SoA paths on synthetic hierarchies.
+		void BenchmarkWorldTransforms();
+	}
+}
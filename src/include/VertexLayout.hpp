@@ -0,0 +1,118 @@
+#pragma once
+#include "gl_core_4_5.h"
+#include "Mesh.hpp"
+#include <vector>
+
+struct aiMesh;
+
+namespace GlProj
+{
+	namespace Graphics
+	{
+		class MeshDataBuffer;
+
+		//How source values are transformed before being stored.
+		enum class AttributeEncoding
+		{
+			Direct,
+			//Unit vector folded onto an octahedron and stored as two
+			//components. Shaders must decode it back to three.
+			Octahedral,
+			//Tangent in xyz with the handedness of the bitangent in w, so the
+			//bitangent can be rebuilt as cross(normal, tangent.xyz) * tangent.w.
+			SignedTangent,
+		};
+
+		struct VertexAttributeLayout
+		{
+			MeshSlots slot;
+			GLenum type;
+			GLint components;
+			GLboolean normalised;
+			//Index of the vertex stream (buffer) the attribute is read from.
+			GLuint stream;
+			//Byte offset of the attribute within one vertex of its stream.
+			GLuint offset;
+			AttributeEncoding encoding = AttributeEncoding::Direct;
+		};
+
+		enum class NormalEncoding
+		{
+			//Three floats.
+			Float,
+			//Signed normalised GL_INT_2_10_10_10_REV.
+			Packed,
+			//Two signed normalised shorts; see AttributeEncoding::Octahedral.
+			Octahedral,
+		};
+
+		//Compression applied when building an interleaved layout.
+		//The defaults need no shader changes beyond reconstructing the
+		//bitangent from the tangent sign.
+		struct VertexCompression
+		{
+			//Texture coordinates as half floats.
+			bool halfTexCoords = true;
+			//Encoding of normals and tangents.
+			NormalEncoding normals = NormalEncoding::Packed;
+			//Drop the bitangent in favour of a sign stored in tangent.w.
+			bool bitangentSign = true;
+			//Colours as normalised unsigned bytes.
+			bool byteColours = true;
+		};
+
+		//Describes how vertex attributes are laid out across one or more
+		//vertex streams. Meshes with equal layouts can share vertex arrays.
+		struct VertexLayout
+		{
+			std::vector<VertexAttributeLayout> attributes;
+			std::vector<GLsizei> streamStrides;
+		};
+
+		bool operator==(const VertexAttributeLayout&, const VertexAttributeLayout&) noexcept;
+		bool operator!=(const VertexAttributeLayout&, const VertexAttributeLayout&) noexcept;
+		bool operator==(const VertexLayout&, const VertexLayout&) noexcept;
+		bool operator!=(const VertexLayout&, const VertexLayout&) noexcept;
+
+		//One full-precision float stream per attribute present in the mesh,
+		//matching what Mesh(const aiMesh*) uploads.
+		VertexLayout DeinterleavedLayout(const aiMesh*);
+		//Every attribute present in the mesh in a single stream, each
+		//attribute aligned to four bytes.
+		VertexLayout InterleavedLayout(const aiMesh*, const VertexCompression& = VertexCompression());
+
+		//CPU-side vertex and index data, ready to be copied into buffers.
+		struct PackedMesh
+		{
+			VertexLayout layout;
+			std::vector<std::vector<unsigned char>> streams;
+			std::vector<unsigned int> indices;
+			//Format the indices take once uploaded.
+			IndexType indexType = IndexType::unsigned_int;
+			unsigned int vertexCount = 0;
+			unsigned int vertsPerPrimitive = 3;
+		};
+
+		PackedMesh PackMesh(const aiMesh*, const VertexLayout&);
+
+		//Packed data owned elsewhere, e.g. by a PackedMesh or a mapped file.
+		struct PackedMeshView
+		{
+			VertexLayout layout;
+			//vertexCount * stride bytes per stream.
+			std::vector<const void*> streams;
+			const void* indices = nullptr;
+			//Format 'indices' are stored in. Narrowed to indexType on upload.
+			IndexType indexDataType = IndexType::unsigned_int;
+			IndexType indexType = IndexType::unsigned_int;
+			unsigned int vertexCount = 0;
+			unsigned int indexCount = 0;
+			unsigned int vertsPerPrimitive = 3;
+		};
+
+		PackedMeshView ViewOf(const PackedMesh&);
+
+		//Points the attributes of the bound vertex array at 'streams'.
+		void BindVertexLayout(const VertexLayout&, const std::vector<MeshDataBuffer>& streams);
+	}
+}
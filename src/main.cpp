@@ -1,31 +1,38 @@
 #include "gl_core_4_5.h"
 #include "GLFW/glfw3.h"
 #include "assimp/DefaultLogger.hpp"
-#include "assimp/Importer.hpp"
-#include "assimp/postprocess.h"
-#include "assimp/scene.h"
+#include "AssetManager.hpp"
 #include "Camera.hpp"
 #include "glm/gtc/matrix_transform.hpp"
+#include "LinearSceneGraph.hpp"
 #include "Material.hpp"
 #include "MeshManager.hpp"
 #include "Model.hpp"
+#include "ModelLoader.hpp"
+#include "GpuUploader.hpp"
 #include "RenderManager.hpp"
 #include "SceneGraph.hpp"
 #include "Shader.hpp"
 #include "ShaderManager.hpp"
 #include "ShadingProgram.hpp"
+#include "StreamingBuffer.hpp"
 #include "Texture.hpp"
 #include "TextureManager.hpp"
+#include "TransformKernels.hpp"
+#include "JobSystem.hpp"
 #include "Mesh.hpp"
 #include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <exception>
+#include <future>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 using namespace GlProj::Graphics;
@@ -122,171 +129,96 @@ inline void APIENTRY GLDbgCallback(GLenum source, GLenum type, GLuint id,
 	(*oStream) << output << "\n\n";
 }
 
-inline glm::mat4 aiToGlm(const aiMatrix4x4& o)
+void glfwExecErrorCallback(int, const char* msg)
 {
-	return{ o.a1, o.a2, o.a3, o.a4,
-		   o.b1, o.b2, o.b3, o.b4,
-		   o.c1, o.c2, o.c3, o.c4,
-		   o.d1, o.d2, o.d3, o.d4 };
+	std::cerr << "glfw error: " << msg << std::endl;
 }
 
-template<typename I>
-//requires value_type of iterator is std::string
-inline void MakeNamesUnique(I first, I last)
+LocalSharedPtr<Material> GetDefaultMaterial()
 {
-	auto firstMesh = first;
-	while (firstMesh != last)
-	{
-		auto pairStart = std::adjacent_find(firstMesh, last);
-		if (pairStart == last)
-		{
-			break;
-		}
-		int i = 0;
-
-		std::string prev = *pairStart;
-		first = pairStart;
-		//First duplicate will have a 0-suffix
-		*first += std::to_string(i);
-		++i;
-		++pairStart;
-		//Second duplicate will have a 1-suffix
-		*pairStart += std::to_string(i);
-		++pairStart;
-		++i;
-		//Subsequent duplicates will have
-		while (pairStart != last && *pairStart == prev)
-		{
-			*pairStart += std::to_string(i);
-			++pairStart;
-			++i;
-		}
-		firstMesh = pairStart;
-	}
-}
+	static bool firstRun = true;
+	static LocalSharedPtr<ShadingProgram> prog;
+	static auto mat = GlProj::Utilities::make_localshared<Material>();
+	if (!firstRun) return mat;
 
-inline glm::mat4 ApplyHierarchy(const GlProj::Utilities::SceneNode<ModelData>& n)
-{
-	auto node = &n;
+	//Multi-draw batches read their transforms from the transform block.
+	static const std::string vsPath = MultiDrawIndirectSupported()
+		? "./data/shaders/IndirectShader.vs" : "./data/shaders/BasicShader.vs";
+	static const std::string fsPath = "./data/shaders/BasicShader.fs";
+	//Links into a new program, so a failed rebuild leaves the old one in use.
+	auto buildProgram = []()
+	{
+		prog = LoadProgram(GetShaderManager(), { { GL_VERTEX_SHADER, vsPath }, { GL_FRAGMENT_SHADER, fsPath } });
+	};
+	buildProgram();
+	*mat = prog;
 
-	auto t = glm::mat4(1);
-	while (node != nullptr)
+	if (auto assets = GlProj::Utilities::GetAssetManager())
 	{
-		t *= node->data.transform;
-		node = node->parent;
+		RegisterRebuild(assets, "program:Basic", { vsPath, fsPath }, buildProgram);
+		RegisterRebuild(assets, "material:Default", { "program:Basic" }, []()
+		{
+			*mat = prog;
+		});
 	}
+	firstRun = false;
 
-	return t;
+	return mat;
 }
 
-void AddChildren(SceneGraph<ModelData>& graph,
-	GlProj::Utilities::SceneNode<ModelData>* parent,
-	aiNode* node)
+//BasicShader.fs reads its diffuse map from a layer of an array texture,
+//so an image that was not packed into one is shown as the placeholder.
+void AssignDiffuseMap(Material& material, const std::string& path)
 {
-	for (int i = 0; i < int(node->mNumChildren); ++i)
+	auto textures = GetTextureManager();
+	PackedTexture map;
+	try
 	{
-		graph.emplace(parent, aiToGlm(node->mChildren[i]->mTransformation),
-			std::vector<unsigned int>(node->mChildren[i]->mMeshes, node->mChildren[i]->mMeshes + node->mChildren[i]->mNumMeshes),
-			node->mChildren[i]->mName.C_Str());
+		map = LoadPackedTexture(textures, path);
 	}
-
-	for (int i = 0; i < int(node->mNumChildren); ++i)
+	catch (const std::exception& e)
 	{
-		AddChildren(graph, parent->children->data() + i, node->mChildren[i]);
+		std::cerr << e.what() << std::endl;
 	}
-}
-
-void PopulateGraph(SceneGraph<ModelData>& graph, aiNode* root)
-{
-	auto parent = graph.emplace(nullptr, aiToGlm(root->mTransformation),
-		std::vector<unsigned int>(root->mMeshes, root->mMeshes + root->mNumMeshes),
-		root->mName.C_Str());
-
-	AddChildren(graph, parent, root);
-}
-
-void glfwExecErrorCallback(int, const char* msg)
-{
-	std::cerr << "glfw error: " << msg << std::endl;
-}
-
-LocalSharedPtr<Material> GetDefaultMaterial()
-{
-	static bool firstRun = true;
-	static auto prog = GenerateProgram();
-	static auto mat = GlProj::Utilities::make_localshared<Material>();
-	if (!firstRun) return mat;
-
-	auto vs = LoadShader(GetShaderManager(), GL_VERTEX_SHADER, "./data/shaders/BasicShader.vs");
-	auto fs = LoadShader(GetShaderManager(), GL_FRAGMENT_SHADER, "./data/shaders/BasicShader.fs");
-
-	AttachShader(prog.get(), vs.get());
-	AttachShader(prog.get(), fs.get());
-	LinkProgram(prog.get());
-	prog->FetchProgramInfo();
-
-	*mat = prog;
-	firstRun = false;
-
-	return mat;
+	if (map.texture == nullptr || map.texture->GetType() != GL_TEXTURE_2D_ARRAY)
+	{
+		map = { GetPlaceholderTexture(textures, GL_TEXTURE_2D_ARRAY), TextureRegion{} };
+	}
+	material.SetTexture(TextureSlot::Diffuse1, map.texture, map.region);
 }
 
 void PrepareAndRunGame(GLFWwindow* window)
 {
+	GlProj::Utilities::JobSystem jobs;
 	Model model;
 	std::vector<local_shared_ptr<RenderableHandle>> handles;
 	auto renderer = GetRenderManager();
 	auto batch = GenerateRenderBatch(renderer);
 
 	{
-		Assimp::Importer importer{};
 #ifdef _DEBUG
 		Assimp::DefaultLogger::create("AssimpLog.txt", Assimp::Logger::VERBOSE, aiDefaultLogStream_STDOUT);
 #endif
-		auto bunny = importer.ReadFile("./data/models/armadillo.obj", aiProcess_Triangulate | aiProcess_SortByPType
-			| aiProcess_GenUVCoords | aiProcess_OptimizeGraph
-			| aiProcess_OptimizeMeshes | aiProcess_GenSmoothNormals);
-		importer.SetPropertyInteger(AI_CONFIG_PP_SLM_TRIANGLE_LIMIT, 0xffff);
-		bunny = importer.ApplyPostProcessing(aiProcess_SplitLargeMeshes | aiProcess_CalcTangentSpace | aiProcess_ValidateDataStructure);
-
-		if (bunny == nullptr)
-		{
-			std::string err;
-			err += importer.GetErrorString();
-			throw std::runtime_error(err);
-		}
-
-		Assimp::DefaultLogger::kill();
+		//The workers import while this thread builds the shaders.
+		auto pendingModel = LoadModelAsync(jobs, "./data/models/armadillo.obj", ModelImportSettings{ 0xffff, 0xffff });
 
 		const auto& initText = "System Init";
 
 		glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, sizeof(initText), initText);
-		std::vector<Renderable> submeshes;
-		submeshes.reserve(bunny->mNumMeshes);
 		auto material = GetDefaultMaterial();
 
-		std::vector<std::string> meshNames;
-		meshNames.reserve(bunny->mNumMeshes);
-		std::transform(bunny->mMeshes, bunny->mMeshes + bunny->mNumMeshes, std::back_inserter(meshNames),
-			[](const auto& x)
-		{
-			return x->mName.C_Str();
-		});
-
-		MakeNamesUnique(meshNames.begin(), meshNames.end());
+		jobs.Wait(pendingModel);
+		model = pendingModel.get();
 
-		for (int i = 0; i < int(bunny->mNumMeshes); ++i)
-		{
-			submeshes.push_back({ RegisterMesh(GetMeshManager(), bunny->mMeshes[i], meshNames[i]),
-								  nullptr });
-		}
+		Assimp::DefaultLogger::kill();
 
-		SceneGraph<ModelData> bunnyGraph;
-		PopulateGraph(bunnyGraph, bunny->mRootNode);
+		auto cacheReport = GetOptimisationReport(GetMeshManager());
+		std::cout << "ACMR before: " << cacheReport.acmrBefore << ", after: " << cacheReport.acmrAfter << '\n';
 
-		model = Model{ submeshes, std::move(bunnyGraph) };
+		const auto& submeshes = model.GetRenderables();
 
 		GlProj::Utilities::TestSceneGraph();
+		GlProj::Utilities::TestLinearSceneGraph();
 
 		glClearColor(0.4f, 0.4f, 0.4f, 1.0f);
 
@@ -295,15 +227,11 @@ void PrepareAndRunGame(GLFWwindow* window)
 			handles.push_back(SubmitRenderable(batch.get(), *(submeshes[i].mesh), submeshes[i].material.get()));
 		}
 		auto& hierarchy = model.GetHierarchy();
-		for (auto pos = hierarchy.begin(); pos != hierarchy.end(); ++pos)
+		for (auto n : model.UpdateWorldTransforms(jobs))
 		{
-			if (pos->meshes.empty()) continue;
-
-			auto transform = ApplyHierarchy(*pos.current);
-			auto& dat = *pos;
-			for (const auto& i : dat.meshes)
+			for (const auto& i : hierarchy[n].meshes)
 			{
-				SetTransform(handles[i].get(), transform);
+				SetTransform(handles[i].get(), model.GetWorldTransform(n));
 			}
 		}
 		SetOverrideMaterial(batch.get(), material.get());
@@ -335,17 +263,13 @@ void PrepareAndRunGame(GLFWwindow* window)
 		prevTime = newTime;
 		angle += float(delta) * rotationSpeed;
 
-		auto rootTransform = glm::rotate(glm::mat4(1), angle, glm::vec3{ 0.0f, 1.0f, 0.0f });
+		model.SetRootTransform(glm::rotate(glm::mat4(1), angle, glm::vec3{ 0.0f, 1.0f, 0.0f }));
 
-		for (auto pos = hierarchy.begin(); pos != hierarchy.end(); ++pos)
+		for (auto n : model.UpdateWorldTransforms(jobs))
 		{
-			if (pos->meshes.empty()) continue;
-
-			auto transform = ApplyHierarchy(*pos.current);
-			auto& dat = *pos;
-			for (const auto& i : dat.meshes)
+			for (const auto& i : hierarchy[n].meshes)
 			{
-				SetTransform(handles[i].get(), rootTransform * transform);
+				SetTransform(handles[i].get(), model.GetWorldTransform(n));
 			}
 		}
 
@@ -449,6 +373,11 @@ try
 {
 	std::ios_base::sync_with_stdio(false);
 
+#ifdef GLPROJ_RUN_BENCHMARKS
+	GlProj::Graphics::BenchmarkWorldTransforms();
+	GlProj::Utilities::BenchmarkJobSystem();
+#endif
+
 	glfwSetErrorCallback(glfwExecErrorCallback);
 	if (glfwInit() == GLFW_FALSE)
 	{
@@ -561,69 +490,93 @@ try
     camera.transform = Transform{ { 0.0f, -1.0f, 0.0f }, glm::quat(),{ 1.0f, 1.0f, 1.0f } };
 
     //Load model for testing
+    //Keeps the import caches, so later runs skip unchanged assets.
+    GlProj::Utilities::OpenProject("./data");
+    GlProj::Utilities::JobSystem jobs;
+    //Held by pointer so it can go before the windows and GLFW do.
+    auto uploader = std::make_unique<GpuUploader>(primaryWin);
+    const std::string modelPath = "./data/models/knight.obj";
+    //Textures the level's materials sample.
+    const std::vector<std::string> levelTextures = { "./data/textures/knight_diffuse.png" };
+    //Decoded level textures are written here and uploaded from it.
+    StreamingBuffer textureStaging(BufferType::pixel_unpack, GLsizeiptr(16) << 20, 2);
+    LocalSharedPtr<Texture> levelArray;
+    std::vector<PackedTexture> levelMaps;
+    //Packs the level's textures and gives the default material its map.
+    auto loadLevelTextures = [&](bool replace)
+    {
+        auto material = GetDefaultMaterial();
+        //Lets the previous array go, so no image is found packed in it.
+        material->ClearTexture(TextureSlot::Diffuse1);
+        levelMaps.clear();
+        levelArray = nullptr;
+        try
+        {
+            //Build step: the level's small textures share one array.
+            levelArray = PackTextureArray(GetTextureManager(), "array:level", levelTextures);
+            levelMaps = LoadPackedTextures(GetTextureManager(), jobs, textureStaging, levelTextures, replace);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Level textures failed to load.\n" << e.what() << std::endl;
+        }
+        AssignDiffuseMap(*material, levelTextures[0]);
+    };
     Model model;
+    //A re-import in flight, then the model it made while its meshes upload.
+    std::future<Model> pendingReload;
+    Model reloaded;
+    bool reloadStaged = false;
     std::vector<local_shared_ptr<RenderableHandle>> handles;
     auto renderer = GetRenderManager();
-    auto batch = GenerateRenderBatch(renderer);
+    auto batch = GenerateRenderBatch(renderer, BatchType::Opaque, 0, true, true,
+        MultiDrawIndirectSupported() ? BatchSubmission::MultiDrawIndirect : BatchSubmission::Direct);
 
     {
-        Assimp::Importer importer{};
 #ifdef _DEBUG
         Assimp::DefaultLogger::create("AssimpLog.txt", Assimp::Logger::VERBOSE, aiDefaultLogStream_STDOUT);
 #endif
-        importer.SetPropertyInteger(AI_CONFIG_PP_SLM_TRIANGLE_LIMIT, 0xfffff);
-        auto bunny = importer.ReadFile("./data/models/knight.obj", aiProcess_Triangulate | aiProcess_SortByPType
-            | aiProcess_GenUVCoords | aiProcess_OptimizeGraph
-            | aiProcess_OptimizeMeshes | aiProcess_GenSmoothNormals);
-        bunny = importer.ApplyPostProcessing(aiProcess_SplitLargeMeshes | aiProcess_CalcTangentSpace | aiProcess_ValidateDataStructure);
+        //The workers import while this thread builds the shaders.
+        auto pendingModel = LoadModelAsync(jobs, modelPath, ModelImportSettings(), uploader.get());
+
+        const auto& initText = "System Init";
+
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, sizeof(initText), initText);
+        auto material = GetDefaultMaterial();
+        loadLevelTextures(false);
 
-        if (bunny == nullptr)
+        jobs.Wait(pendingModel);
+        model = pendingModel.get();
+        SaveProject(GlProj::Utilities::GetAssetManager());
+        //Nothing else to draw yet, so just wait for the mesh data.
+        while (model.GetUploadState() == UploadState::Pending)
         {
-            std::string err;
-            err += importer.GetErrorString();
-            throw std::runtime_error(err);
+            std::this_thread::yield();
+        }
+        if (model.GetUploadState() == UploadState::Failed)
+        {
+            //The renderer skips meshes that failed to upload.
+            std::cerr << "Model upload failed: " << model.GetUploadError() << std::endl;
         }
 
         Assimp::DefaultLogger::kill();
 
+        const auto& submeshes = model.GetRenderables();
+
 		unsigned long long faceCount = 0ull;
 
-		for (int i = 0; i < (int)bunny->mNumMeshes; ++i)
+		for (const auto& r : submeshes)
 		{
-			faceCount += bunny->mMeshes[i]->mNumFaces;
+			faceCount += r.mesh->PrimitiveCount();
 		}
 
 		std::cout << "Total tris: " << faceCount << '\n';
 
-        const auto& initText = "System Init";
-
-        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, sizeof(initText), initText);
-        std::vector<Renderable> submeshes;
-        submeshes.reserve(bunny->mNumMeshes);
-        auto material = GetDefaultMaterial();
-
-        std::vector<std::string> meshNames;
-        meshNames.reserve(bunny->mNumMeshes);
-        std::transform(bunny->mMeshes, bunny->mMeshes + bunny->mNumMeshes, std::back_inserter(meshNames),
-            [](const auto& x)
-        {
-            return x->mName.C_Str();
-        });
-
-        MakeNamesUnique(meshNames.begin(), meshNames.end());
-
-        for (int i = 0; i < int(bunny->mNumMeshes); ++i)
-        {
-            submeshes.push_back({ RegisterMesh(GetMeshManager(), bunny->mMeshes[i], meshNames[i]),
-                nullptr });
-        }
-
-        SceneGraph<ModelData> bunnyGraph;
-        PopulateGraph(bunnyGraph, bunny->mRootNode);
-
-        model = Model{ submeshes, std::move(bunnyGraph) };
+        auto cacheReport = GetOptimisationReport(GetMeshManager());
+        std::cout << "ACMR before: " << cacheReport.acmrBefore << ", after: " << cacheReport.acmrAfter << '\n';
 
         GlProj::Utilities::TestSceneGraph();
+        GlProj::Utilities::TestLinearSceneGraph();
 
         glClearColor(0.4f, 0.4f, 0.4f, 1.0f);
 
@@ -633,21 +586,31 @@ try
         }
         glFlush();
         auto& hierarchy = model.GetHierarchy();
-        for (auto pos = hierarchy.begin(); pos != hierarchy.end(); ++pos)
+        for (auto n : model.UpdateWorldTransforms(jobs))
         {
-            if (pos->meshes.empty()) continue;
-
-            auto transform = ApplyHierarchy(*pos.current);
-            auto& dat = *pos;
-            for (const auto& i : dat.meshes)
+            for (const auto& i : hierarchy[n].meshes)
             {
-                SetTransform(handles[i].get(), transform);
+                SetTransform(handles[i].get(), model.GetWorldTransform(n));
             }
         }
         SetOverrideMaterial(batch.get(), material.get());
         UpdateBatchCamera(batch.get(), camera);
     }
 
+    //Only starts the re-import; the frame loop swaps it in once uploaded.
+    RegisterRebuild(GlProj::Utilities::GetAssetManager(), "model:knight", { modelPath }, [&]()
+    {
+        //The cached meshes of the same names are the stale ones.
+        ModelImportSettings settings;
+        settings.replaceMeshes = true;
+        pendingReload = LoadModelAsync(jobs, modelPath, settings, uploader.get());
+        reloadStaged = false;
+    });
+    RegisterRebuild(GlProj::Utilities::GetAssetManager(), "texture:level", levelTextures, [&]()
+    {
+        loadLevelTextures(true);
+    });
+
     glPopDebugGroup();
     //
 
@@ -655,7 +618,6 @@ try
     windows[1].location = { 8.0f, -1.0f, 0.0f };
     windows[2].location = { -8.0f, -1.0f, 0.0f };
 
-    auto& hierarchy = model.GetHierarchy();
     float angle = 0.0f;
     const float rotationSpeed = 0.6f;
 
@@ -699,17 +661,54 @@ try
 			glfwSetWindowShouldClose(windows[0].win, GLFW_TRUE);
 		}
 
-        auto rootTransform = glm::translate(glm::mat4(1), modelPos) * glm::rotate(glm::mat4(1), angle, glm::vec3{ 0.0f, 1.0f, 0.0f });
+        //Picks up edits to shaders and models made while running.
+        GlProj::Utilities::RebuildChanged(GlProj::Utilities::GetAssetManager());
 
-        for (auto pos = hierarchy.begin(); pos != hierarchy.end(); ++pos)
+        //Runs the reload's upload, which waits for the main thread.
+        jobs.PumpMainThread();
+        if (pendingReload.valid() && pendingReload.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
         {
-            if (pos->meshes.empty()) continue;
+            try
+            {
+                reloaded = pendingReload.get();
+                reloadStaged = true;
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Model reload failed.\n" << e.what() << std::endl;
+            }
+        }
+        if (reloadStaged && reloaded.GetUploadState() != UploadState::Pending)
+        {
+            reloadStaged = false;
+            if (reloaded.GetUploadState() == UploadState::Failed)
+            {
+                std::cerr << "Model reload upload failed: " << reloaded.GetUploadError() << std::endl;
+                reloaded = Model();
+            }
+            else
+            {
+                for (auto& h : handles)
+                {
+                    RemoveRenderable(batch.get(), std::move(h));
+                }
+                handles.clear();
+                model = std::move(reloaded);
+                for (const auto& r : model.GetRenderables())
+                {
+                    handles.push_back(SubmitRenderable(batch.get(), *r.mesh, r.material.get()));
+                }
+            }
+        }
+
+        model.SetRootTransform(glm::translate(glm::mat4(1), modelPos) * glm::rotate(glm::mat4(1), angle, glm::vec3{ 0.0f, 1.0f, 0.0f }));
 
-            auto transform = ApplyHierarchy(*pos.current);
-            auto& dat = *pos;
-            for (const auto& i : dat.meshes)
+        const auto& hierarchy = model.GetHierarchy();
+        for (auto n : model.UpdateWorldTransforms(jobs))
+        {
+            for (const auto& i : hierarchy[n].meshes)
             {
-                SetTransform(handles[i].get(), rootTransform * transform);
+                SetTransform(handles[i].get(), model.GetWorldTransform(n));
             }
         }
         //
@@ -756,6 +755,8 @@ try
         glfwPollEvents();
     }
 
+    uploader.reset();
+    GlProj::Utilities::CloseProject();
     for (auto& window : windows)
     {
 	    glfwDestroyWindow(window.win);
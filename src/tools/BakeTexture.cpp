@@ -0,0 +1,36 @@
+//Offline front end for BakeCompressedTexture:
+//	BakeTexture [--fast] <source image> <destination .dds>
+//--fast trades compression quality for speed.
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "TextureBaker.hpp"
+#include <cstring>
+#include <exception>
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+	bool highQuality = true;
+	int first = 1;
+	if (argc > 1 && std::strcmp(argv[1], "--fast") == 0)
+	{
+		highQuality = false;
+		++first;
+	}
+	if (argc - first != 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " [--fast] <source image> <destination .dds>" << std::endl;
+		return 2;
+	}
+
+	try
+	{
+		GlProj::Graphics::BakeCompressedTexture(argv[first], argv[first + 1], highQuality);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}